@@ -1,4 +1,3 @@
-
 /// @file
 ///
 /// @author: Piotr Grygorczuk grygorek@gmail.com
@@ -31,28 +30,35 @@
 /// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 /// POSSIBILITY OF SUCH DAMAGE.
 ///
-/// @brief Tetris game figures definition
+/// @brief Game for a bare metal target, implementation
+///
+/// Build with TETRIS_BARE_METAL defined and, e.g.:
+///   -fno-exceptions -fno-rtti -fno-threadsafe-statics
+///   -fno-asynchronous-unwind-tables
 
-#include "FigureImpl.h"
+#include "Core.h"
+#include "Mailbox.h"
+#include "TetrisGame.h"
 
-namespace Tetris
+namespace
 {
-/// @brief Same figure rotated
-///
-/// For 'Bar' there are only two different positons
-const std::array<std::array<Block, 3>, 2> Bar::_figure{
-    std::array<Block, 3>{Block{{0, 1}}, Block{{1, 1}}, Block{{2, 1}}},
-    std::array<Block, 3>{Block{{1, 0}}, Block{{1, 1}}, Block{{1, 2}}}};
+Tetris::Game s_game{1};
+Tetris::CommandMailbox s_mailbox;
+} // namespace
+
+void tetris_start(void) { s_game.Reset(Tetris::Entropy()); }
+
+void tetris_key(uint8_t cmd)
+{
+  if (cmd <= static_cast<uint8_t>(Tetris::Command::TranslateDown))
+    s_mailbox.Post(static_cast<Tetris::Command>(cmd));
+}
+
+void tetris_tick(void) { Tetris::Tick(s_game, s_mailbox); }
+
+const uint8_t *tetris_screen(void)
+{
+  return reinterpret_cast<const uint8_t *>(s_game.Board().Lines().data());
+}
 
-/// @brief Same figure rotated
-///
-/// For 'BarT' there are four different positons
-const std::array<std::array<Block, 4>, 4> BarT::_figure{
-    // clang-format off
-    std::array<Block,4> {Block{{0,0}}, Block{{0,1}}, Block{{0,2}}, Block{{1,1}}},
-    std::array<Block,4> {Block{{0,1}}, Block{{1,0}}, Block{{1,1}}, Block{{2,1}}},
-    std::array<Block,4> {Block{{0,1}}, Block{{1,0}}, Block{{1,1}}, Block{{1,2}}},
-    std::array<Block,4> {Block{{0,0}}, Block{{1,0}}, Block{{1,1}}, Block{{2,0}}}
-    // clang-format on
-};
-} // namespace Tetris
+uint8_t tetris_over(void) { return s_game.Over(); }
@@ -0,0 +1,68 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Game for a bare metal target
+///
+/// The game, its screen and the command mailbox are static objects. There
+/// is no heap, no exceptions, no RTTI and no threads. The application
+/// supplies Tetris::Entropy, calls tetris_key from its key interrupt and
+/// tetris_tick from a timer interrupt or its main loop.
+
+#ifndef __TETRIS_BARE_METAL_CORE_H__
+#define __TETRIS_BARE_METAL_CORE_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Start a new game, seeded from Tetris::Entropy
+void tetris_start(void);
+
+/// @brief Command from a key, a Tetris::Command value. Safe in an ISR.
+void tetris_key(uint8_t cmd);
+
+/// @brief Progress the game with the latest command
+void tetris_tick(void);
+
+/// @returns screen of the game, rows of bytes, 0 for an empty block
+const uint8_t *tetris_screen(void);
+
+/// @returns 1 if the game is over
+uint8_t tetris_over(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__TETRIS_BARE_METAL_CORE_H__
@@ -0,0 +1,204 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Worst case cost of Game::Tick, measured on a Linux host
+///
+/// Plays many games with random commands and garbage lines, so that ticks
+/// move, rotate, lock figures and remove lines. Every tick is replayed a
+/// few times from the same state and the cheapest run counts, which takes
+/// noise out. Instructions are counted by the CPU's performance counter,
+/// user space only. Where perf events are not available, time stamp
+/// counter cycles are reported instead.
+///
+/// Build with the same flags as the target, see BareMetal/report.sh.
+///
+/// Usage: TickBudget [ticks]
+
+#include "Mailbox.h"
+#include "TetrisGame.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace Tetris
+{
+std::uint32_t Entropy() { return 12345; }
+} // namespace Tetris
+
+namespace
+{
+/// @brief Counts instructions of a piece of code, or cycles if it cannot
+class Counter
+{
+public:
+  Counter()
+  {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.size           = sizeof(attr);
+    attr.config         = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    _fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+
+  ~Counter()
+  {
+    if (_fd >= 0)
+      close(_fd);
+  }
+
+  const char *Unit() const
+  {
+    return _fd >= 0 ? "instructions" : "TSC cycles";
+  }
+
+  template <class Code>
+  std::uint64_t Measure(Code &&code)
+  {
+    if (_fd < 0)
+      return Cycles(code);
+
+    ioctl(_fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(_fd, PERF_EVENT_IOC_ENABLE, 0);
+    code();
+    ioctl(_fd, PERF_EVENT_IOC_DISABLE, 0);
+    std::uint64_t count{0};
+    if (read(_fd, &count, sizeof(count)) != sizeof(count))
+      return 0;
+    return count;
+  }
+
+private:
+  int _fd;
+
+  template <class Code>
+  static std::uint64_t Cycles(Code &code)
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned aux;
+    auto start{__rdtscp(&aux)};
+    code();
+    return __rdtscp(&aux) - start;
+#else
+    code();
+    return 0;
+#endif
+  }
+};
+
+/// Cheapest of a few runs of a tick from the same state
+std::uint64_t MeasureTick(Counter &counter, Tetris::Game &game,
+                          Tetris::CommandMailbox &mailbox, Tetris::Command cmd,
+                          std::uint64_t overhead)
+{
+  constexpr std::int32_t Runs{5};
+  auto before{game.Save()};
+  std::uint64_t best{~0ull};
+  for (std::int32_t i{0}; i < Runs; i++)
+  {
+    game.Restore(before);
+    mailbox.Post(cmd);
+    auto n{counter.Measure([&] { Tetris::Tick(game, mailbox); })};
+    best = std::min(best, n);
+  }
+  return best > overhead ? best - overhead : 0;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  using namespace Tetris;
+  std::int64_t ticks{argc > 1 ? std::atoll(argv[1]) : 200000};
+
+  Counter counter;
+  // Cost of measuring nothing
+  std::uint64_t overhead{~0ull};
+  for (std::int32_t i{0}; i < 1000; i++)
+    overhead = std::min(overhead, counter.Measure([] {}));
+
+  std::vector<std::uint64_t> costs;
+  costs.reserve(ticks);
+  std::uint64_t worst{0};
+  std::int32_t worstCleared{0};
+  Command worstCmd{Command::Idle};
+
+  Random rng{1};
+  CommandMailbox mailbox;
+  Game game{rng()};
+  for (std::int64_t t{0}; t < ticks; t++)
+  {
+    if (game.Over())
+      game.Reset(rng());
+    // Garbage with a single hole gives removed lines now and then
+    if (rng.Below(64) == 0)
+      game.AddGarbage(1 + rng.Below(3), rng.Below(TetrisScreen::Width()));
+
+    auto cmd{static_cast<Command>(rng.Below(6))};
+    auto cost{MeasureTick(counter, game, mailbox, cmd, overhead)};
+    costs.push_back(cost);
+    if (cost > worst)
+    {
+      worst        = cost;
+      worstCmd     = cmd;
+      worstCleared = game.Cleared();
+    }
+  }
+
+  std::sort(costs.begin(), costs.end());
+  auto at{[&](double q) { return costs[std::size_t(q * (costs.size() - 1))]; }};
+  std::printf("Tick over %lld ticks, %s (measuring overhead %llu removed)\n",
+              static_cast<long long>(ticks), counter.Unit(),
+              static_cast<unsigned long long>(overhead));
+  std::printf("  median %llu, p99 %llu, p99.9 %llu, worst %llu\n",
+              static_cast<unsigned long long>(at(0.5)),
+              static_cast<unsigned long long>(at(0.99)),
+              static_cast<unsigned long long>(at(0.999)),
+              static_cast<unsigned long long>(worst));
+  std::printf("  worst tick: command %d, %d lines removed\n",
+              static_cast<int>(worstCmd), worstCleared);
+  std::printf("Static RAM of the game: Game %zu bytes, mailbox %zu bytes\n",
+              sizeof(Game), sizeof(CommandMailbox));
+  return 0;
+}
@@ -0,0 +1,38 @@
+#!/bin/sh
+# Bare metal profile of the game.
+#
+# Builds the game core the way a microcontroller build would (no
+# exceptions, no RTTI, no heap), reports its static ROM and RAM and checks
+# that it refers to no heap or exception support. Then builds the Tick
+# cost harness with the same flags and runs it on this host.
+#
+# Usage: BareMetal/report.sh [ticks]
+# Environment: CXX (default g++), OPT (default -Os)
+
+set -e
+cd "$(dirname "$0")/.."
+CXX=${CXX:-g++}
+OPT=${OPT:--Os}
+OUT=${TMPDIR:-/tmp}/tetris-bare-metal
+FLAGS="-std=c++20 $OPT -DTETRIS_BARE_METAL -fno-exceptions -fno-rtti
+       -fno-threadsafe-statics -fno-asynchronous-unwind-tables
+       -ffunction-sections -fdata-sections -ITetris"
+mkdir -p "$OUT"
+
+# No position independent code, so constant tables stay read only
+$CXX $FLAGS -fno-pic -c BareMetal/Core.cpp -o "$OUT/Core.o"
+
+echo "Core footprint ($CXX $OPT):"
+size "$OUT/Core.o" | awk 'NR == 2 {
+  printf "  ROM %d bytes (code and constants)\n", $1 + $2
+  printf "  RAM %d bytes (data %d, bss %d)\n", $2 + $3, $2, $3 }'
+
+UNWANTED='_Znw|_Zna|_Zdl|_Zda|malloc|free|__cxa_throw|__cxa_allocate|typeinfo|_ZTI'
+if nm -C -u "$OUT/Core.o" | grep -E "$UNWANTED"; then
+  echo "  core refers to heap, exception or RTTI support (above)"
+  exit 1
+fi
+echo "  no heap, exceptions or RTTI"
+
+$CXX $FLAGS BareMetal/TickBudget.cpp -o "$OUT/TickBudget"
+"$OUT/TickBudget" "$@"
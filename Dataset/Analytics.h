@@ -0,0 +1,511 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Statistics of self-played games gathered on the fly (POSIX)
+
+#ifndef __TETRIS_ANALYTICS_H__
+#define __TETRIS_ANALYTICS_H__
+
+#include "TetrisGame.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace Tetris
+{
+/// @brief Counts of placements and games
+///
+/// Every column is a flat array of counters, so counts of many threads and
+/// many periods are added up element by element.
+struct AnalyticsCounters
+{
+  /// Columns a figure can be placed in: its box may start two columns
+  /// left of the screen
+  static constexpr std::int32_t Columns{TetrisScreen::Width() + 3};
+  /// Most lines removed by a single placement
+  static constexpr std::int32_t LongestClear{4};
+  /// Buckets of game lengths, see _lengths
+  static constexpr std::int32_t LengthBuckets{65};
+
+  /// Sampled boards with a block in a cell, row by row
+  std::array<std::uint64_t, TetrisScreen::Depth() * TetrisScreen::Width()>
+      _occupancy;
+  /// Boards sampled for _occupancy
+  std::uint64_t _samples;
+  /// Placements by kind of the figure, rotation and column + 2
+  std::array<std::uint64_t, AnyFigure::Kinds * Game::Rotations * Columns>
+      _placements;
+  /// Placements by number of lines removed
+  std::array<std::uint64_t, LongestClear + 1> _clears;
+  /// Games by number of placements; bucket N counts games 2^(N-1) to
+  /// 2^N - 1 placements long
+  std::array<std::uint64_t, LengthBuckets> _lengths;
+
+  /// @brief Call f(name, counters) for every column
+  template <class Self, class F>
+  static void Each(Self &self, F f)
+  {
+    f("occupancy", std::span{self._occupancy});
+    f("samples", std::span{&self._samples, 1});
+    f("placements", std::span{self._placements});
+    f("clears", std::span{self._clears});
+    f("lengths", std::span{self._lengths});
+  }
+
+  void Add(const AnalyticsCounters &other)
+  {
+    auto add{[](auto &to, const auto &from) {
+      for (std::size_t i{0}; i < to.size(); i++)
+        to[i] += from[i];
+    }};
+    add(_occupancy, other._occupancy);
+    _samples += other._samples;
+    add(_placements, other._placements);
+    add(_clears, other._clears);
+    add(_lengths, other._lengths);
+  }
+
+  /// Number of games played to the end
+  std::uint64_t Games() const
+  {
+    std::uint64_t n{0};
+    for (auto c : _lengths)
+      n += c;
+    return n;
+  }
+
+  /// Number of placements
+  std::uint64_t Placements() const
+  {
+    std::uint64_t n{0};
+    for (auto c : _clears)
+      n += c;
+    return n;
+  }
+};
+
+/// @brief Counts of a period, as read back by ReadAnalytics
+struct AnalyticsBlock
+{
+  /// Period the counts were handed over in
+  std::uint64_t _epoch;
+  /// Milliseconds since the start of the run
+  std::uint64_t _ms;
+  AnalyticsCounters _counters;
+};
+
+/// @brief Statistics of games gathered while they are played
+///
+/// Every simulation thread opens its own Stream. Counting a placement is a
+/// few increments of counters owned by the thread, with no lock and no
+/// shared write; one board in SampleEvery is added to the occupancy
+/// heatmap.
+///
+/// Time is cut into epochs by a background thread. A stream has two banks
+/// of counters: when it sees a new epoch, it hands the filled bank over by
+/// a flag and goes on with the other one. The background thread adds the
+/// banks handed over to the totals of the epoch, clears them and gives
+/// them back. Then it appends the totals to the file as a block of
+/// columns, every counter a variable length integer, so counters that
+/// stay zero take a byte.
+///
+/// A block holds the counts handed over since the previous block. A
+/// stream that has nothing to count hands nothing over; its counts go to
+/// the file when it counts again or when it is closed.
+class Analytics
+{
+  struct Bank
+  {
+    AnalyticsCounters _counters{};
+    /// Bank is handed over; the stream must not touch it
+    std::atomic<bool> _sealed{false};
+  };
+
+  struct Shard
+  {
+    std::array<Bank, 2> _banks;
+  };
+
+public:
+  /// One board in SampleEvery placements is added to the occupancy
+  static constexpr std::int32_t SampleEvery{64};
+
+  /// @brief Counts of a single thread
+  class Stream
+  {
+  public:
+    Stream(Stream &&s)
+        : _owner{std::exchange(s._owner, nullptr)}
+        , _shard{std::move(s._shard)}
+        , _active{s._active}
+        , _epoch{s._epoch}
+        , _length{s._length}
+        , _untilSample{s._untilSample}
+    {
+    }
+
+    /// Hands over everything counted
+    ~Stream()
+    {
+      if (_owner != nullptr)
+        _owner->Close(*_shard);
+    }
+
+    /// @brief Count a placement
+    /// @param game - game after the placement
+    /// @param kind - kind of the placed figure, see AnyFigure::Make
+    /// @param rotation - rotation asked for, see Game::Place
+    /// @param outcome - result of the placement
+    void Placement(const Game &game, std::int32_t kind,
+                   std::int32_t rotation, const Game::Outcome &outcome)
+    {
+      auto epoch{_owner->_epoch.load(std::memory_order_relaxed)};
+      if (epoch != _epoch)
+        Seal(epoch);
+
+      auto &c{_shard->_banks[_active]._counters};
+      auto col{std::clamp(outcome._lockedAt._col + 2, 0,
+                          AnalyticsCounters::Columns - 1)};
+      c._placements[(kind * Game::Rotations + rotation % Game::Rotations) *
+                        AnalyticsCounters::Columns +
+                    col]++;
+      c._clears[std::min(outcome._cleared,
+                         AnalyticsCounters::LongestClear)]++;
+      _length++;
+
+      if (--_untilSample > 0)
+        return;
+      _untilSample = SampleEvery;
+      c._samples++;
+      auto board{game.Landed()};
+      for (std::int32_t r{0}; r < TetrisScreen::Depth(); r++)
+        for (std::int32_t col{0}; col < TetrisScreen::Width(); col++)
+          c._occupancy[r * TetrisScreen::Width() + col] +=
+              board.Lines()[r][col] != Colour::background;
+    }
+
+    /// @brief Count a game that is over
+    ///
+    /// Its length is the number of placements since the previous one.
+    void GameOver()
+    {
+      _shard->_banks[_active]._counters._lengths[std::bit_width(_length)]++;
+      _length = 0;
+    }
+
+  private:
+    friend class Analytics;
+
+    Stream(Analytics &owner, Shard &shard, std::uint64_t epoch)
+        : _owner{&owner}
+        , _shard{&shard}
+        , _epoch{epoch}
+    {
+    }
+
+    Analytics *_owner;
+    std::unique_ptr<Shard> _shard;
+    std::int32_t _active{0};
+    /// Epoch the active bank counts for
+    std::uint64_t _epoch;
+    /// Placements of the current game
+    std::uint64_t _length{0};
+    std::int32_t _untilSample{SampleEvery};
+
+    void Seal(std::uint64_t epoch)
+    {
+      _shard->_banks[_active]._sealed.store(true, std::memory_order_release);
+      _active = 1 - _active;
+      // The other bank was handed over an epoch ago and is free by now,
+      // unless the background thread is behind
+      _shard->_banks[_active]._sealed.wait(true, std::memory_order_acquire);
+      _epoch = epoch;
+    }
+  };
+
+  /// @brief Start the background thread
+  /// @param path - file the blocks are appended to
+  /// @param period - length of an epoch
+  explicit Analytics(const std::string &path,
+                     std::chrono::milliseconds period = std::chrono::seconds{1})
+      : _period{period}
+      , _fd{::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                   0644)}
+      , _thread{[this] { Run(); }}
+  {
+    if (_fd < 0)
+    {
+      std::perror(path.c_str());
+      _failed = true;
+    }
+  }
+
+  Analytics(const Analytics &) = delete;
+  void operator=(const Analytics &) = delete;
+
+  /// Writes the last block and closes the file. Streams must be closed
+  /// before.
+  /// See Close
+  ~Analytics() { Close(); }
+
+  /// @brief Write the last block and close the file
+  ///
+  /// Streams must be closed before. Failed() tells afterwards whether
+  /// every block has reached the file.
+  void Close()
+  {
+    if (!_thread.joinable())
+      return;
+    {
+      std::lock_guard<std::mutex> lock{_lock};
+      _stop = true;
+    }
+    _wake.notify_one();
+    _thread.join();
+    if (_fd >= 0 && ::close(_fd) != 0)
+      _failed = true;
+    _fd = -1;
+  }
+
+  /// @brief New stream of counts for a simulation thread
+  Stream Open()
+  {
+    std::lock_guard<std::mutex> lock{_lock};
+    auto shard{new Shard};
+    _shards.push_back(shard);
+    return Stream{*this, *shard, _epoch.load(std::memory_order_relaxed)};
+  }
+
+  /// Number of blocks written
+  std::uint64_t Blocks() const { return _blocks.load(); }
+
+  /// Writing of any block has failed
+  bool Failed() const { return _failed.load(); }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  /// Read by every stream at every placement, written once an epoch
+  alignas(64) std::atomic<std::uint64_t> _epoch{0};
+
+  std::chrono::milliseconds _period;
+  Clock::time_point _start{Clock::now()};
+  int _fd;
+
+  std::mutex _lock;
+  std::condition_variable _wake;
+  bool _stop{false};
+  std::vector<Shard *> _shards;
+  /// Counts handed over since the last block
+  AnalyticsCounters _pending{};
+
+  std::atomic<std::uint64_t> _blocks{0};
+  std::atomic<bool> _failed{false};
+
+  std::thread _thread;
+
+  void Run()
+  {
+    std::unique_lock<std::mutex> lock{_lock};
+    auto next{Clock::now() + _period};
+    while (!_stop)
+    {
+      _wake.wait_until(lock, next, [this] { return _stop; });
+      next += _period;
+      Collect();
+      Write();
+      // after the banks are collected, so a stream that sees the new
+      // epoch finds its other bank free
+      _epoch.fetch_add(1, std::memory_order_relaxed);
+    }
+    // streams are closed and their counts are pending
+    Write();
+  }
+
+  /// Add the banks handed over to the pending counts, with the lock held
+  void Collect()
+  {
+    for (auto shard : _shards)
+      for (auto &bank : shard->_banks)
+        if (bank._sealed.load(std::memory_order_acquire))
+        {
+          _pending.Add(bank._counters);
+          bank._counters = AnalyticsCounters{};
+          bank._sealed.store(false, std::memory_order_release);
+          bank._sealed.notify_one();
+        }
+  }
+
+  /// Counts of a closed stream are added at once
+  void Close(Shard &shard)
+  {
+    std::lock_guard<std::mutex> lock{_lock};
+    for (auto &bank : shard._banks)
+      _pending.Add(bank._counters);
+    std::erase(_shards, &shard);
+  }
+
+  static void PutVarint(std::string &out, std::uint64_t v)
+  {
+    for (; v >= 0x80; v >>= 7)
+      out += static_cast<char>(v | 0x80);
+    out += static_cast<char>(v);
+  }
+
+  /// Append the pending counts as a block and clear them
+  void Write()
+  {
+    if (_pending.Placements() == 0 && _pending.Games() == 0)
+      return;
+
+    // 'TAGG', version, epoch, time, columns: name, size, counters
+    std::string block{"TAGG\x01"};
+    PutVarint(block, _epoch.load(std::memory_order_relaxed));
+    std::chrono::duration<double, std::milli> ms{Clock::now() - _start};
+    PutVarint(block, static_cast<std::uint64_t>(ms.count()));
+    AnalyticsCounters::Each(_pending, [&block](std::string_view name,
+                                               auto c) {
+      PutVarint(block, name.size());
+      block += name;
+      PutVarint(block, c.size());
+      for (auto v : c)
+        PutVarint(block, v);
+    });
+    PutVarint(block, 0);
+    _pending = AnalyticsCounters{};
+
+    auto p{block.data()};
+    auto size{block.size()};
+    while (_fd >= 0 && size > 0)
+    {
+      auto n{::write(_fd, p, size)};
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+      {
+        _failed = true;
+        return;
+      }
+      p += n;
+      size -= n;
+    }
+    _blocks++;
+  }
+};
+
+/// @brief Read blocks written by Analytics
+///
+/// Columns are found by name; unknown ones are skipped, missing ones stay
+/// zero. Reading stops at the first block that is cut short.
+inline std::vector<AnalyticsBlock> ReadAnalytics(const std::string &path)
+{
+  std::vector<AnalyticsBlock> blocks;
+  auto file{std::fopen(path.c_str(), "rb")};
+  if (file == nullptr)
+    return blocks;
+  std::vector<std::uint8_t> data;
+  std::uint8_t buffer[1 << 16];
+  for (std::size_t n; (n = std::fread(buffer, 1, sizeof(buffer), file)) > 0;)
+    data.insert(data.end(), buffer, buffer + n);
+  std::fclose(file);
+
+  const auto *p{data.data()};
+  const auto *end{p + data.size()};
+  auto varint{[&p, end](std::uint64_t &v) {
+    v = 0;
+    for (std::int32_t shift{0}; p < end && shift < 64; shift += 7)
+    {
+      v |= std::uint64_t{*p & 0x7Fu} << shift;
+      if ((*p++ & 0x80) == 0)
+        return true;
+    }
+    return false;
+  }};
+
+  while (end - p >= 5 && std::string_view{reinterpret_cast<const char *>(p),
+                                          5} == "TAGG\x01")
+  {
+    p += 5;
+    AnalyticsBlock b{};
+    if (!varint(b._epoch) || !varint(b._ms))
+      break;
+    bool complete{false};
+    for (std::uint64_t length; varint(length);)
+    {
+      if (length == 0)
+      {
+        complete = true;
+        break;
+      }
+      std::uint64_t size{0};
+      if (static_cast<std::uint64_t>(end - p) < length)
+        break;
+      std::string_view name{reinterpret_cast<const char *>(p), length};
+      p += length;
+      if (!varint(size))
+        break;
+      std::span<std::uint64_t> column;
+      AnalyticsCounters::Each(b._counters, [&](std::string_view n, auto c) {
+        if (n == name)
+          column = c;
+      });
+      std::uint64_t v{0};
+      for (std::uint64_t i{0}; i < size && varint(v); i++)
+        if (i < column.size())
+          column[i] = v;
+    }
+    if (!complete)
+      break;
+    blocks.push_back(b);
+  }
+  return blocks;
+}
+
+} // namespace Tetris
+
+#endif //__TETRIS_ANALYTICS_H__
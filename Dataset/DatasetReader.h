@@ -0,0 +1,244 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Random access to transitions in mapped chunk files (POSIX)
+
+#ifndef __TETRIS_DATASET_READER_H__
+#define __TETRIS_DATASET_READER_H__
+
+#include "Transition.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace Tetris
+{
+/// @brief Permutation of [0, n) without a table
+///
+/// Index is encrypted with a small Feistel network over the smallest even
+/// number of bits that holds n. Values outside of the range are encrypted
+/// again until they fall into it (cycle walking). It takes a few
+/// nanoseconds and no memory, however big the dataset is.
+class Permutation
+{
+public:
+  Permutation(std::uint64_t n, std::uint64_t seed)
+      : _n{n}
+  {
+    while ((std::uint64_t{1} << (2 * _half)) < n)
+      _half++;
+    for (auto &key : _keys)
+      key = seed = Mix(seed + 0x9E3779B97F4A7C15ull);
+  }
+
+  /// @returns i-th element of the permutation
+  std::uint64_t operator()(std::uint64_t i) const
+  {
+    do
+      i = Encrypt(i);
+    while (i >= _n);
+    return i;
+  }
+
+private:
+  static constexpr std::int32_t Rounds{4};
+
+  std::uint64_t _n;
+  std::int32_t _half{1};
+  std::uint64_t _keys[Rounds];
+
+  /// splitmix64 finalizer
+  static std::uint64_t Mix(std::uint64_t x)
+  {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+  }
+
+  std::uint64_t Encrypt(std::uint64_t x) const
+  {
+    const std::uint64_t mask{(std::uint64_t{1} << _half) - 1};
+    auto left{x >> _half};
+    auto right{x & mask};
+    for (auto key : _keys)
+    {
+      auto next{left ^ (Mix(right ^ key) & mask)};
+      left  = right;
+      right = next;
+    }
+    return left << _half | right;
+  }
+};
+
+/// @brief Reads chunk files written by DatasetWriter
+///
+/// All chunks of a dataset are mapped into memory. Records are read in
+/// place; the operating system brings pages in as they are touched.
+class DatasetReader
+{
+public:
+  /// @brief Map all chunks of a dataset
+  /// @param prefix - the same as given to DatasetWriter
+  explicit DatasetReader(const std::string &prefix)
+  {
+    for (std::uint32_t chunk{0};; chunk++)
+    {
+      auto path{ChunkPath(prefix, chunk)};
+      int fd{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+      if (fd < 0)
+        break;
+      Map(fd);
+      ::close(fd);
+    }
+  }
+
+  DatasetReader(const DatasetReader &) = delete;
+  void operator=(const DatasetReader &) = delete;
+
+  ~DatasetReader()
+  {
+    for (auto &c : _chunks)
+      ::munmap(c._map, c._size);
+  }
+
+  /// Number of records in all chunks
+  std::uint64_t Size() const { return _first.empty() ? 0 : _first.back(); }
+
+  /// @brief Record by its index over all chunks
+  const Transition &operator[](std::uint64_t i) const
+  {
+    // _first is sorted; the chunk is the last one starting at or before i
+    auto c{std::upper_bound(_first.begin(), _first.end(), i) - _first.begin()};
+    return _chunks[c - 1]._records[i - _first[c - 1]];
+  }
+
+  /// @brief Records in a random order
+  ///
+  /// Every record is visited once. The order depends on the seed only.
+  class Shuffled
+  {
+  public:
+    class Iterator
+    {
+    public:
+      const Transition &operator*() const { return (*_r)[(*_p)(_i)]; }
+      Iterator &operator++()
+      {
+        _i++;
+        return *this;
+      }
+      bool operator!=(const Iterator &i) const { return _i != i._i; }
+
+    private:
+      friend class Shuffled;
+      Iterator(const DatasetReader &r, const Permutation &p, std::uint64_t i)
+          : _r{&r}
+          , _p{&p}
+          , _i{i}
+      {
+      }
+      const DatasetReader *_r;
+      const Permutation *_p;
+      std::uint64_t _i;
+    };
+
+    Shuffled(const DatasetReader &r, std::uint64_t seed)
+        : _r{r}
+        , _p{r.Size(), seed}
+    {
+    }
+
+    Iterator begin() const { return Iterator{_r, _p, 0}; }
+    Iterator end() const { return Iterator{_r, _p, _r.Size()}; }
+
+  private:
+    const DatasetReader &_r;
+    Permutation _p;
+  };
+
+  /// @brief Records in a random order, see Shuffled
+  Shuffled Shuffle(std::uint64_t seed) const { return Shuffled{*this, seed}; }
+
+private:
+  struct Chunk
+  {
+    void *_map;
+    std::size_t _size;
+    const Transition *_records;
+  };
+
+  std::vector<Chunk> _chunks;
+  /// Index of the first record of each chunk and the total at the end
+  std::vector<std::uint64_t> _first;
+
+  void Map(int fd)
+  {
+    struct stat st;
+    if (::fstat(fd, &st) < 0 || st.st_size < std::int64_t(sizeof(ChunkHeader)))
+      return;
+
+    std::size_t size{static_cast<std::size_t>(st.st_size)};
+    void *map{::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0)};
+    if (map == MAP_FAILED)
+      return;
+
+    ChunkHeader header;
+    std::memcpy(&header, map, sizeof(header));
+    if (header._magic != ChunkHeader::Magic ||
+        header._recordSize != sizeof(Transition))
+    {
+      ::munmap(map, size);
+      return;
+    }
+    // A chunk that was not closed has complete records up to its size
+    std::uint64_t count{(size - sizeof(header)) / sizeof(Transition)};
+    if (header._count != 0)
+      count = std::min(count, header._count);
+
+    auto records{reinterpret_cast<const Transition *>(
+        static_cast<const char *>(map) + sizeof(header))};
+    _chunks.push_back(Chunk{map, size, records});
+    if (_first.empty())
+      _first.push_back(0);
+    _first.push_back(_first.back() + count);
+  }
+};
+
+} // namespace Tetris
+
+#endif //__TETRIS_DATASET_READER_H__
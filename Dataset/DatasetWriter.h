@@ -0,0 +1,324 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Writing transitions to chunk files in background (POSIX)
+
+#ifndef __TETRIS_DATASET_WRITER_H__
+#define __TETRIS_DATASET_WRITER_H__
+
+#include "Transition.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace Tetris
+{
+/// @brief Streams transitions to a set of chunk files
+///
+/// Every simulation thread opens its own Stream. A stream owns two
+/// buffers: one is filled by the simulation while the other one is written
+/// by the writer thread. A full buffer is handed to the writer and the
+/// simulation goes on with the other one, so it waits only if the disk
+/// cannot keep up with it. The writer appends whole buffers to the current
+/// chunk and starts a new chunk when it is full.
+///
+/// Records of different streams are interleaved buffer by buffer.
+class DatasetWriter
+{
+  struct Buffer
+  {
+    std::vector<Transition> _records;
+    /// Buffer is being written; the stream must not touch it
+    std::atomic<bool> _busy{false};
+  };
+
+public:
+  /// @brief Source of transitions of a single thread
+  class Stream
+  {
+  public:
+    Stream(Stream &&s)
+        : _writer{std::exchange(s._writer, nullptr)}
+        , _buffers{std::move(s._buffers)}
+        , _active{s._active}
+    {
+    }
+
+    /// Hands over the records that have not been written yet
+    ~Stream()
+    {
+      if (_writer == nullptr)
+        return;
+      Flush();
+      for (auto &b : _buffers)
+        b->_busy.wait(true);
+    }
+
+    /// @brief Add a record
+    void Push(const Transition &t)
+    {
+      auto &records{_buffers[_active]->_records};
+      records.push_back(t);
+      if (records.size() == records.capacity())
+        Flush();
+    }
+
+    /// @brief Hand over the current buffer to the writer
+    void Flush()
+    {
+      auto &full{*_buffers[_active]};
+      if (full._records.empty())
+        return;
+      full._busy.store(true);
+      _writer->Submit(full);
+
+      _active = 1 - _active;
+      // The other buffer is free unless the disk is behind
+      _buffers[_active]->_busy.wait(true);
+    }
+
+  private:
+    friend class DatasetWriter;
+
+    Stream(DatasetWriter &writer, std::size_t records)
+        : _writer{&writer}
+    {
+      for (auto &b : _buffers)
+      {
+        b = std::make_unique<Buffer>();
+        b->_records.reserve(records);
+      }
+    }
+
+    DatasetWriter *_writer;
+    std::array<std::unique_ptr<Buffer>, 2> _buffers;
+    std::int32_t _active{0};
+  };
+
+  /// @brief Start the writer thread
+  /// @param prefix - path and beginning of the name of chunk files
+  /// @param chunkRecords - records in a chunk file
+  /// @param bufferRecords - records in each buffer of a stream
+  explicit DatasetWriter(std::string prefix,
+                         std::uint64_t chunkRecords = 1 << 22,
+                         std::size_t bufferRecords = 1 << 16)
+      : _prefix{std::move(prefix)}
+      , _chunkRecords{chunkRecords}
+      , _bufferRecords{bufferRecords}
+      , _thread{[this] { Run(); }}
+  {
+  }
+
+  DatasetWriter(const DatasetWriter &) = delete;
+  void operator=(const DatasetWriter &) = delete;
+
+  /// See Close
+  ~DatasetWriter() { Close(); }
+
+  /// @brief Write all submitted buffers and close the last chunk
+  ///
+  /// Streams must be closed before. Failed() tells afterwards whether
+  /// everything has reached the files.
+  void Close()
+  {
+    if (!_thread.joinable())
+      return;
+    {
+      std::lock_guard<std::mutex> lock{_lock};
+      _stop = true;
+    }
+    _ready.notify_one();
+    _thread.join();
+  }
+
+  /// @brief New source of records for a simulation thread
+  Stream Open() { return Stream{*this, _bufferRecords}; }
+
+  /// Number of records written to files
+  std::uint64_t Written() const { return _written.load(); }
+
+  /// Writing of any chunk has failed
+  bool Failed() const { return _failed.load(); }
+
+private:
+  std::string _prefix;
+  std::uint64_t _chunkRecords;
+  std::size_t _bufferRecords;
+
+  std::mutex _lock;
+  std::condition_variable _ready;
+  std::deque<Buffer *> _queue;
+  bool _stop{false};
+
+  std::atomic<std::uint64_t> _written{0};
+  std::atomic<bool> _failed{false};
+
+  /// Current chunk file, used by the writer thread only
+  int _fd{-1};
+  std::uint32_t _chunk{0};
+  std::uint64_t _inChunk{0};
+
+  std::thread _thread;
+
+  void Submit(Buffer &b)
+  {
+    {
+      std::lock_guard<std::mutex> lock{_lock};
+      _queue.push_back(&b);
+    }
+    _ready.notify_one();
+  }
+
+  void Run()
+  {
+    RemoveStaleChunks();
+    while (1)
+    {
+      Buffer *b{nullptr};
+      {
+        std::unique_lock<std::mutex> lock{_lock};
+        _ready.wait(lock, [this] { return _stop || !_queue.empty(); });
+        if (_queue.empty())
+          break;
+        b = _queue.front();
+        _queue.pop_front();
+      }
+
+      Write(b->_records.data(), b->_records.size());
+      b->_records.clear();
+      b->_busy.store(false);
+      b->_busy.notify_one();
+    }
+    CloseChunk();
+  }
+
+  /// Append records, spread over as many chunks as needed
+  void Write(const Transition *records, std::uint64_t count)
+  {
+    while (count > 0)
+    {
+      if (_fd < 0 && !OpenChunk())
+        return;
+
+      auto n{std::min(count, _chunkRecords - _inChunk)};
+      if (!WriteAll(records, n * sizeof(Transition)))
+        _failed = true;
+      records += n;
+      count -= n;
+      _inChunk += n;
+      _written += n;
+      if (_inChunk == _chunkRecords)
+        CloseChunk();
+    }
+  }
+
+  /// @brief Remove chunks of an earlier, longer run with the same prefix
+  ///
+  /// A reader takes chunks up to the first missing one, so they would be
+  /// read after the chunks of this run.
+  void RemoveStaleChunks()
+  {
+    std::uint32_t i{1};
+    while (::unlink(ChunkPath(_prefix, i).c_str()) == 0)
+      i++;
+    if (errno != ENOENT)
+    {
+      std::perror(ChunkPath(_prefix, i).c_str());
+      _failed = true;
+    }
+  }
+
+  bool OpenChunk()
+  {
+    auto path{ChunkPath(_prefix, _chunk++)};
+    _fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    _inChunk = 0;
+    ChunkHeader header{};
+    if (_fd < 0 || !WriteAll(&header, sizeof(header)))
+    {
+      std::perror(path.c_str());
+      if (_fd >= 0)
+        ::close(_fd);
+      _fd     = -1;
+      _failed = true;
+      return false;
+    }
+    return true;
+  }
+
+  /// Completes the chunk's header
+  void CloseChunk()
+  {
+    if (_fd < 0)
+      return;
+    ChunkHeader header{};
+    header._count = _inChunk;
+    if (::pwrite(_fd, &header, sizeof(header), 0) != sizeof(header))
+      _failed = true;
+    if (::close(_fd) != 0)
+      _failed = true;
+    _fd = -1;
+  }
+
+  bool WriteAll(const void *data, std::size_t size)
+  {
+    auto p{static_cast<const char *>(data)};
+    while (size > 0)
+    {
+      auto n{::write(_fd, p, size)};
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      p += n;
+      size -= n;
+    }
+    return true;
+  }
+};
+
+} // namespace Tetris
+
+#endif //__TETRIS_DATASET_WRITER_H__
@@ -0,0 +1,183 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Self-play writing every transition to a dataset (POSIX)
+///
+/// Every thread plays its own games with random placements and streams
+/// the transitions to a DatasetWriter and its counts to Analytics. At the
+/// end the dataset is mapped and read back in a shuffled order, and the
+/// statistics are read back and summed up.
+///
+/// Usage: SelfPlay [path prefix] [threads] [seconds]
+
+#include "Analytics.h"
+#include "DatasetReader.h"
+#include "DatasetWriter.h"
+#include "Policy.h"
+#include "Random.h"
+#include "TetrisGame.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+std::uint64_t Play(Tetris::DatasetWriter &writer, Tetris::Analytics &analytics,
+                   std::uint32_t seed, const std::atomic<bool> &stop)
+{
+  using namespace Tetris;
+
+  auto stream{writer.Open()};
+  auto counts{analytics.Open()};
+  Random policy{seed};
+  Game game{seed};
+  std::uint64_t count{0};
+  while (!stop.load(std::memory_order_relaxed))
+  {
+    auto t{Transition::Capture(game)};
+    auto action{policy.Below(Placements)};
+    auto kind{game.Current().Kind()};
+    auto p{PlacementAt(action)};
+    auto outcome{game.Place(p._rotation, p._col)};
+    t.Result(action, game);
+    stream.Push(t);
+    counts.Placement(game, kind, p._rotation, outcome);
+    count++;
+
+    if (game.Over())
+    {
+      counts.GameOver();
+      game.Reset(policy());
+    }
+  }
+  return count;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  const char *prefix{argc > 1 ? argv[1] : "/tmp/tetris-dataset"};
+  std::int32_t threads{argc > 2 ? std::atoi(argv[2]) : 0};
+  double seconds{argc > 3 ? std::atof(argv[3]) : 5.0};
+  if (threads <= 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+
+  std::optional<Tetris::DatasetWriter> writer{std::in_place, prefix};
+  std::string statistics{std::string{prefix} + ".tagg"};
+  std::optional<Tetris::Analytics> analytics{std::in_place, statistics};
+  std::atomic<bool> stop{false};
+  std::vector<std::uint64_t> counts(threads);
+  std::vector<std::thread> players;
+  auto start{Clock::now()};
+  for (std::int32_t i{0}; i < threads; i++)
+    players.emplace_back(
+        [&, i] { counts[i] = Play(*writer, *analytics, i + 1, stop); });
+
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  stop = true;
+  for (auto &p : players)
+    p.join();
+  // Closing the writer waits for the last buffers to reach the files
+  writer->Close();
+  analytics->Close();
+  bool failed{writer->Failed() || analytics->Failed()};
+  writer.reset();
+  analytics.reset();
+  auto elapsed{std::chrono::duration<double>(Clock::now() - start).count()};
+
+  std::uint64_t played{0};
+  for (auto c : counts)
+    played += c;
+  std::printf("%llu transitions in %.2f s on %d threads: %.2f M/s%s\n",
+              static_cast<unsigned long long>(played), elapsed, threads,
+              played / elapsed / 1e6, failed ? ", WRITE FAILED" : "");
+
+  Tetris::DatasetReader reader{prefix};
+  start = Clock::now();
+  std::uint64_t lines{0};
+  std::uint64_t over{0};
+  for (const auto &t : reader.Shuffle(1))
+  {
+    lines += t._cleared;
+    over += (t._flags & Tetris::Transition::Over) != 0;
+  }
+  elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+  std::printf("read %llu records shuffled in %.2f s: %.2f M/s, "
+              "%llu lines, %llu games over\n",
+              static_cast<unsigned long long>(reader.Size()), elapsed,
+              reader.Size() / elapsed / 1e6,
+              static_cast<unsigned long long>(lines),
+              static_cast<unsigned long long>(over));
+
+  Tetris::AnalyticsCounters total{};
+  auto blocks{Tetris::ReadAnalytics(statistics)};
+  for (const auto &b : blocks)
+    total.Add(b._counters);
+  auto games{total.Games()};
+  std::printf("statistics in %zu blocks: %llu placements, %llu games, "
+              "%.1f placements per game\n",
+              blocks.size(),
+              static_cast<unsigned long long>(total.Placements()),
+              static_cast<unsigned long long>(games),
+              games ? static_cast<double>(total.Placements()) / games : 0.0);
+  std::printf("lines removed at once:");
+  for (std::size_t i{0}; i < total._clears.size(); i++)
+    std::printf(" %zu: %llu", i,
+                static_cast<unsigned long long>(total._clears[i]));
+  std::printf("\noccupancy, tenths of sampled boards:\n");
+  constexpr std::int32_t Width{Tetris::TetrisScreen::Width()};
+  for (std::int32_t r{0}; r < Tetris::TetrisScreen::Depth(); r++)
+  {
+    std::printf("  ");
+    for (std::int32_t c{0}; c < Width; c++)
+    {
+      auto cell{total._occupancy[r * Width + c]};
+      std::printf("%d", total._samples == 0
+                            ? 0
+                            : static_cast<int>(std::min<std::uint64_t>(
+                                  9, cell * 10 / total._samples)));
+    }
+    std::printf("\n");
+  }
+
+  return reader.Size() == played && total.Placements() == played && !failed
+             ? 0
+             : 1;
+}
@@ -0,0 +1,134 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Fixed width record of a single move of a game
+
+#ifndef __TETRIS_TRANSITION_H__
+#define __TETRIS_TRANSITION_H__
+
+#include "Command.h"
+#include "TetrisGame.h"
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace Tetris
+{
+/// @brief State of a game, the action taken and its result
+///
+/// A record is 16 bytes and has no pointers or padding, so records can be
+/// written to a file as they are and read back from a mapped file in place.
+struct Transition
+{
+  /// Flags of a transition
+  enum : std::uint8_t
+  {
+    Placement = 1, ///< Action is a placement, not a Command
+    Over      = 2  ///< The game was over after the action
+  };
+
+  /// Screen before the action, bit N of a row is column N
+  std::array<std::uint8_t, TetrisScreen::Depth()> _rows;
+  /// Kind of the falling figure, see AnyFigure::Make
+  std::uint8_t _figure;
+  /// Position of the falling figure
+  std::int8_t _row;
+  std::int8_t _col;
+  /// Command or index of a placement, see PlacementAt
+  std::uint8_t _action;
+  /// Lines removed by the action
+  std::uint8_t _cleared;
+  /// Combination of flags
+  std::uint8_t _flags;
+
+  /// @brief Record the state of a game before an action
+  ///
+  /// Action and its result are filled in by Result.
+  static Transition Capture(const Game &game)
+  {
+    Transition t{};
+    for (std::int32_t r{0}; r < TetrisScreen::Depth(); r++)
+      t._rows[r] = static_cast<std::uint8_t>(LineMask(game.Board().Lines()[r]));
+    t._figure = static_cast<std::uint8_t>(game.Current().Kind());
+    t._row    = static_cast<std::int8_t>(game.Current()->Pos()._row);
+    t._col    = static_cast<std::int8_t>(game.Current()->Pos()._col);
+    return t;
+  }
+
+  /// @brief Record a command and its result
+  void Result(Command cmd, const Game &game)
+  {
+    _action  = static_cast<std::uint8_t>(cmd);
+    _cleared = static_cast<std::uint8_t>(game.Cleared());
+    _flags   = game.Over() ? Over : 0;
+  }
+
+  /// @brief Record a placement and its result
+  void Result(std::int32_t placement, const Game &game)
+  {
+    _action  = static_cast<std::uint8_t>(placement);
+    _cleared = static_cast<std::uint8_t>(game.Cleared());
+    _flags   = Placement | (game.Over() ? Over : 0);
+  }
+};
+
+static_assert(TetrisScreen::Width() <= 8, "Row must fit a byte");
+static_assert(sizeof(Transition) == 16, "Records are written as they are");
+
+/// @brief Header at the beginning of each chunk file
+struct ChunkHeader
+{
+  static constexpr std::array<char, 4> Magic{'T', 'T', 'R', 'N'};
+  static constexpr std::uint16_t Version{1};
+
+  std::array<char, 4> _magic{Magic};
+  std::uint16_t _version{Version};
+  std::uint16_t _recordSize{sizeof(Transition)};
+  /// Records in the chunk. Zero if the writer did not finish the chunk;
+  /// then the size of the file tells how many records are complete.
+  std::uint64_t _count{0};
+};
+
+static_assert(sizeof(ChunkHeader) == 16, "Header keeps records aligned");
+
+/// @brief Name of a chunk file: prefix followed by the chunk's number
+inline std::string ChunkPath(const std::string &prefix, std::uint32_t chunk)
+{
+  char number[16];
+  std::snprintf(number, sizeof(number), "-%06u.bin", chunk);
+  return prefix + number;
+}
+
+} // namespace Tetris
+
+#endif //__TETRIS_TRANSITION_H__
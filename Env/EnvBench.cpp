@@ -0,0 +1,116 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Throughput of a batch of games over threads and NUMA nodes
+///
+/// The same batch is stepped with placements on 1, 2, 4... threads up to
+/// the number of CPUs. Threads fill one node before the next, so the
+/// report shows how stepping scales within a socket and across sockets,
+/// and how many reads went to memory of another node.
+///
+/// Usage: EnvBench [games] [steps] [max threads]
+
+#include "NodeArena.h"
+#include "TetrisEnv.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+int main(int argc, char *argv[])
+{
+  auto topology{Tetris::Topology::Read()};
+  std::int32_t games{argc > 1 ? std::atoi(argv[1]) : 4096};
+  std::int32_t steps{argc > 2 ? std::atoi(argv[2]) : 200};
+  std::int32_t most{argc > 3 ? std::atoi(argv[3])
+                             : static_cast<std::int32_t>(
+                                   topology._cpus.size())};
+  most = std::max(most, 1);
+  std::printf("%zu CPUs on %d nodes\n", topology._cpus.size(),
+              topology._nodeCount);
+
+  std::vector<std::int32_t> actions(games);
+  std::vector<float> rewards(games);
+  std::vector<std::uint8_t> dones(games);
+  TetrisEnvBuffers out{nullptr, nullptr, rewards.data(), dones.data()};
+
+  double single{0};
+  for (std::int32_t threads{1};; threads = std::min(threads * 2, most))
+  {
+    auto env{tetris_env_create(games, 1, TETRIS_ENV_PLACEMENTS, 0, threads)};
+    if (!env)
+    {
+      std::fprintf(stderr, "cannot make %d games on %d threads\n", games,
+                   threads);
+      return EXIT_FAILURE;
+    }
+    tetris_env_reset(env, &out);
+    std::uint64_t loads0{0}, remote0{0};
+    tetris_env_node_loads(env, &loads0, &remote0);
+
+    std::uint32_t r{1};
+    auto start{std::chrono::steady_clock::now()};
+    for (std::int32_t s{0}; s < steps; s++)
+    {
+      for (auto &a : actions)
+        a = static_cast<std::int32_t>((r = r * 1664525u + 1013904223u) >>
+                                      16) %
+            tetris_env_actions(env);
+      tetris_env_step(env, actions.data(), &out);
+    }
+    std::chrono::duration<double> elapsed{std::chrono::steady_clock::now() -
+                                          start};
+
+    std::uint64_t loads{0}, remote{0};
+    bool counted{tetris_env_node_loads(env, &loads, &remote) != 0};
+    tetris_env_destroy(env);
+
+    auto rate{static_cast<double>(games) * steps / elapsed.count()};
+    if (threads == 1)
+      single = rate;
+    std::printf("%3d threads: %.2f M placements/s, %.2fx", threads,
+                rate / 1e6, rate / single);
+    if (counted)
+      std::printf(", %llu node reads, %.1f%% remote",
+                  static_cast<unsigned long long>(loads - loads0),
+                  loads == loads0 ? 0.0
+                                  : 100.0 * (remote - remote0) /
+                                        (loads - loads0));
+    else
+      std::printf(", node reads not counted here");
+    std::printf("\n");
+    if (threads == most)
+      break;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,279 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Batch of games as a C library, implementation
+///
+/// Games sit on top of Tetris::Game, so the rules are exactly those of
+/// the game. The batch is split into equal slices, one per thread, stepped
+/// by a SimRuntime: threads are started once, so stepping does not
+/// allocate and does not create threads. Games of a slice are made by
+/// their thread in its own arena, on its NUMA node.
+
+#include "Policy.h"
+#include "SimRuntime.h"
+#include "TetrisEnv.h"
+#include "TetrisGame.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+using namespace Tetris;
+
+static_assert(TETRIS_ENV_ROWS == TetrisScreen::Depth());
+static_assert(TETRIS_ENV_COLS == TetrisScreen::Width());
+static_assert(TETRIS_ENV_PREVIEW == Game::Preview);
+static_assert(TETRIS_ENV_PLACE_LEFT == PlacementLeft);
+static_assert(TETRIS_ENV_PLACE_COLS == PlacementColumns);
+
+struct TetrisEnv
+{
+  TetrisEnv(std::int32_t count, std::uint32_t seed, std::int32_t actions,
+            std::int32_t gravity, std::int32_t threads)
+      : _actions{actions}
+      , _gravity{gravity}
+      , _count{count}
+      , _runtime{threads, ArenaBytes(count, threads)}
+      , _slices(threads)
+  {
+    // Every game has its own stream of seeds, so episodes do not depend
+    // on the order games are stepped in
+    Random seeds{seed};
+    std::vector<std::uint32_t> first(count);
+    for (auto &s : first)
+      s = seeds();
+
+    _runtime.Run([this, &first, threads](std::int32_t t) {
+      auto &s{_slices[t]};
+      s._begin = _count * t / threads;
+      s._end   = _count * (t + 1) / threads;
+      auto n{static_cast<std::size_t>(s._end - s._begin)};
+      auto &arena{_runtime.Arena(t)};
+      s._seeds = arena.Array<Random>(n, [&first, &s](std::size_t i) {
+        return Random{first[s._begin + i]};
+      });
+      // a full arena gives nullptr, see Ok
+      if (s._seeds)
+        s._games = arena.Array<Game>(
+            n, [&s](std::size_t i) { return Game{s._seeds[i]()}; });
+      s._steps = arena.Array<std::int32_t>(n, [](std::size_t) { return 0; });
+    });
+  }
+
+  /// Every thread got memory for its games, see NodeArena::Array
+  bool Ok() const
+  {
+    for (const auto &s : _slices)
+      if (!s._seeds || !s._games || !s._steps)
+        return false;
+    return true;
+  }
+
+  std::int32_t Count() const { return _count; }
+
+  std::int32_t Actions() const
+  {
+    if (_actions == TETRIS_ENV_PLACEMENTS)
+      return Placements;
+    return static_cast<std::int32_t>(Command::TranslateDown) + 1;
+  }
+
+  /// Step every game, or start it again if 'actions' is null
+  void Run(const std::int32_t *actions, const TetrisEnvBuffers *out)
+  {
+    _runtime.Run([this, actions, out](std::int32_t t) {
+      StepSlice(_slices[t], actions, out);
+    });
+  }
+
+  /// Reads of memory of all threads, see SimRuntime::Traffic
+  NodeTraffic Traffic() const { return _runtime.Traffic(); }
+
+private:
+  /// Games of a thread, in the thread's arena
+  struct Slice
+  {
+    /// Indexes of the games in the batch
+    std::int32_t _begin;
+    std::int32_t _end;
+    /// Seeds of following episodes of every game
+    Random *_seeds;
+    Game *_games;
+    /// Steps since the game started, for gravity
+    std::int32_t *_steps;
+  };
+
+  std::int32_t _actions;
+  std::int32_t _gravity;
+  std::int32_t _count;
+  SimRuntime _runtime;
+  std::vector<Slice> _slices;
+
+  static std::size_t ArenaBytes(std::int32_t count, std::int32_t threads)
+  {
+    auto n{static_cast<std::size_t>((count + threads - 1) / threads)};
+    return n * (sizeof(Random) + sizeof(Game) + sizeof(std::int32_t)) +
+           3 * CacheLine;
+  }
+
+  void StepSlice(const Slice &s, const std::int32_t *actions,
+                 const TetrisEnvBuffers *out)
+  {
+    for (std::int32_t k{0}; k < s._end - s._begin; k++)
+    {
+      auto i{s._begin + k};
+      float reward{0};
+      bool done{true};
+      if (actions)
+      {
+        reward = static_cast<float>(Step(s, k, actions[i]));
+        done   = s._games[k].Over();
+      }
+      if (done)
+      {
+        s._games[k].Reset(s._seeds[k]());
+        s._steps[k] = 0;
+      }
+      Write(s._games[k], i, reward, done, out);
+    }
+  }
+
+  /// @returns lines removed
+  std::int32_t Step(const Slice &s, std::int32_t k, std::int32_t action)
+  {
+    auto &game{s._games[k]};
+    if (action < 0 || action >= Actions())
+    {
+      // every placement lands the figure, so none of them is idle
+      if (_actions == TETRIS_ENV_PLACEMENTS)
+        return 0;
+      action = static_cast<std::int32_t>(Command::Idle);
+    }
+
+    if (_actions == TETRIS_ENV_PLACEMENTS)
+    {
+      auto p{PlacementAt(action)};
+      return game.Place(p._rotation, p._col)._cleared;
+    }
+
+    std::array<Command, 2> cmds{static_cast<Command>(action),
+                                Command::TranslateDown};
+    std::size_t n{1};
+    if (_gravity > 0 && ++s._steps[k] % _gravity == 0)
+      n = 2;
+    return game.Apply(std::span{cmds.data(), n})._cleared;
+  }
+
+  static void Write(const Game &game, std::int32_t i, float reward, bool done,
+                    const TetrisEnvBuffers *out)
+  {
+    if (!out)
+      return;
+    if (out->rewards)
+      out->rewards[i] = reward;
+    if (out->dones)
+      out->dones[i] = done;
+
+    if (out->boards)
+    {
+      // Board without the falling figure tells landed blocks apart
+      auto landed{game.Landed()};
+
+      auto *board{out->boards + i * TETRIS_ENV_ROWS * TETRIS_ENV_COLS};
+      for (std::int32_t r{0}; r < TETRIS_ENV_ROWS; r++)
+      {
+        auto all{LineMask(game.Board().Lines()[r])};
+        auto still{LineMask(landed.Lines()[r])};
+        for (std::int32_t c{0}; c < TETRIS_ENV_COLS; c++)
+          *board++ = static_cast<std::uint8_t>(
+              (still >> c & 1) ? 1 : (all >> c & 1) ? 2 : 0);
+      }
+    }
+
+    if (out->pieces)
+    {
+      auto *piece{out->pieces + i * TETRIS_ENV_PIECE};
+      piece[0] = game.Current().Kind();
+      piece[1] = game.Current()->Pos()._row;
+      piece[2] = game.Current()->Pos()._col;
+      for (std::int32_t n{0}; n < Game::Preview; n++)
+        piece[3 + n] = game.Next(n);
+    }
+  }
+};
+
+TetrisEnv *tetris_env_create(int32_t count, uint32_t seed, int32_t actions,
+                             int32_t gravity, int32_t threads)
+{
+  if (count <= 0 || gravity < 0 ||
+      (actions != TETRIS_ENV_COMMANDS && actions != TETRIS_ENV_PLACEMENTS))
+    return nullptr;
+
+  if (threads < 1)
+    threads = 1;
+  if (threads > count)
+    threads = count;
+  auto *env{new TetrisEnv{count, seed, actions, gravity, threads}};
+  if (!env->Ok())
+  {
+    delete env;
+    return nullptr;
+  }
+  return env;
+}
+
+void tetris_env_destroy(TetrisEnv *env) { delete env; }
+
+int32_t tetris_env_count(const TetrisEnv *env) { return env->Count(); }
+
+int32_t tetris_env_actions(const TetrisEnv *env) { return env->Actions(); }
+
+void tetris_env_reset(TetrisEnv *env, const TetrisEnvBuffers *out)
+{
+  env->Run(nullptr, out);
+}
+
+void tetris_env_step(TetrisEnv *env, const int32_t *actions,
+                     const TetrisEnvBuffers *out)
+{
+  env->Run(actions, out);
+}
+
+int32_t tetris_env_node_loads(const TetrisEnv *env, uint64_t *loads,
+                              uint64_t *remote)
+{
+  auto t{env->Traffic()};
+  if (loads)
+    *loads = t._loads;
+  if (remote)
+    *remote = t._remote;
+  return t._available ? 1 : 0;
+}
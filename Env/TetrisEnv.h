@@ -0,0 +1,164 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Batch of games as a C library for reinforcement learning
+///
+/// A single handle holds many independent games. One call steps all of
+/// them and writes observations, rewards and done flags straight into
+/// buffers owned by the caller, e.g. numpy arrays, so nothing is copied
+/// or allocated per step. A game that is over is started again with a
+/// new seed in the same call; its 'done' flag is set and observation
+/// already shows the new game.
+
+#ifndef __TETRIS_ENV_H__
+#define __TETRIS_ENV_H__
+
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(TETRIS_ENV_EXPORTS)
+#define TETRIS_ENV_API __declspec(dllexport)
+#elif defined(_WIN32)
+#define TETRIS_ENV_API __declspec(dllimport)
+#else
+#define TETRIS_ENV_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Size of observation buffers
+enum
+{
+  TETRIS_ENV_ROWS    = 10, ///< Rows of a board
+  TETRIS_ENV_COLS    = 8,  ///< Columns of a board
+  TETRIS_ENV_PREVIEW = 3,  ///< Upcoming figures in an observation
+  /// Values per game in 'pieces': kind, row, column, next kinds
+  TETRIS_ENV_PIECE = 3 + TETRIS_ENV_PREVIEW,
+  /// Leftmost column a placement moves the figure's box to; blocks of a
+  /// vertical figure start right of its box, so the box may have to go
+  /// left of the board for them to reach column 0
+  TETRIS_ENV_PLACE_LEFT = -3,
+  /// Columns a placement can ask for, TETRIS_ENV_PLACE_LEFT .. COLS - 1
+  TETRIS_ENV_PLACE_COLS = TETRIS_ENV_COLS - TETRIS_ENV_PLACE_LEFT
+};
+
+/// @brief Meaning of an action
+enum TetrisEnvActions
+{
+  /// Action is a Tetris::Command value: 0 idle, 1 rotate left,
+  /// 2 rotate right, 3 left, 4 right, 5 down.
+  TETRIS_ENV_COMMANDS = 0,
+  /// Action is 'rotation * TETRIS_ENV_PLACE_COLS + c'. The figure is
+  /// rotated right 'rotation' times (0..3), its box is moved towards
+  /// column 'c + TETRIS_ENV_PLACE_LEFT' as far as it can go and the
+  /// figure is dropped. Every step places one figure. Actions that hit a
+  /// wall land like their neighbours; every landing has an action.
+  TETRIS_ENV_PLACEMENTS = 1
+};
+
+/// @brief Buffers the observations are written to
+///
+/// Every buffer holds values of all games, game after game.
+typedef struct TetrisEnvBuffers
+{
+  /// [count][ROWS][COLS]: 0 empty, 1 landed block, 2 falling figure
+  uint8_t *boards;
+  /// [count][PIECE]: falling figure kind, row and column, followed by
+  /// kinds of upcoming figures. Kinds: 0 big square (also the O
+  /// tetromino), 1 bar, 2 T, 3 square, 4 I, 5 J, 6 L, 7 S, 8 T tetromino,
+  /// 9 Z; see Tetris::AnyFigure::Make
+  int32_t *pieces;
+  /// [count]: lines removed by the step
+  float *rewards;
+  /// [count]: 1 if the game was over and has been started again
+  uint8_t *dones;
+} TetrisEnvBuffers;
+
+typedef struct TetrisEnv TetrisEnv;
+
+/// @brief Create a batch of games
+/// @param count - number of games
+/// @param seed - seed of the first game; following games and episodes get
+///   seeds derived from it, so a batch is repeatable
+/// @param actions - one of TetrisEnvActions
+/// @param gravity - in command mode, the figure moves down by itself
+///   every 'gravity' steps; 0 disables it
+/// @param threads - number of threads stepping the batch, including the
+///   caller's; 0 or 1 steps on the caller's thread only
+/// @returns handle, or NULL on invalid arguments or when memory for the
+///   games cannot be had
+TETRIS_ENV_API TetrisEnv *tetris_env_create(int32_t count, uint32_t seed,
+                                            int32_t actions, int32_t gravity,
+                                            int32_t threads);
+
+/// @brief Destroy a batch and stop its threads
+TETRIS_ENV_API void tetris_env_destroy(TetrisEnv *env);
+
+/// @returns number of games in the batch
+TETRIS_ENV_API int32_t tetris_env_count(const TetrisEnv *env);
+
+/// @returns number of different action values, valid actions are
+///   0 .. tetris_env_actions() - 1
+TETRIS_ENV_API int32_t tetris_env_actions(const TetrisEnv *env);
+
+/// @brief Start all games again and write their observations
+///
+/// Rewards are set to 0 and done flags to 1. Any buffer may be NULL.
+TETRIS_ENV_API void tetris_env_reset(TetrisEnv *env,
+                                     const TetrisEnvBuffers *out);
+
+/// @brief Step all games
+/// @param actions - [count] action of every game; invalid values are idle:
+///   a command game still falls by gravity, a placement game is left as
+///   it is and gets reward 0
+/// @param out - observations after the step; any buffer may be NULL
+TETRIS_ENV_API void tetris_env_step(TetrisEnv *env, const int32_t *actions,
+                                    const TetrisEnvBuffers *out);
+
+/// @brief Reads of memory made by the threads of a batch so far
+///
+/// Threads are pinned to CPUs and their games are in memory of their own
+/// NUMA node; this tells how well it works. Counts come from performance
+/// counters, which the CPU or the system may not provide.
+/// @param loads - reads served by memory of any node; may be NULL
+/// @param remote - reads served by memory of another node; may be NULL
+/// @returns 1 if counts are available, 0 otherwise
+TETRIS_ENV_API int32_t tetris_env_node_loads(const TetrisEnv *env,
+                                             uint64_t *loads,
+                                             uint64_t *remote);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__TETRIS_ENV_H__
@@ -0,0 +1,590 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Differential fuzzer of the engine against the reference rules
+///
+/// Random boards and random streams of commands are played by Game and by
+/// ReferenceGame side by side. Records of both games are compared after
+/// every step. The first difference is shrunk to a short replay: steps,
+/// commands and blocks of the board that are not needed to show it are
+/// taken out. The replay is printed and can be played again.
+///
+/// Usage: DiffFuzz [steps] [seed] [threads]
+///        DiffFuzz replay <file>
+
+#include "ReferenceGame.h"
+#include "TetrisGame.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using namespace Tetris;
+
+/// What a step of a case does
+enum class Op : std::uint8_t
+{
+  tick,   ///< Input and Tick of _cmds[0]
+  apply,  ///< Apply of _count commands
+  drop,   ///< Drop
+  place,  ///< Place with rotation _a in column _b
+  garbage ///< AddGarbage of _a lines with a hole in column _b
+};
+
+struct Step
+{
+  Op _op;
+  std::uint8_t _count;
+  std::int8_t _a;
+  std::int8_t _b;
+  std::array<Command, 8> _cmds;
+};
+
+/// Starting record and steps played from it
+struct Case
+{
+  Game::Packed _start;
+  std::vector<Step> _steps;
+};
+
+/// Where and how the games differ
+struct Mismatch
+{
+  /// Index of the step, -1 when the games do not differ
+  std::int32_t _step{-1};
+  /// Number of steps played
+  std::int32_t _played{0};
+  Game::Packed _engine;
+  Game::Packed _reference;
+  Game::Outcome _engineOutcome{};
+  Game::Outcome _referenceOutcome{};
+};
+
+bool Same(const Game::Outcome &a, const Game::Outcome &b)
+{
+  return a._locks == b._locks && a._lockedAt == b._lockedAt &&
+         a._cleared == b._cleared;
+}
+
+/// @brief Play a case by both games
+///
+/// Stops at the first difference, or when the game is over; nothing but
+/// garbage changes after that.
+Mismatch Run(Game &game, const Case &c)
+{
+  game.Reset(0);
+  game.Restore(c._start);
+  ReferenceGame reference{c._start};
+
+  Mismatch m;
+  for (const auto &s : c._steps)
+  {
+    Game::Outcome e{}, r{};
+    switch (s._op)
+    {
+    case Op::tick:
+      game.Input(s._cmds[0]);
+      game.Tick();
+      reference.Tick(s._cmds[0]);
+      break;
+    case Op::apply:
+      e = game.Apply(std::span{s._cmds.data(), s._count});
+      r = reference.Apply(std::span{s._cmds.data(), s._count});
+      break;
+    case Op::drop:
+      e = game.Drop();
+      r = reference.Drop();
+      break;
+    case Op::place:
+      e = game.Place(s._a, s._b);
+      r = reference.Place(s._a, s._b);
+      break;
+    case Op::garbage:
+      game.AddGarbage(s._a, s._b);
+      reference.AddGarbage(s._a, s._b);
+      break;
+    }
+
+    game.Save(m._engine);
+    reference.Save(m._reference);
+    if (!Same(e, r) ||
+        std::memcmp(&m._engine, &m._reference, sizeof(Game::Packed)) != 0)
+    {
+      m._step             = m._played;
+      m._engineOutcome    = e;
+      m._referenceOutcome = r;
+      return m;
+    }
+    m._played++;
+    if (m._engine._playing == 0)
+      break;
+  }
+  return m;
+}
+
+/// Blocks of the falling figure of a record, one byte per row
+std::array<std::uint8_t, TetrisScreen::Depth()>
+FigureRows(const Game::Packed &p)
+{
+  std::array<std::uint8_t, TetrisScreen::Depth()> rows{};
+  auto cells{ReferenceGame::FigureCells(p._figure, p._figureRotation)};
+  for (std::int32_t i{0}; i < cells._count; i++)
+  {
+    Position b{p._row + cells._cells[i]._row, p._col + cells._cells[i]._col};
+    if (b._row >= 0 && b._row < TetrisScreen::Depth() && b._col >= 0 &&
+        b._col < TetrisScreen::Width())
+      rows[b._row] |= static_cast<std::uint8_t>(1u << b._col);
+  }
+  return rows;
+}
+
+/// Figure fits the board given as rows
+bool Fits(const Game::Packed &p, std::int32_t kind, std::int32_t turns,
+          Position pos)
+{
+  auto cells{ReferenceGame::FigureCells(kind, turns)};
+  for (std::int32_t i{0}; i < cells._count; i++)
+  {
+    Position b{pos + cells._cells[i]};
+    if (b._row < 0 || b._row >= TetrisScreen::Depth() || b._col < 0 ||
+        b._col >= TetrisScreen::Width() || (p._rows[b._row] >> b._col & 1))
+      return false;
+  }
+  return true;
+}
+
+std::uint8_t RandomKind(Random &rng, FigureSet set)
+{
+  if (set == FigureSet::tetrominoes)
+    return Tetrominoes[rng.Below(Tetrominoes.size())];
+  return ClassicFigures[rng.Below(ClassicFigures.size())];
+}
+
+/// @brief Random game to start a case from
+///
+/// Columns are stacked up to a random height with a few holes. Rows other
+/// than the top one are never full, a game does not leave them so. The
+/// figure is put where it fits, or at the spawn with the game over.
+Game::Packed RandomStart(Random &rng)
+{
+  constexpr std::int32_t Depth{TetrisScreen::Depth()};
+  constexpr std::int32_t Width{TetrisScreen::Width()};
+  constexpr std::uint8_t Full{(1u << Width) - 1};
+
+  Game::Packed p{};
+  auto set{static_cast<FigureSet>(rng.Below(2))};
+  p._set      = static_cast<std::uint8_t>(set);
+  p._rotation = static_cast<std::uint8_t>(rng.Below(2));
+
+  auto stack{static_cast<std::int32_t>(rng.Below(Depth))};
+  for (std::int32_t c{0}; c < Width; c++)
+  {
+    auto height{static_cast<std::int32_t>(rng.Below(stack + 1))};
+    for (std::int32_t r{Depth - height}; r < Depth; r++)
+      if (rng.Below(8) != 0)
+        p._rows[r] |= static_cast<std::uint8_t>(1u << c);
+  }
+  for (std::int32_t r{1}; r < Depth; r++)
+    if (p._rows[r] == Full)
+      p._rows[r] &= static_cast<std::uint8_t>(~(1u << rng.Below(Width)));
+
+  auto kind{RandomKind(rng, set)};
+  auto turns{static_cast<std::int32_t>(rng.Below(4))};
+  auto pos{Game::Spawn};
+  bool placed{rng.Below(2) == 0 && Fits(p, kind, turns, pos)};
+  for (std::int32_t i{0}; i < 16 && !placed; i++)
+  {
+    pos    = Position{static_cast<std::int32_t>(rng.Below(Depth + 1)) - 1,
+                   static_cast<std::int32_t>(rng.Below(Width + 2)) - 2};
+    placed = Fits(p, kind, turns, pos);
+  }
+  if (!placed)
+  {
+    turns  = 0;
+    pos    = Game::Spawn;
+    placed = Fits(p, kind, turns, pos);
+  }
+
+  p._figure         = kind;
+  p._figureRotation = static_cast<std::uint8_t>(turns);
+  p._row            = static_cast<std::int8_t>(pos._row);
+  p._col            = static_cast<std::int8_t>(pos._col);
+  auto figure{FigureRows(p)};
+  for (std::int32_t r{0}; r < Depth; r++)
+    p._rows[r] |= figure[r];
+
+  p._rng     = rng() | 1;
+  p._lines   = static_cast<std::int32_t>(rng.Below(100));
+  p._playing = placed ? 1 : 0;
+  for (auto &next : p._next)
+    next = RandomKind(rng, set);
+  p._nextIdx = static_cast<std::uint8_t>(rng.Below(Game::Preview));
+  if (rng.Below(8) == 0)
+  {
+    p._garbage     = static_cast<std::uint8_t>(1 + rng.Below(3));
+    p._garbageHole = static_cast<std::uint8_t>(rng.Below(Width));
+  }
+  return p;
+}
+
+Command RandomCommand(Random &rng)
+{
+  // mostly moves down, so figures land and lines are removed
+  constexpr Command Commands[16]{
+      Command::Idle,          Command::RotateLeft,     Command::RotateLeft,
+      Command::RotateRight,   Command::RotateRight,    Command::TranslateLeft,
+      Command::TranslateLeft, Command::TranslateLeft,  Command::TranslateRigth,
+      Command::TranslateRigth, Command::TranslateRigth, Command::TranslateDown,
+      Command::TranslateDown, Command::TranslateDown,  Command::TranslateDown,
+      Command::TranslateDown};
+  return Commands[rng.Below(16)];
+}
+
+Step RandomStep(Random &rng)
+{
+  Step s{};
+  auto pick{rng.Below(100)};
+  if (pick < 70)
+  {
+    s._op      = Op::tick;
+    s._cmds[0] = RandomCommand(rng);
+  }
+  else if (pick < 80)
+  {
+    s._op    = Op::apply;
+    s._count = static_cast<std::uint8_t>(rng.Below(s._cmds.size() + 1));
+    for (std::int32_t i{0}; i < s._count; i++)
+      s._cmds[i] = RandomCommand(rng);
+  }
+  else if (pick < 87)
+    s._op = Op::drop;
+  else if (pick < 95)
+  {
+    s._op = Op::place;
+    s._a  = static_cast<std::int8_t>(rng.Below(Game::Rotations));
+    s._b  = static_cast<std::int8_t>(
+        static_cast<std::int32_t>(rng.Below(TetrisScreen::Width() + 4)) - 2);
+  }
+  else
+  {
+    s._op = Op::garbage;
+    s._a  = static_cast<std::int8_t>(1 + rng.Below(3));
+    s._b  = static_cast<std::int8_t>(rng.Below(TetrisScreen::Width()));
+  }
+  return s;
+}
+
+void RandomCase(Random &rng, Case &c, std::int32_t length)
+{
+  c._start = RandomStart(rng);
+  c._steps.resize(length);
+  for (auto &s : c._steps)
+    s = RandomStep(rng);
+}
+
+/// @brief Make a failing case as small as it gets
+///
+/// Steps after the failing one are cut. Then runs of steps, commands of
+/// Apply, rows and blocks of the board are taken out, as long as the
+/// games still differ. Blocks of the falling figure stay.
+void Shrink(Game &game, Case &c)
+{
+  auto fails{[&game](const Case &t) { return Run(game, t)._step >= 0; }};
+  c._steps.resize(Run(game, c)._step + 1);
+
+  for (bool progress{true}; progress;)
+  {
+    progress = false;
+    for (auto chunk{c._steps.size() / 2}; chunk > 0; chunk /= 2)
+      for (std::size_t i{0}; i + chunk <= c._steps.size();)
+      {
+        Case t{c._start, {}};
+        t._steps.assign(c._steps.begin(), c._steps.begin() + i);
+        t._steps.insert(t._steps.end(), c._steps.begin() + i + chunk,
+                        c._steps.end());
+        if (!t._steps.empty() && fails(t))
+        {
+          c        = std::move(t);
+          progress = true;
+        }
+        else
+          i += chunk;
+      }
+
+    for (std::size_t i{0}; i < c._steps.size(); i++)
+      for (std::int32_t k{0}; k < c._steps[i]._count;)
+      {
+        Case t{c};
+        auto &s{t._steps[i]};
+        std::copy(s._cmds.begin() + k + 1, s._cmds.begin() + s._count,
+                  s._cmds.begin() + k);
+        s._count--;
+        if (fails(t))
+        {
+          c        = std::move(t);
+          progress = true;
+        }
+        else
+          k++;
+      }
+
+    auto figure{FigureRows(c._start)};
+    for (std::int32_t r{0}; r < TetrisScreen::Depth(); r++)
+      for (std::uint8_t mask : {std::uint8_t{0xFF}, std::uint8_t{1},
+                                std::uint8_t{2}, std::uint8_t{4},
+                                std::uint8_t{8}, std::uint8_t{16},
+                                std::uint8_t{32}, std::uint8_t{64},
+                                std::uint8_t{128}})
+      {
+        Case t{c};
+        t._start._rows[r] &= static_cast<std::uint8_t>(~mask | figure[r]);
+        if (t._start._rows[r] != c._start._rows[r] && fails(t))
+        {
+          c        = std::move(t);
+          progress = true;
+        }
+      }
+
+    for (auto field : {&Game::Packed::_garbage, &Game::Packed::_cleared})
+    {
+      Case t{c};
+      t._start.*field = 0;
+      if (c._start.*field != 0 && fails(t))
+      {
+        c        = std::move(t);
+        progress = true;
+      }
+    }
+  }
+}
+
+constexpr std::string_view CommandNames[]{"idle",  "rotl",  "rotr",
+                                          "left",  "right", "down"};
+constexpr std::string_view OpNames[]{"tick", "apply", "drop", "place",
+                                     "garbage"};
+
+std::string ToText(const Step &s)
+{
+  std::string text{OpNames[static_cast<std::int32_t>(s._op)]};
+  if (s._op == Op::tick)
+    (text += ' ') += CommandNames[static_cast<std::int32_t>(s._cmds[0])];
+  for (std::int32_t i{0}; s._op == Op::apply && i < s._count; i++)
+    (text += ' ') += CommandNames[static_cast<std::int32_t>(s._cmds[i])];
+  if (s._op == Op::place || s._op == Op::garbage)
+    text += ' ' + std::to_string(s._a) + ' ' + std::to_string(s._b);
+  return text;
+}
+
+/// @brief Replay as text
+///
+/// The first line is the starting record in hex, then one step per line.
+void Print(const Case &c, std::FILE *out)
+{
+  std::fprintf(out, "state ");
+  const auto *bytes{reinterpret_cast<const std::uint8_t *>(&c._start)};
+  for (std::size_t i{0}; i < sizeof(Game::Packed); i++)
+    std::fprintf(out, "%02x", bytes[i]);
+  std::fprintf(out, "\n");
+  for (const auto &s : c._steps)
+    std::fprintf(out, "%s\n", ToText(s).c_str());
+}
+
+bool Parse(std::istream &in, Case &c)
+{
+  std::string line;
+  if (!std::getline(in, line) || line.rfind("state ", 0) != 0 ||
+      line.size() != 6 + 2 * sizeof(Game::Packed))
+    return false;
+  auto *bytes{reinterpret_cast<std::uint8_t *>(&c._start)};
+  for (std::size_t i{0}; i < sizeof(Game::Packed); i++)
+    bytes[i] = static_cast<std::uint8_t>(
+        std::stoul(line.substr(6 + 2 * i, 2), nullptr, 16));
+  if (!Game::Valid(c._start))
+    return false;
+
+  while (std::getline(in, line))
+  {
+    std::istringstream words{line};
+    std::string word;
+    if (!(words >> word))
+      continue;
+    Step s{};
+    auto op{std::find(std::begin(OpNames), std::end(OpNames), word)};
+    if (op == std::end(OpNames))
+      return false;
+    s._op = static_cast<Op>(op - std::begin(OpNames));
+    if (s._op == Op::place || s._op == Op::garbage)
+    {
+      int a{0}, b{0};
+      if (!(words >> a >> b))
+        return false;
+      s._a = static_cast<std::int8_t>(a);
+      s._b = static_cast<std::int8_t>(b);
+    }
+    while (s._op != Op::place && s._op != Op::garbage && words >> word)
+    {
+      auto cmd{std::find(std::begin(CommandNames), std::end(CommandNames),
+                         word)};
+      if (cmd == std::end(CommandNames) || s._count == s._cmds.size())
+        return false;
+      s._cmds[s._count++] =
+          static_cast<Command>(cmd - std::begin(CommandNames));
+    }
+    c._steps.push_back(s);
+  }
+  return true;
+}
+
+/// Both games after the step that differs, side by side
+void Report(const Case &c, const Mismatch &m)
+{
+  std::printf("step %d '%s': engine | reference\n", m._step,
+              ToText(c._steps[m._step]).c_str());
+  for (std::int32_t r{0}; r < TetrisScreen::Depth(); r++)
+  {
+    char row[2][TetrisScreen::Width() + 1]{};
+    for (std::int32_t c{0}; c < TetrisScreen::Width(); c++)
+    {
+      row[0][c] = (m._engine._rows[r] >> c & 1) ? 'X' : '.';
+      row[1][c] = (m._reference._rows[r] >> c & 1) ? 'X' : '.';
+    }
+    std::printf("  %s | %s%s\n", row[0], row[1],
+                m._engine._rows[r] != m._reference._rows[r] ? "  <" : "");
+  }
+  for (const auto *p : {&m._engine, &m._reference})
+    std::printf("  %-9s figure %d turn %d at %d,%d, lines %d, cleared %d, "
+                "%s, next %d %d %d @%d, garbage %d @%d, rng %08x\n",
+                p == &m._engine ? "engine" : "reference", p->_figure,
+                p->_figureRotation, p->_row, p->_col, p->_lines, p->_cleared,
+                p->_playing ? "playing" : "over", p->_next[0], p->_next[1],
+                p->_next[2], p->_nextIdx, p->_garbage, p->_garbageHole,
+                p->_rng);
+  for (const auto *o : {&m._engineOutcome, &m._referenceOutcome})
+    std::printf("  %-9s locks %d at %d,%d, cleared %d\n",
+                o == &m._engineOutcome ? "engine" : "reference", o->_locks,
+                o->_lockedAt._row, o->_lockedAt._col, o->_cleared);
+}
+
+int Replay(const char *path)
+{
+  std::ifstream file{path};
+  Case c;
+  if (!file || !Parse(file, c))
+  {
+    std::fprintf(stderr, "%s is not a replay\n", path);
+    return EXIT_FAILURE;
+  }
+  Game game{0};
+  auto m{Run(game, c)};
+  if (m._step < 0)
+  {
+    std::printf("%d steps, engine and reference are the same\n", m._played);
+    return EXIT_SUCCESS;
+  }
+  Report(c, m);
+  return EXIT_FAILURE;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  if (argc > 2 && std::string_view{argv[1]} == "replay")
+    return Replay(argv[2]);
+
+  std::int64_t steps{argc > 1 ? std::atoll(argv[1]) : 10'000'000};
+  std::uint32_t seed{argc > 2 ? static_cast<std::uint32_t>(
+                                    std::strtoul(argv[2], nullptr, 0))
+                              : Entropy()};
+  std::int32_t threads{argc > 3 ? std::atoi(argv[3])
+                                : static_cast<std::int32_t>(std::max(
+                                      1u, std::thread::hardware_concurrency()))};
+
+  // a case is long enough for a few figures to land, short enough to
+  // start from many different boards
+  constexpr std::int32_t Length{64};
+
+  std::atomic<std::int64_t> played{0};
+  std::atomic<bool> failed{false};
+  std::mutex report;
+  auto start{std::chrono::steady_clock::now()};
+
+  auto worker{[&](std::int32_t id) {
+    Random rng{seed + static_cast<std::uint32_t>(id) * 0x9E3779B9u};
+    Game game{0};
+    Case c;
+    std::int64_t own{0};
+    while (own < steps / threads && !failed.load(std::memory_order_relaxed))
+    {
+      RandomCase(rng, c, Length);
+      auto m{Run(game, c)};
+      own += m._played + (m._step >= 0);
+      if (m._step < 0)
+        continue;
+
+      failed = true;
+      Shrink(game, c);
+      std::lock_guard lock{report};
+      std::printf("engine and reference differ, seed %u, thread %d\n", seed,
+                  id);
+      Report(c, Run(game, c));
+      std::printf("replay:\n");
+      Print(c, stdout);
+    }
+    played += own;
+  }};
+
+  std::vector<std::thread> pool;
+  for (std::int32_t i{0}; i < threads; i++)
+    pool.emplace_back(worker, i);
+  for (auto &t : pool)
+    t.join();
+
+  std::chrono::duration<double> s{std::chrono::steady_clock::now() - start};
+  std::printf("%lld steps in %.2f s, %d threads, seed %u: %.0f steps/s "
+              "per thread%s\n",
+              static_cast<long long>(played.load()), s.count(), threads, seed,
+              played / s.count() / threads,
+              failed ? ", engine and reference differ" : "");
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,410 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Frozen reference implementation of the game rules
+
+#ifndef __TETRIS_REFERENCE_GAME_H__
+#define __TETRIS_REFERENCE_GAME_H__
+
+#include "Command.h"
+#include "Random.h"
+#include "RotationSystem.h"
+#include "TetrisGame.h"
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace Tetris
+{
+/// @brief The game's rules written the plain way, to check the engine
+///
+/// Game is tuned for speed: rows are read as bit masks, shapes come from
+/// tables made by the compiler, figures are drawn and cleared as few times
+/// as possible. This class keeps the rules as they read in README, one
+/// cell at a time: the board is a grid of flags, the falling figure is
+/// kept apart from it, every move tests every block and full lines are
+/// moved down one by one. It is meant to stay as it is. When a change of
+/// the engine makes the two differ, the engine is wrong, unless the rules
+/// are changed on purpose in both.
+///
+/// Quirks of the engine are rules too and are kept: the top row is never
+/// removed, a figure that has no place on the screen is drawn over the
+/// blocks under it.
+///
+/// Only figures' drawings, kicks of the rotation system and the random
+/// number generator are shared with the engine; they are data, not rules.
+class ReferenceGame
+{
+public:
+  static constexpr std::int32_t Depth{TetrisScreen::Depth()};
+  static constexpr std::int32_t Width{TetrisScreen::Width()};
+
+  /// Blocks of a figure, relative to the top left corner of its box
+  struct Cells
+  {
+    std::int32_t _count;
+    std::int32_t _box;
+    std::array<Position, 4> _cells;
+  };
+
+  /// @brief Blocks of a figure
+  /// @param kind - see AnyFigure::Make
+  /// @param rotation - number of turns to the right from the drawing
+  static constexpr Cells FigureCells(std::int32_t kind,
+                                     std::int32_t rotation)
+  {
+    // the same drawings as in FigureImpl.h, in the order of AnyFigure
+    constexpr std::string_view Art[AnyFigure::Kinds]{
+        "XX\nXX",
+        ".X.\n.X.\n.X.",
+        "XXX\n.X.\n...",
+        "X",
+        "....\nXXXX\n....\n....",
+        "X..\nXXX\n...",
+        "..X\nXXX\n...",
+        ".XX\nXX.\n...",
+        ".X.\nXXX\n...",
+        "XX.\n.XX\n..."};
+
+    Cells cells{};
+    std::int32_t rows{1}, cols{0}, col{0};
+    for (auto c : Art[kind])
+    {
+      if (c == '\n')
+      {
+        rows++;
+        col = 0;
+        continue;
+      }
+      if (c == 'X')
+        cells._cells[cells._count++] = Position{rows - 1, col};
+      col++;
+      cols = col > cols ? col : cols;
+    }
+    cells._box = rows > cols ? rows : cols;
+
+    // a turn to the right inside the box: row becomes column, column
+    // becomes row counted from the bottom
+    for (std::int32_t turn{0}; turn < rotation % 4; turn++)
+      for (std::int32_t i{0}; i < cells._count; i++)
+      {
+        auto p{cells._cells[i]};
+        cells._cells[i] = Position{p._col, cells._box - 1 - p._row};
+      }
+    return cells;
+  }
+
+  /// @brief Start from a record of a game, see Game::Restore
+  ///
+  /// Rows of the record have the falling figure drawn in. Its cells are
+  /// taken out of the board, the same way the engine clears it before
+  /// every move.
+  explicit ReferenceGame(const Game::Packed &p)
+      : _set{static_cast<FigureSet>(p._set)}
+      , _rotation{static_cast<RotationSystem>(p._rotation)}
+      , _rng{Random::FromState(p._rng)}
+      , _kind{p._figure}
+      , _turns{p._figureRotation % 4}
+      , _pos{p._row, p._col}
+      , _lines{p._lines}
+      , _cleared{p._cleared}
+      , _garbage{p._garbage}
+      , _garbageHole{p._garbageHole}
+      , _nextIdx{p._nextIdx}
+      , _over{p._playing == 0}
+  {
+    for (std::int32_t r{0}; r < Depth; r++)
+      for (std::int32_t c{0}; c < Width; c++)
+        _board[r][c] = (p._rows[r] >> c & 1) != 0;
+    const auto &cells{Blocks(_kind, _turns)};
+    for (std::int32_t i{0}; i < cells._count; i++)
+    {
+      auto b{_pos + cells._cells[i]};
+      if (Inside(b))
+        _board[b._row][b._col] = false;
+    }
+    for (std::int32_t i{0}; i < Game::Preview; i++)
+      _next[i] = p._next[i];
+  }
+
+  /// Write the game the way Game::Save does, figure drawn in
+  void Save(Game::Packed &p) const
+  {
+    auto board{_board};
+    const auto &cells{Blocks(_kind, _turns)};
+    for (std::int32_t i{0}; i < cells._count; i++)
+    {
+      auto b{_pos + cells._cells[i]};
+      if (Inside(b))
+        board[b._row][b._col] = true;
+    }
+    for (std::int32_t r{0}; r < Depth; r++)
+    {
+      p._rows[r] = 0;
+      for (std::int32_t c{0}; c < Width; c++)
+        if (board[r][c])
+          p._rows[r] |= static_cast<std::uint8_t>(1u << c);
+    }
+    p._figure         = static_cast<std::uint8_t>(_kind);
+    p._figureRotation = static_cast<std::uint8_t>(_turns);
+    p._row            = static_cast<std::int8_t>(_pos._row);
+    p._col            = static_cast<std::int8_t>(_pos._col);
+    p._set            = static_cast<std::uint8_t>(_set);
+    p._rotation       = static_cast<std::uint8_t>(_rotation);
+    p._rng            = _rng.State();
+    p._lines          = _lines;
+    p._playing        = _over ? 0 : 1;
+    p._cleared        = static_cast<std::uint8_t>(_cleared);
+    for (std::int32_t i{0}; i < Game::Preview; i++)
+      p._next[i] = _next[i];
+    p._nextIdx     = static_cast<std::uint8_t>(_nextIdx);
+    p._garbage     = static_cast<std::uint8_t>(_garbage > 0xFF ? 0xFF
+                                                               : _garbage);
+    p._garbageHole = static_cast<std::uint8_t>(_garbageHole);
+  }
+
+  /// Same as Game::Input followed by Game::Tick
+  void Tick(Command cmd)
+  {
+    _cleared = 0;
+    _locks   = 0;
+    Execute(cmd);
+  }
+
+  /// Same as Game::Apply: every command, one after another
+  Game::Outcome Apply(std::span<const Command> cmds)
+  {
+    _cleared = 0;
+    _locks   = 0;
+    for (auto cmd : cmds)
+      Execute(cmd);
+    return Game::Outcome{_locks, _lockedAt, _cleared};
+  }
+
+  /// Same as Game::Drop: 'down' until the figure lands
+  Game::Outcome Drop()
+  {
+    _cleared = 0;
+    _locks   = 0;
+    while (!_over && _locks == 0)
+      Execute(Command::TranslateDown);
+    return Game::Outcome{_locks, _lockedAt, _cleared};
+  }
+
+  /// Same as Game::Place: turns, moves to the side and drops
+  Game::Outcome Place(std::int32_t rotation, ColumnIdx col)
+  {
+    if (!_over)
+    {
+      for (std::int32_t i{0}; i < rotation; i++)
+        Execute(Command::RotateRight);
+      auto shift{col - _pos._col};
+      for (std::int32_t i{0}; i < shift; i++)
+        Execute(Command::TranslateRigth);
+      for (std::int32_t i{0}; i < -shift; i++)
+        Execute(Command::TranslateLeft);
+    }
+    return Drop();
+  }
+
+  /// Same as Game::AddGarbage
+  void AddGarbage(std::int32_t count, ColumnIdx hole)
+  {
+    _garbage += count;
+    _garbageHole = hole;
+  }
+
+private:
+  std::array<std::array<bool, Width>, Depth> _board{};
+  FigureSet _set;
+  RotationSystem _rotation;
+  Random _rng;
+  std::int32_t _kind;
+  std::int32_t _turns;
+  Position _pos;
+  std::int32_t _lines;
+  std::int32_t _cleared;
+  std::int32_t _garbage;
+  ColumnIdx _garbageHole;
+  std::array<std::uint8_t, Game::Preview> _next{};
+  std::int32_t _nextIdx;
+  bool _over;
+  std::int32_t _locks{0};
+  Position _lockedAt{};
+
+
+  /// Blocks of a figure in given rotation, worked out once
+  static const Cells &Blocks(std::int32_t kind, std::int32_t turns)
+  {
+    static constexpr auto All{[] {
+      std::array<std::array<Cells, 4>, AnyFigure::Kinds> all{};
+      for (std::int32_t k{0}; k < AnyFigure::Kinds; k++)
+        for (std::int32_t t{0}; t < 4; t++)
+          all[k][t] = FigureCells(k, t);
+      return all;
+    }()};
+    return All[kind][turns];
+  }
+
+  static bool Inside(Position p)
+  {
+    return p._row >= 0 && p._row < Depth && p._col >= 0 && p._col < Width;
+  }
+
+  /// Figure of given rotation has place at given position
+  bool Fits(Position pos, std::int32_t turns) const
+  {
+    const auto &cells{Blocks(_kind, turns)};
+    for (std::int32_t i{0}; i < cells._count; i++)
+    {
+      auto b{pos + cells._cells[i]};
+      if (!Inside(b) || _board[b._row][b._col])
+        return false;
+    }
+    return true;
+  }
+
+  /// @brief Execute a command
+  /// @returns true when the figure has moved
+  bool Execute(Command cmd)
+  {
+    if (_over)
+      return false;
+
+    switch (cmd)
+    {
+    case Command::Idle:
+      return false;
+    case Command::RotateLeft:
+      return Rotate(false);
+    case Command::RotateRight:
+      return Rotate(true);
+    case Command::TranslateLeft:
+      return Move(Position{0, -1});
+    case Command::TranslateRigth:
+      return Move(Position{0, 1});
+    case Command::TranslateDown:
+      if (Move(Position{1, 0}))
+        return true;
+      Lock();
+      return false;
+    }
+    return false;
+  }
+
+  bool Move(Position by)
+  {
+    if (!Fits(_pos + by, _turns))
+      return false;
+    _pos = _pos + by;
+    return true;
+  }
+
+  /// Every kick in turn, the first one is the rotation in place
+  bool Rotate(bool clockwise)
+  {
+    auto turns{(_turns + (clockwise ? 1 : 3)) % 4};
+    const auto &kicks{KicksOf(_rotation, Blocks(_kind, 0)._box)};
+    for (std::int32_t k{0}; k < kicks._tests; k++)
+    {
+      auto p{_pos + kicks._kicks[KickTransition(_turns, clockwise)][k]};
+      if (Fits(p, turns))
+      {
+        _pos   = p;
+        _turns = turns;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Figure becomes part of the board and the next one appears
+  void Lock()
+  {
+    const auto &cells{Blocks(_kind, _turns)};
+    for (std::int32_t i{0}; i < cells._count; i++)
+    {
+      auto b{_pos + cells._cells[i]};
+      _board[b._row][b._col] = true;
+    }
+    _locks++;
+    _lockedAt = _pos;
+
+    // from the top down, so lines above a removed one are checked after
+    // they have moved; the top row is never removed
+    for (std::int32_t r{1}; r < Depth; r++)
+    {
+      bool full{true};
+      for (std::int32_t c{0}; c < Width; c++)
+        full = full && _board[r][c];
+      if (!full)
+        continue;
+      for (std::int32_t above{r}; above > 0; above--)
+        _board[above] = _board[above - 1];
+      _board[0].fill(false);
+      _cleared++;
+      _lines++;
+    }
+
+    if (_garbage > 0)
+    {
+      auto count{_garbage < Depth ? _garbage : Depth};
+      for (std::int32_t r{0}; r + count < Depth; r++)
+        _board[r] = _board[r + count];
+      for (std::int32_t r{Depth - count}; r < Depth; r++)
+      {
+        _board[r].fill(true);
+        _board[r][_garbageHole] = false;
+      }
+      _garbage = 0;
+    }
+
+    _kind           = _next[_nextIdx];
+    _next[_nextIdx] = NextKind();
+    _nextIdx        = (_nextIdx + 1) % Game::Preview;
+    _turns          = 0;
+    _pos            = Game::Spawn;
+    _over           = !Fits(_pos, _turns);
+  }
+
+  std::uint8_t NextKind()
+  {
+    if (_set == FigureSet::tetrominoes)
+      return Tetrominoes[_rng.Below(Tetrominoes.size())];
+    return ClassicFigures[_rng.Below(ClassicFigures.size())];
+  }
+};
+
+} // namespace Tetris
+
+#endif //__TETRIS_REFERENCE_GAME_H__
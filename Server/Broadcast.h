@@ -0,0 +1,333 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Broadcast of a game to many spectators
+
+#ifndef __TETRIS_BROADCAST_H__
+#define __TETRIS_BROADCAST_H__
+
+#include "TetrisGame.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+
+namespace Tetris
+{
+/// @brief Change of a game, as sent to spectators
+///
+/// Landed blocks change only when a figure lands, so most deltas carry
+/// just the pose of the falling figure. A keyframe carries every row.
+struct SpectatorDelta
+{
+  /// Flags of a delta
+  enum : std::uint8_t
+  {
+    Keyframe = 1, ///< All rows are sent
+    Over     = 2  ///< The game is over
+  };
+
+  /// Number of the delta in the broadcast, from 1
+  std::uint64_t _seq;
+  /// Landed blocks of the rows in _changed, bit N is column N
+  std::array<std::uint8_t, TetrisScreen::Depth()> _rows;
+  /// Rows sent in _rows, bit N is row N
+  std::uint16_t _changed;
+  /// Rows removed, see Game::ClearedRows
+  std::uint16_t _cleared;
+  /// Falling figure, see Game::Packed
+  std::uint8_t _figure;
+  std::uint8_t _rotation;
+  std::int8_t _row;
+  std::int8_t _col;
+  std::uint8_t _flags;
+  std::uint8_t _reserved;
+  /// Lines removed since the game started
+  std::int32_t _lines;
+};
+
+static_assert(sizeof(SpectatorDelta) == 32, "Delta fits half a line");
+static_assert(TetrisScreen::Depth() <= 16, "Rows must fit the masks");
+
+/// @brief What a spectator knows about the game
+struct SpectatorView
+{
+  /// Landed blocks, bit N is column N
+  std::array<std::uint8_t, TetrisScreen::Depth()> _rows{};
+  /// Falling figure
+  std::uint8_t _figure{0};
+  std::uint8_t _rotation{0};
+  std::int8_t _row{0};
+  std::int8_t _col{0};
+  std::int32_t _lines{0};
+  bool _over{false};
+  /// A keyframe has been read; before it the view is empty
+  bool _synced{false};
+  /// Last delta applied
+  std::uint64_t _seq{0};
+
+  /// Rows changed by the last Poll
+  std::uint16_t _changed{0};
+  /// Rows removed during the deltas read by the last Poll; rows removed
+  /// in skipped deltas are only counted in _lines
+  std::int32_t _removed{0};
+  /// Deltas the last Poll has skipped by going straight to a keyframe
+  std::uint64_t _skipped{0};
+};
+
+/// @brief Deltas of a game in a ring read by any number of spectators
+///
+/// The game's thread publishes a delta after every tick; it never waits
+/// for readers and does not know how many there are. Each slot of the
+/// ring is a cache line with a version: the writer marks the slot as
+/// being written, stores the delta and marks it done. A reader copies the
+/// delta and checks that the version has not moved meanwhile.
+///
+/// Every KeyframeInterval deltas, and when asked to, the whole board is
+/// published. A reader that is behind a newer keyframe, e.g. it has just
+/// joined or polls only now and then, goes straight to it: the deltas
+/// before it are coalesced and the reader never has more than
+/// KeyframeInterval deltas to read. The ring holds a few keyframes, so a
+/// reader is written over only when it stops in the middle of a Poll;
+/// then it starts again from the latest keyframe.
+class SpectatorBroadcast
+{
+public:
+  /// Deltas between keyframes
+  static constexpr std::uint64_t KeyframeInterval{64};
+
+  /// @brief Reader of the broadcast for a single spectator
+  ///
+  /// It is two words; a thread can poll thousands of them.
+  class Reader
+  {
+  public:
+    /// @brief Apply the deltas published since the last call
+    /// @returns false if there was nothing new
+    bool Poll(SpectatorView &view)
+    {
+      view._changed = 0;
+      view._removed = 0;
+      view._skipped = 0;
+      auto head{_broadcast->_head.load(std::memory_order_acquire)};
+      if (_next > head)
+        return false;
+
+      Resync(view);
+      while (_next <= head)
+      {
+        SpectatorDelta d;
+        if (!_broadcast->Read(_next, d))
+        {
+          // written over while reading
+          Resync(view);
+          continue;
+        }
+        Apply(d, view);
+        _next++;
+      }
+      return true;
+    }
+
+  private:
+    friend class SpectatorBroadcast;
+
+    explicit Reader(const SpectatorBroadcast &broadcast)
+        : _broadcast{&broadcast}
+        , _next{1}
+    {
+    }
+
+    const SpectatorBroadcast *_broadcast;
+    /// Next delta to read
+    std::uint64_t _next;
+
+    /// Skip to the latest keyframe if there is a newer one
+    void Resync(SpectatorView &view)
+    {
+      auto keyframe{_broadcast->_keyframe.load(std::memory_order_acquire)};
+      if (keyframe > _next)
+      {
+        view._skipped += keyframe - _next;
+        _next = keyframe;
+      }
+    }
+
+    static void Apply(const SpectatorDelta &d, SpectatorView &view)
+    {
+      if (!view._synced && !(d._flags & SpectatorDelta::Keyframe))
+        return;
+      for (std::int32_t r{0}; r < TetrisScreen::Depth(); r++)
+        if (d._changed >> r & 1)
+          view._rows[r] = d._rows[r];
+      view._changed |= d._changed;
+      view._removed += std::popcount(d._cleared);
+      view._figure   = d._figure;
+      view._rotation = d._rotation;
+      view._row      = d._row;
+      view._col      = d._col;
+      view._lines    = d._lines;
+      view._over     = (d._flags & SpectatorDelta::Over) != 0;
+      view._synced   = true;
+      view._seq      = d._seq;
+    }
+  };
+
+  /// @param slots - deltas kept in the ring, a power of two of at least
+  ///   4 * KeyframeInterval
+  explicit SpectatorBroadcast(std::uint32_t slots = 1024)
+      : _size{std::bit_ceil(std::max<std::uint64_t>(slots,
+                                                    4 * KeyframeInterval))}
+      , _slots{std::make_unique<Slot[]>(_size)}
+  {
+  }
+
+  SpectatorBroadcast(const SpectatorBroadcast &) = delete;
+  void operator=(const SpectatorBroadcast &) = delete;
+
+  /// @brief Publish the change of the game since the previous call
+  ///
+  /// Called by the game's thread after every Tick, Apply, Drop or Place.
+  /// Landed blocks are read only when a figure has landed; a change of
+  /// the board by anything else, e.g. Reset or Undo, needs a keyframe.
+  /// @param game - game after the tick
+  /// @param keyframe - publish the whole board
+  void Publish(const Game &game, bool keyframe = false)
+  {
+    const auto &figure{*game.Current()};
+    auto pos{figure.Pos()};
+    SpectatorDelta d{};
+    d._seq      = ++_seq;
+    d._cleared  = static_cast<std::uint16_t>(game.ClearedRows());
+    d._figure   = static_cast<std::uint8_t>(game.Current().Kind());
+    d._rotation = static_cast<std::uint8_t>(figure.Rotation());
+    d._row      = static_cast<std::int8_t>(pos._row);
+    d._col      = static_cast<std::int8_t>(pos._col);
+    d._flags    = game.Over() ? SpectatorDelta::Over : 0;
+    d._lines    = game.Lines();
+
+    // landed blocks change only when a figure lands or by the caller
+    auto last{_keyframe.load(std::memory_order_relaxed)};
+    keyframe = keyframe || last == 0;
+    if (keyframe || game.Locks() > 0)
+    {
+      auto landed{game.Landed()};
+      for (std::int32_t r{0}; r < TetrisScreen::Depth(); r++)
+      {
+        auto row{static_cast<std::uint8_t>(LineMask(landed.Lines()[r]))};
+        if (row != _landed[r])
+          d._changed |= static_cast<std::uint16_t>(1u << r);
+        _landed[r] = row;
+      }
+    }
+    if (keyframe || _seq - last >= KeyframeInterval)
+    {
+      d._flags |= SpectatorDelta::Keyframe;
+      d._changed = static_cast<std::uint16_t>(
+          (1u << TetrisScreen::Depth()) - 1);
+    }
+    for (std::int32_t r{0}; r < TetrisScreen::Depth(); r++)
+      if (d._changed >> r & 1)
+        d._rows[r] = _landed[r];
+
+    Write(d);
+    if (d._flags & SpectatorDelta::Keyframe)
+      _keyframe.store(d._seq, std::memory_order_release);
+    _head.store(d._seq, std::memory_order_release);
+  }
+
+  /// @brief New reader; it starts from the latest keyframe
+  Reader Attach() const { return Reader{*this}; }
+
+  /// Number of deltas published
+  std::uint64_t Published() const
+  {
+    return _head.load(std::memory_order_relaxed);
+  }
+
+private:
+  /// Delta with its version: twice its number when written, one less
+  /// while being written
+  struct alignas(64) Slot
+  {
+    std::atomic<std::uint64_t> _version{0};
+    std::array<std::atomic<std::uint64_t>, 4> _words{};
+  };
+
+  using Words = std::array<std::uint64_t, 4>;
+  static_assert(sizeof(Words) == sizeof(SpectatorDelta));
+
+  std::uint64_t _size;
+  std::unique_ptr<Slot[]> _slots;
+
+  /// Read by readers, written by the game's thread
+  alignas(64) std::atomic<std::uint64_t> _head{0};
+  std::atomic<std::uint64_t> _keyframe{0};
+
+  /// Used by the game's thread only
+  alignas(64) std::uint64_t _seq{0};
+  std::array<std::uint8_t, TetrisScreen::Depth()> _landed{};
+
+  void Write(const SpectatorDelta &d)
+  {
+    auto &slot{_slots[d._seq & (_size - 1)]};
+    slot._version.store(2 * d._seq - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    auto words{std::bit_cast<Words>(d)};
+    for (std::size_t i{0}; i < words.size(); i++)
+      slot._words[i].store(words[i], std::memory_order_relaxed);
+    slot._version.store(2 * d._seq, std::memory_order_release);
+  }
+
+  /// @returns false if the delta is not there anymore
+  bool Read(std::uint64_t seq, SpectatorDelta &d) const
+  {
+    const auto &slot{_slots[seq & (_size - 1)]};
+    auto version{slot._version.load(std::memory_order_acquire)};
+    if (version != 2 * seq)
+      return false;
+    Words words;
+    for (std::size_t i{0}; i < words.size(); i++)
+      words[i] = slot._words[i].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot._version.load(std::memory_order_relaxed) != version)
+      return false;
+    d = std::bit_cast<SpectatorDelta>(words);
+    return true;
+  }
+};
+
+} // namespace Tetris
+
+#endif //__TETRIS_BROADCAST_H__
@@ -0,0 +1,364 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Game server hosting many sessions (Linux)
+///
+/// Every client connection over a Unix domain socket is a single game
+/// session. Sessions are sharded by their ID over a fixed set of worker
+/// threads. A worker owns the sessions' sockets in its own epoll
+/// instance and the sessions' games, so Game::Input/Tick are called by
+/// one thread only and never need locks. After commands are applied the
+/// worker sends back rows of the screen that have changed.
+///
+/// Figures fall on their own. A single GravityScheduler thread keeps
+/// gravity timers of all games and hands due games to their workers.
+///
+/// Usage: GameServer [socket path] [workers]
+
+#include "Gravity.h"
+#include "GravityScheduler.h"
+#include "Protocol.h"
+#include "TetrisGame.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+/// @brief Single hosted game and its client
+struct Session
+{
+  Session(std::uint32_t id, int fd)
+      : _id{id}
+      , _fd{fd}
+      , _game{id}
+  {
+  }
+
+  std::uint32_t _id;
+  int _fd;
+  Tetris::Game _game;
+  Tetris::Wire::DeltaEncoder _delta{};
+  /// Sequence of the last applied command
+  std::uint16_t _seq{0};
+  /// A frame could not be sent; waiting for the socket to be writable
+  bool _blocked{false};
+};
+
+/// @brief Thread owning a shard of sessions
+class Worker
+{
+public:
+  explicit Worker(Tetris::GravityScheduler &gravity)
+      : _gravity{gravity}
+      , _epoll{epoll_create1(EPOLL_CLOEXEC)}
+      , _wake{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)}
+  {
+    epoll_event ev{};
+    ev.events   = EPOLLIN;
+    ev.data.ptr = nullptr;
+    epoll_ctl(_epoll, EPOLL_CTL_ADD, _wake, &ev);
+  }
+
+  Worker(const Worker &) = delete;
+  void operator=(const Worker &) = delete;
+
+  /// @brief Hand over a new connection. Called by the acceptor thread.
+  void Adopt(int fd, std::uint32_t id)
+  {
+    {
+      std::lock_guard<std::mutex> lock{_inboxLock};
+      _inbox.push_back({fd, id});
+    }
+    Wake();
+  }
+
+  /// @brief Queue 'down' commands of sessions. Called by the scheduler.
+  void Fall(Tetris::GravityScheduler::Batch &batch)
+  {
+    {
+      std::lock_guard<std::mutex> lock{_inboxLock};
+      if (_falling.empty())
+        _falling.swap(batch);
+      else
+        _falling.insert(_falling.end(), batch.begin(), batch.end());
+    }
+    Wake();
+  }
+
+  /// Number of sessions hosted by this worker
+  std::size_t Sessions() const { return _count.load(); }
+
+  /// Worker's loop
+  void Run()
+  {
+    std::array<epoll_event, 256> events;
+    while (1)
+    {
+      auto n{epoll_wait(_epoll, events.data(), events.size(), -1)};
+      for (int i{0}; i < n; i++)
+      {
+        auto s{static_cast<Session *>(events[i].data.ptr)};
+        if (s == nullptr)
+          Drain();
+        else if (events[i].events & (EPOLLHUP | EPOLLERR))
+          Close(s);
+        else
+        {
+          if (events[i].events & EPOLLOUT)
+            Flush(*s);
+          if (events[i].events & EPOLLIN)
+            Read(s);
+        }
+      }
+      Collect();
+    }
+  }
+
+private:
+  Tetris::GravityScheduler &_gravity;
+  int _epoll;
+  int _wake;
+  /// Guards connections and gravity commands handed over to the worker
+  std::mutex _inboxLock;
+  std::vector<std::pair<int, std::uint32_t>> _inbox;
+  Tetris::GravityScheduler::Batch _falling;
+  Tetris::GravityScheduler::Batch _fallingNow;
+  std::vector<std::unique_ptr<Session>> _sessions;
+  std::unordered_map<std::uint32_t, Session *> _byId;
+  std::vector<Session *> _closed;
+  std::atomic<std::size_t> _count{0};
+
+  void Wake()
+  {
+    std::uint64_t one{1};
+    if (write(_wake, &one, sizeof(one)) < 0)
+      std::perror("eventfd");
+  }
+
+  /// Take over new connections and gravity commands
+  void Drain()
+  {
+    std::uint64_t value;
+    if (read(_wake, &value, sizeof(value)) < 0)
+      return;
+
+    std::vector<std::pair<int, std::uint32_t>> inbox;
+    {
+      std::lock_guard<std::mutex> lock{_inboxLock};
+      inbox.swap(_inbox);
+      _fallingNow.swap(_falling);
+    }
+    for (auto [fd, id] : inbox)
+    {
+      _sessions.push_back(std::make_unique<Session>(id, fd));
+      auto s{_sessions.back().get()};
+      _byId[id] = s;
+      epoll_event ev{};
+      ev.events   = EPOLLIN;
+      ev.data.ptr = s;
+      epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &ev);
+      // initial frame carries the whole screen
+      Flush(*s);
+      Reschedule(*s);
+    }
+    _count = _sessions.size();
+
+    for (auto id : _fallingNow)
+    {
+      auto it{_byId.find(id)};
+      if (it == _byId.end() || it->second->_fd < 0)
+        continue;
+      auto &s{*it->second};
+      s._game.Input(Tetris::Command::TranslateDown);
+      s._game.Tick();
+      if (!s._blocked)
+        Flush(s);
+      Reschedule(s);
+    }
+    _fallingNow.clear();
+  }
+
+  /// @brief Arm session's gravity timer
+  ///
+  /// Figure that has landed waits for the lock delay, otherwise it falls
+  /// with the speed of the game's level.
+  void Reschedule(Session &s)
+  {
+    _gravity.Schedule(s._id, s._game.Grounded()
+                                 ? Tetris::LockDelay
+                                 : Tetris::FallInterval(s._game.Level()));
+  }
+
+  /// Apply all received commands, then send a single frame
+  void Read(Session *s)
+  {
+    Tetris::Wire::CommandPacket pkt;
+    bool applied{false};
+    while (1)
+    {
+      auto n{recv(s->_fd, &pkt, sizeof(pkt), MSG_DONTWAIT)};
+      if (n == sizeof(pkt))
+      {
+        s->_game.Input(static_cast<Tetris::Command>(pkt._cmd));
+        s->_game.Tick();
+        s->_seq = pkt._seq;
+        applied = true;
+      }
+      else if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+      {
+        Close(s);
+        return;
+      }
+      else if (n < 0 && errno == EAGAIN)
+        break;
+    }
+    if (applied && !s->_blocked)
+      Flush(*s);
+  }
+
+  /// @brief Send changes of the screen
+  ///
+  /// When the client does not keep up, the frame is dropped and the
+  /// socket is watched for writing. The next frame carries all changes.
+  void Flush(Session &s)
+  {
+    std::array<std::uint8_t, Tetris::Wire::MaxFrameSize> buf;
+    auto size{s._delta.Encode(s._game.Board(), s._seq, buf.data())};
+    auto sent{send(s._fd, buf.data(), size, MSG_DONTWAIT | MSG_NOSIGNAL)};
+    bool blocked{sent < 0 && errno == EAGAIN};
+    if (sent == static_cast<ssize_t>(size))
+      s._delta.Commit();
+
+    if (blocked != s._blocked)
+    {
+      s._blocked = blocked;
+      epoll_event ev{};
+      ev.events   = blocked ? EPOLLIN | EPOLLOUT : EPOLLIN;
+      ev.data.ptr = &s;
+      epoll_ctl(_epoll, EPOLL_CTL_MOD, s._fd, &ev);
+    }
+  }
+
+  void Close(Session *s)
+  {
+    if (s->_fd < 0)
+      return;
+    _gravity.Cancel(s->_id);
+    _byId.erase(s->_id);
+    epoll_ctl(_epoll, EPOLL_CTL_DEL, s->_fd, nullptr);
+    close(s->_fd);
+    s->_fd = -1;
+    _closed.push_back(s);
+  }
+
+  /// Release closed sessions once no event refers to them
+  void Collect()
+  {
+    if (_closed.empty())
+      return;
+    for (auto s : _closed)
+      for (auto &owned : _sessions)
+        if (owned.get() == s)
+        {
+          owned.swap(_sessions.back());
+          _sessions.pop_back();
+          break;
+        }
+    _closed.clear();
+    _count = _sessions.size();
+  }
+};
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  const char *path{argc > 1 ? argv[1] : "/tmp/tetris.sock"};
+  int workerCount(std::thread::hardware_concurrency());
+  if (argc > 2)
+    workerCount = std::atoi(argv[2]);
+  workerCount = std::max(workerCount, 1);
+
+  int listener{socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)};
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  std::snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+  unlink(path);
+  if (listener < 0 ||
+      bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+      listen(listener, SOMAXCONN) < 0)
+  {
+    std::perror(path);
+    return 1;
+  }
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  Tetris::GravityScheduler gravity{
+      static_cast<std::size_t>(workerCount),
+      [&workers](std::size_t w, Tetris::GravityScheduler::Batch &batch) {
+        workers[w]->Fall(batch);
+      }};
+  std::vector<std::thread> threads;
+  for (int i{0}; i < workerCount; i++)
+  {
+    workers.push_back(std::make_unique<Worker>(gravity));
+    threads.emplace_back([w = workers.back().get()]() { w->Run(); });
+  }
+  std::printf("pid %d: listening on %s with %d workers\n", getpid(), path,
+              workerCount);
+  std::fflush(stdout);
+
+  for (std::uint32_t id{1};; id++)
+  {
+    int fd{accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)};
+    if (fd < 0)
+    {
+      if (errno == EMFILE || errno == ENFILE)
+        std::perror("accept");
+      continue;
+    }
+    workers[id % workers.size()]->Adopt(fd, id);
+  }
+}
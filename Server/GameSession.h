@@ -0,0 +1,120 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Game hosted as a coroutine session
+
+#ifndef __TETRIS_GAME_SESSION_H__
+#define __TETRIS_GAME_SESSION_H__
+
+#include "Gravity.h"
+#include "Protocol.h"
+#include "SessionExecutor.h"
+#include "TetrisGame.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace Tetris
+{
+/// @brief Session playing a single game
+///
+/// Commands are applied as they come; figures fall on the session's own
+/// timer, exactly like in the game server. After every command and
+/// every fall the session yields rows of the screen that have changed.
+/// The game, the encoder and the frame buffer live in the coroutine's
+/// frame, which is all a waiting session takes.
+///
+/// @param seed - seed of the game
+/// @param slot - if given, the game continues from there instead and is
+///   written back when the session is closed, see ResumeGame. A slot that
+///   is not a valid record, see Game::Valid, gets the new game.
+inline Session PlayGame(std::uint32_t seed, Game::Packed *slot = nullptr)
+{
+  using Clock = std::chrono::steady_clock;
+
+  Game game{seed};
+  if (slot)
+    game.Restore(*slot);
+  Wire::DeltaEncoder delta;
+  std::array<std::uint8_t, Wire::MaxFrameSize> frame;
+  std::uint16_t seq{0};
+  auto fall{[&game] {
+    return Clock::now() + (game.Grounded() ? LockDelay
+                                           : FallInterval(game.Level()));
+  }};
+
+  auto deadline{fall()};
+  for (;;)
+  {
+    // the first frame carries the whole screen; frames are handed to the
+    // sink before the session runs again
+    auto size{delta.Encode(game.Board(), seq, frame.data())};
+    delta.Commit();
+    co_yield SessionFrame{frame.data(), size, 0};
+
+    auto e{co_await NextEvent{deadline}};
+    if (e._kind == SessionEvent::Kind::close)
+    {
+      if (slot)
+        game.Save(*slot);
+      co_return;
+    }
+
+    if (e._kind == SessionEvent::Kind::timer)
+    {
+      game.Input(Command::TranslateDown);
+      game.Tick();
+      deadline = fall();
+    }
+    else
+    {
+      game.Input(static_cast<Command>(e._packet._cmd));
+      game.Tick();
+      seq = e._packet._seq;
+    }
+  }
+}
+
+/// @brief Session playing a game kept in a slot, see SessionStore
+///
+/// To hibernate an idle session, close it: it writes its game back to the
+/// slot and its frame is freed. To resume, spawn ResumeGame with the same
+/// ID. Both run on the same worker, which runs the closed session to its
+/// end before it starts the new one, so the slot is never read before it
+/// has been written. Gravity stops while the game is in the slot.
+///
+/// @param slot - game to continue, written back when the session is closed
+inline Session ResumeGame(Game::Packed &slot) { return PlayGame(0, &slot); }
+
+} // namespace Tetris
+
+#endif //__TETRIS_GAME_SESSION_H__
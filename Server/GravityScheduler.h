@@ -0,0 +1,175 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Gravity timers of all hosted games
+
+#ifndef __TETRIS_GRAVITY_SCHEDULER_H__
+#define __TETRIS_GRAVITY_SCHEDULER_H__
+
+#include "TimerWheel.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Tetris
+{
+/// @brief Drives gravity of all games from a single thread
+///
+/// Replaces a sleeping thread per game. Games are identified by session
+/// ID and belong to worker `id % workers`. Workers ask for a game's next
+/// gravity tick with Schedule, giving the fall interval of the game's
+/// level or the lock delay when its figure has landed. Requests are
+/// queued and applied by the scheduler's thread, which alone owns the
+/// timer wheel. Games expiring in the same tick are delivered as a single
+/// batch per worker.
+class GravityScheduler
+{
+public:
+  /// Batch of session IDs due for a 'down' command
+  using Batch = std::vector<std::uint32_t>;
+  /// Receives the batch of a worker
+  using Deliver = std::function<void(std::size_t worker, Batch &)>;
+
+  /// @param workers - number of workers the sessions are sharded over
+  /// @param deliver - called from the scheduler's thread
+  GravityScheduler(std::size_t workers, Deliver deliver)
+      : _deliver{std::move(deliver)}
+      , _batches(workers)
+      , _start{Clock::now()}
+      , _thread{[this]() { Run(); }}
+  {
+  }
+
+  ~GravityScheduler()
+  {
+    _stop = true;
+    _thread.join();
+  }
+
+  /// @brief (Re)arm the gravity timer of a session. Thread safe.
+  /// @param id - session ID
+  /// @param delay - time to the next 'down' command
+  void Schedule(std::uint32_t id, std::chrono::milliseconds delay)
+  {
+    std::lock_guard<std::mutex> lock{_requestsLock};
+    _requests.push_back({id, delay.count()});
+  }
+
+  /// @brief Stop the gravity timer of a closed session. Thread safe.
+  void Cancel(std::uint32_t id)
+  {
+    std::lock_guard<std::mutex> lock{_requestsLock};
+    _requests.push_back({id, CancelRequest});
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr std::int64_t CancelRequest{-1};
+
+  struct Request
+  {
+    std::uint32_t _id;
+    std::int64_t _delay;
+  };
+
+  struct Timer : TimerNode
+  {
+    std::uint32_t _id;
+  };
+
+  Deliver _deliver;
+  std::vector<Batch> _batches;
+  Clock::time_point _start;
+  std::mutex _requestsLock;
+  std::vector<Request> _requests;
+  std::atomic<bool> _stop{false};
+  /// Everything below is touched only by the scheduler's thread
+  TimerWheel<Timer> _wheel;
+  std::unordered_map<std::uint32_t, Timer> _timers;
+  std::thread _thread;
+
+  /// Milliseconds since the scheduler has started
+  std::uint64_t Tick() const
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               Clock::now() - _start)
+        .count();
+  }
+
+  void Run()
+  {
+    std::vector<Request> requests;
+    while (!_stop)
+    {
+      auto next{_start + std::chrono::milliseconds(_wheel.Now() + 1)};
+      std::this_thread::sleep_until(next);
+
+      {
+        std::lock_guard<std::mutex> lock{_requestsLock};
+        requests.swap(_requests);
+      }
+      for (auto r : requests)
+      {
+        if (r._delay == CancelRequest)
+          _timers.erase(r._id);
+        else
+        {
+          auto &timer{_timers[r._id]};
+          timer._id = r._id;
+          _wheel.Arm(timer, r._delay);
+        }
+      }
+      requests.clear();
+
+      _wheel.Advance(Tick(), [this](Timer &t) {
+        _batches[t._id % _batches.size()].push_back(t._id);
+      });
+
+      for (std::size_t w{0}; w < _batches.size(); w++)
+        if (!_batches[w].empty())
+        {
+          _deliver(w, _batches[w]);
+          _batches[w].clear();
+        }
+    }
+  }
+};
+
+} // namespace Tetris
+
+#endif //__TETRIS_GRAVITY_SCHEDULER_H__
@@ -0,0 +1,298 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Load generator of the game server (Linux)
+///
+/// Opens many sessions to the server and sends commands to each of them
+/// at a fixed rate. Measures time from sending a command to receiving
+/// the frame that reacts to it. When the server's pid is given, the
+/// server's CPU time is sampled too, to tell how many sessions a single
+/// core can host at this rate.
+///
+/// Usage: LoadGenerator [socket path] [sessions] [seconds]
+///                      [commands per second per session] [threads]
+///                      [server pid]
+
+#include "Protocol.h"
+#include "Random.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+/// Commands that may be in flight per session
+constexpr std::uint16_t Window{64};
+
+struct Config
+{
+  const char *path{"/tmp/tetris.sock"};
+  int sessions{1000};
+  double seconds{10};
+  double rate{10};
+  int threads{1};
+  int serverPid{0};
+};
+
+/// @brief Client's side of a session
+struct Client
+{
+  int _fd{-1};
+  std::uint16_t _seq{0};
+  std::uint16_t _acked{0};
+  Clock::time_point _next;
+  std::array<Clock::time_point, Window> _sentAt;
+  Tetris::Wire::BoardMasks _board{};
+};
+
+/// @brief Results of a single thread
+struct Result
+{
+  std::vector<std::uint32_t> latencyUs;
+  std::uint64_t sent{0};
+  std::uint64_t frames{0};
+  std::uint64_t dropped{0};
+  int failed{0};
+};
+
+int Connect(const char *path)
+{
+  int fd{socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)};
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  std::snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+  if (fd < 0 ||
+      connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+  {
+    if (fd >= 0)
+      close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/// @brief Run a share of the sessions
+void Run(const Config &cfg, int sessions, std::uint32_t seed, Result &res)
+{
+  Tetris::Random rng{seed};
+  std::vector<Client> clients(sessions);
+  int epoll{epoll_create1(EPOLL_CLOEXEC)};
+  auto period{std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(1 / cfg.rate))};
+  auto start{Clock::now()};
+
+  for (auto &c : clients)
+  {
+    c._fd = Connect(cfg.path);
+    if (c._fd < 0)
+    {
+      res.failed++;
+      continue;
+    }
+    // spread sends of all sessions over the period
+    c._next = start + period * rng.Below(1000) / 1000;
+    epoll_event ev{};
+    ev.events   = EPOLLIN;
+    ev.data.ptr = &c;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, c._fd, &ev);
+  }
+
+  auto end{start + std::chrono::duration_cast<Clock::duration>(
+                       std::chrono::duration<double>(cfg.seconds))};
+  std::array<epoll_event, 256> events;
+  std::array<std::uint8_t, Tetris::Wire::MaxFrameSize> buf;
+  while (Clock::now() < end)
+  {
+    auto now{Clock::now()};
+    auto wake{end};
+    for (auto &c : clients)
+    {
+      if (c._fd < 0)
+        continue;
+      if (c._next <= now)
+      {
+        std::uint16_t inFlight = c._seq - c._acked;
+        Tetris::Wire::CommandPacket pkt{
+            static_cast<std::uint16_t>(c._seq + 1),
+            static_cast<std::uint8_t>(1 + rng.Below(5)), 0};
+        if (inFlight < Window - 1 &&
+            send(c._fd, &pkt, sizeof(pkt), MSG_DONTWAIT | MSG_NOSIGNAL) ==
+                sizeof(pkt))
+        {
+          c._seq                     = pkt._seq;
+          c._sentAt[c._seq % Window] = Clock::now();
+          res.sent++;
+        }
+        else
+          res.dropped++;
+        c._next += period;
+      }
+      wake = std::min(wake, c._next);
+    }
+
+    auto timeout{std::chrono::duration_cast<std::chrono::milliseconds>(
+                     wake - Clock::now())
+                     .count()};
+    auto n{epoll_wait(epoll, events.data(), events.size(),
+                      static_cast<int>(std::max<long long>(timeout, 0)))};
+    for (int i{0}; i < n; i++)
+    {
+      auto &c{*static_cast<Client *>(events[i].data.ptr)};
+      ssize_t size;
+      while ((size = recv(c._fd, buf.data(), buf.size(), MSG_DONTWAIT)) > 0)
+      {
+        auto received{Clock::now()};
+        auto hdr{Tetris::Wire::Decode(buf.data(), size, c._board)};
+        res.frames++;
+        // frame acknowledges every command up to its sequence
+        while (static_cast<std::int16_t>(hdr._seq - c._acked) > 0)
+        {
+          c._acked++;
+          res.latencyUs.push_back(static_cast<std::uint32_t>(
+              std::chrono::duration_cast<std::chrono::microseconds>(
+                  received - c._sentAt[c._acked % Window])
+                  .count()));
+        }
+      }
+    }
+  }
+
+  for (auto &c : clients)
+    if (c._fd >= 0)
+      close(c._fd);
+  close(epoll);
+}
+
+/// CPU time of a process in seconds, 0 when unknown
+double CpuSeconds(int pid)
+{
+  if (pid <= 0)
+    return 0;
+  char name[64];
+  std::snprintf(name, sizeof(name), "/proc/%d/stat", pid);
+  auto f{std::fopen(name, "r")};
+  if (f == nullptr)
+    return 0;
+  unsigned long utime{0}, stime{0};
+  // skip pid, comm and fields 3..13
+  int matched{std::fscanf(f,
+                          "%*d %*s %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u "
+                          "%*u %lu %lu",
+                          &utime, &stime)};
+  std::fclose(f);
+  if (matched != 2)
+    return 0;
+  return static_cast<double>(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+std::uint32_t Percentile(const std::vector<std::uint32_t> &sorted, double p)
+{
+  if (sorted.empty())
+    return 0;
+  auto idx{static_cast<std::size_t>(p * (sorted.size() - 1))};
+  return sorted[idx];
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  Config cfg;
+  if (argc > 1)
+    cfg.path = argv[1];
+  if (argc > 2)
+    cfg.sessions = std::atoi(argv[2]);
+  if (argc > 3)
+    cfg.seconds = std::atof(argv[3]);
+  if (argc > 4)
+    cfg.rate = std::atof(argv[4]);
+  if (argc > 5)
+    cfg.threads = std::max(1, std::atoi(argv[5]));
+  if (argc > 6)
+    cfg.serverPid = std::atoi(argv[6]);
+
+  std::vector<Result> results(cfg.threads);
+  std::vector<std::thread> threads;
+  auto cpuStart{CpuSeconds(cfg.serverPid)};
+  auto start{Clock::now()};
+  for (int t{0}; t < cfg.threads; t++)
+  {
+    int share{cfg.sessions / cfg.threads +
+              (t < cfg.sessions % cfg.threads ? 1 : 0)};
+    threads.emplace_back(
+        [&, t, share]() { Run(cfg, share, 1000 + t, results[t]); });
+  }
+  for (auto &t : threads)
+    t.join();
+  std::chrono::duration<double> wall{Clock::now() - start};
+  auto cpu{CpuSeconds(cfg.serverPid) - cpuStart};
+
+  Result total;
+  for (auto &r : results)
+  {
+    total.latencyUs.insert(total.latencyUs.end(), r.latencyUs.begin(),
+                           r.latencyUs.end());
+    total.sent += r.sent;
+    total.frames += r.frames;
+    total.dropped += r.dropped;
+    total.failed += r.failed;
+  }
+  std::sort(total.latencyUs.begin(), total.latencyUs.end());
+
+  std::printf("sessions %d (failed %d), %.1f s, %.0f commands/s\n",
+              cfg.sessions, total.failed, wall.count(),
+              total.sent / wall.count());
+  std::printf("frames %llu, dropped commands %llu\n",
+              static_cast<unsigned long long>(total.frames),
+              static_cast<unsigned long long>(total.dropped));
+  std::printf("command to frame: p50 %u us, p99 %u us, p99.9 %u us, "
+              "max %u us\n",
+              Percentile(total.latencyUs, 0.5),
+              Percentile(total.latencyUs, 0.99),
+              Percentile(total.latencyUs, 0.999),
+              total.latencyUs.empty() ? 0 : total.latencyUs.back());
+  if (cpu > 0)
+    std::printf("server busy %.2f cores, %.0f sessions per core\n",
+                cpu / wall.count(),
+                (cfg.sessions - total.failed) / (cpu / wall.count()));
+  return 0;
+}
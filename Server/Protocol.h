@@ -0,0 +1,163 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Messages exchanged by the game server and its clients
+///
+/// Messages are sent over sequenced packet sockets, so a single message
+/// is a single packet and no framing is needed.
+
+#ifndef __TETRIS_PROTOCOL_H__
+#define __TETRIS_PROTOCOL_H__
+
+#include "Command.h"
+#include "ScreenDef.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace Tetris
+{
+namespace Wire
+{
+/// @brief Client to server: one command of a session
+struct CommandPacket
+{
+  std::uint16_t _seq; ///< echoed back in the frame reacting to it
+  std::uint8_t _cmd;  ///< Tetris::Command
+  std::uint8_t _reserved;
+};
+
+/// @brief Server to client: header of a frame
+///
+/// Followed by `_rows` RowDelta records.
+struct FrameHeader
+{
+  std::uint16_t _seq; ///< sequence of the last applied command
+  std::uint8_t _rows; ///< number of changed rows
+  std::uint8_t _flags;
+};
+
+/// @brief Single changed row of the screen
+struct RowDelta
+{
+  std::uint8_t _row;
+  std::uint8_t _reserved;
+  std::uint16_t _mask; ///< see Tetris::LineMask
+};
+
+static_assert(sizeof(CommandPacket) == 4, "packed command");
+static_assert(sizeof(FrameHeader) == 4, "packed frame header");
+static_assert(sizeof(RowDelta) == 4, "packed row");
+static_assert(TetrisScreen::Width() <= 16, "row must fit in the mask");
+static_assert(TetrisScreen::Depth() <= 255, "row index must fit in a byte");
+
+/// Biggest frame: all rows changed
+constexpr std::size_t MaxFrameSize{sizeof(FrameHeader) +
+                                   TetrisScreen::Depth() * sizeof(RowDelta)};
+
+/// Rows of the screen as bit masks
+using BoardMasks = std::array<std::uint16_t, TetrisScreen::Depth()>;
+
+/// @brief Encoder of screen changes
+///
+/// Remembers what the client has already received and encodes only rows
+/// that differ. If a frame cannot be sent, it is not committed and the
+/// next frame carries all changes since the last one that went out.
+class DeltaEncoder
+{
+public:
+  /// Client has not received anything yet, so every row is sent
+  DeltaEncoder() { _sent.fill(0xFFFF); }
+
+  /// @brief Encode changes of the screen
+  /// @param screen - present screen
+  /// @param seq - sequence of the last applied command
+  /// @param buf - at least MaxFrameSize bytes
+  /// @returns size of the frame
+  std::size_t Encode(const TetrisScreen &screen, std::uint16_t seq,
+                     std::uint8_t *buf)
+  {
+    FrameHeader hdr{seq, 0, 0};
+    auto out{buf + sizeof(hdr)};
+    const auto &lines{screen.Lines()};
+    for (std::size_t r{0}; r < lines.size(); r++)
+    {
+      _pending[r] = static_cast<std::uint16_t>(LineMask(lines[r]));
+      if (_pending[r] == _sent[r])
+        continue;
+      RowDelta d{static_cast<std::uint8_t>(r), 0, _pending[r]};
+      std::memcpy(out, &d, sizeof(d));
+      out += sizeof(d);
+      hdr._rows++;
+    }
+    std::memcpy(buf, &hdr, sizeof(hdr));
+    return out - buf;
+  }
+
+  /// Last encoded frame has been delivered
+  void Commit() { _sent = _pending; }
+
+private:
+  BoardMasks _sent;
+  BoardMasks _pending{};
+};
+
+/// @brief Apply a frame to client's copy of the screen
+/// @param buf - received frame
+/// @param size - size of the frame
+/// @param board - client's copy of the screen
+/// @returns header of the frame
+inline FrameHeader Decode(const std::uint8_t *buf, std::size_t size,
+                          BoardMasks &board)
+{
+  FrameHeader hdr{};
+  if (size < sizeof(hdr))
+    return hdr;
+  std::memcpy(&hdr, buf, sizeof(hdr));
+  auto rows{std::min<std::size_t>(hdr._rows,
+                                  (size - sizeof(hdr)) / sizeof(RowDelta))};
+  for (std::size_t i{0}; i < rows; i++)
+  {
+    RowDelta d;
+    std::memcpy(&d, buf + sizeof(hdr) + i * sizeof(d), sizeof(d));
+    if (d._row < board.size())
+      board[d._row] = d._mask;
+  }
+  return hdr;
+}
+
+} // namespace Wire
+} // namespace Tetris
+
+#endif //__TETRIS_PROTOCOL_H__
@@ -0,0 +1,184 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Many coroutine sessions on a few threads
+///
+/// Sessions of PlayGame run on a SessionExecutor, one worker per core. A
+/// client thread posts random commands to all of them at a given rate.
+/// The harness reports frames per second, the cost of switching to a
+/// session and back, and compares it with switching between two threads.
+///
+/// Usage: SessionBench [sessions] [workers] [seconds] [commands/s per session]
+
+#include "GameSession.h"
+#include "Random.h"
+#include "SessionExecutor.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <semaphore>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+/// Nanoseconds of a switch between two threads, by a semaphore ping-pong
+double ThreadSwitchNs()
+{
+  constexpr std::int32_t Rounds{20000};
+  std::binary_semaphore ping{0}, pong{0};
+  std::thread other{[&] {
+    for (std::int32_t i{0}; i < Rounds; i++)
+    {
+      ping.acquire();
+      pong.release();
+    }
+  }};
+  auto start{Clock::now()};
+  for (std::int32_t i{0}; i < Rounds; i++)
+  {
+    ping.release();
+    pong.acquire();
+  }
+  std::chrono::duration<double, std::nano> ns{Clock::now() - start};
+  other.join();
+  return ns.count() / (2 * Rounds);
+}
+
+/// @brief Bytes of frames received by a worker's sink
+///
+/// Only the worker adds to it, the main thread reads it while workers
+/// still run.
+struct alignas(64) Received
+{
+  std::atomic<std::uint64_t> _bytes{0};
+};
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  using namespace Tetris;
+
+  std::uint32_t sessions{argc > 1 ? static_cast<std::uint32_t>(std::atoi(argv[1]))
+                                  : 10000};
+  std::uint32_t workers{argc > 2 ? static_cast<std::uint32_t>(std::atoi(argv[2]))
+                                 : std::max(1u, std::thread::hardware_concurrency())};
+  std::int32_t seconds{argc > 3 ? std::atoi(argv[3]) : 3};
+  std::int32_t rate{argc > 4 ? std::atoi(argv[4]) : 10};
+
+  std::vector<Received> received(workers);
+  std::vector<SessionRef> refs;
+  std::uint64_t posted{0}, dropped{0};
+  {
+    SessionExecutor executor{workers,
+                             [&](const SessionFrame &f, std::uint32_t w) {
+                               received[w]._bytes.fetch_add(
+                                   f._size, std::memory_order_relaxed);
+                             }};
+    for (std::uint32_t id{0}; id < sessions; id++)
+      refs.push_back(executor.Spawn(PlayGame(id), id));
+    auto frameBytes{Session::Bytes()};
+
+    // one client thread posts to every session, rounds paced by the rate
+    Random rng{2019};
+    auto start{Clock::now()};
+    auto end{start + std::chrono::seconds{seconds}};
+    auto round{std::chrono::nanoseconds{std::chrono::seconds{1}} / rate};
+    std::uint16_t seq{0};
+    for (auto next{start}; next < end; next += round)
+    {
+      std::this_thread::sleep_until(next);
+      seq++;
+      for (auto &r : refs)
+      {
+        auto cmd{static_cast<std::uint8_t>(
+            rng.Below(static_cast<std::int32_t>(Command::TranslateDown) + 1))};
+        if (r.Post(Wire::CommandPacket{seq, cmd, 0}))
+          posted++;
+        else
+          dropped++;
+      }
+    }
+    std::chrono::duration<double> elapsed{Clock::now() - start};
+
+    SessionExecutor::Stats total{};
+    for (std::uint32_t w{0}; w < workers; w++)
+    {
+      auto s{executor.Statistics(w)};
+      total._resumes += s._resumes;
+      total._frames += s._frames;
+      total._sessions += s._sessions;
+      total._busy += s._busy;
+    }
+
+    // sessions finish when closed
+    for (auto &r : refs)
+      r.Close();
+    std::uint64_t alive{total._sessions};
+    for (auto wait{Clock::now() + std::chrono::seconds{5}};
+         alive > 0 && Clock::now() < wait;)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+      alive = 0;
+      for (std::uint32_t w{0}; w < workers; w++)
+        alive += executor.Statistics(w)._sessions;
+    }
+
+    std::uint64_t bytes{0};
+    for (const auto &r : received)
+      bytes += r._bytes.load(std::memory_order_relaxed);
+    std::printf("%u sessions on %u workers, %.2f s\n", sessions, workers,
+                elapsed.count());
+    std::printf("  coroutine frames: %zu bytes per session (Game %zu)\n",
+                frameBytes / sessions, sizeof(Game));
+    std::printf("  commands posted %llu, dropped %llu\n",
+                static_cast<unsigned long long>(posted),
+                static_cast<unsigned long long>(dropped));
+    std::printf("  frames %.0f/s, %.1f bytes avg\n",
+                total._frames / elapsed.count(),
+                total._frames ? static_cast<double>(bytes) / total._frames
+                              : 0.0);
+    std::printf("  resumes %.0f/s, %.0f ns per resume incl. the game\n",
+                total._resumes / elapsed.count(),
+                total._resumes ? static_cast<double>(total._busy.count()) /
+                                     total._resumes
+                               : 0.0);
+    std::printf("  sessions left after close: %llu\n",
+                static_cast<unsigned long long>(alive));
+  }
+  std::printf("  thread switch: %.0f ns\n", ThreadSwitchNs());
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,566 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Coroutine sessions multiplexed on a few threads
+///
+/// A session is a coroutine. It waits for its next command or its timer
+/// with `co_await NextEvent{deadline}` and hands out frames with
+/// `co_yield`. While it waits, it is only its coroutine frame: no thread,
+/// no stack.
+///
+/// Every worker thread has its own sessions, its own run queue and its
+/// own timer wheel, so running a session never takes a lock. Other
+/// threads post commands to a session's inbox; when the session is
+/// waiting they push it to its worker's wake-up stack, which is lock-free.
+
+#ifndef __TETRIS_SESSION_EXECUTOR_H__
+#define __TETRIS_SESSION_EXECUTOR_H__
+
+#include "Protocol.h"
+#include "TimerWheel.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <new>
+#include <semaphore>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace Tetris
+{
+class SessionExecutor;
+
+/// @brief What has woken a session up
+struct SessionEvent
+{
+  enum class Kind : std::uint8_t
+  {
+    command, ///< a command has arrived, see _packet
+    timer,   ///< the deadline has passed
+    close    ///< the session has to finish
+  };
+
+  Kind _kind;
+  Wire::CommandPacket _packet;
+};
+
+/// @brief Frame a session hands out with co_yield
+struct SessionFrame
+{
+  const std::uint8_t *_data;
+  std::size_t _size;
+  /// ID of the session, filled in by the executor
+  std::uint32_t _session;
+};
+
+/// @brief Wait for a command or a deadline, whatever comes first
+struct NextEvent
+{
+  std::chrono::steady_clock::time_point _deadline;
+};
+
+/// @brief Coroutine of a session
+///
+/// Owns the coroutine until it is given to SessionExecutor::Spawn.
+class Session
+{
+public:
+  class promise_type;
+  using Handle = std::coroutine_handle<promise_type>;
+
+  /// Commands a session's inbox holds
+  static constexpr std::uint32_t InboxSize{16};
+
+  explicit Session(Handle h)
+      : _handle{h}
+  {
+  }
+  Session(Session &&s)
+      : _handle{std::exchange(s._handle, nullptr)}
+  {
+  }
+  Session(const Session &) = delete;
+  void operator=(const Session &) = delete;
+  ~Session()
+  {
+    if (_handle)
+      _handle.destroy();
+  }
+
+  /// Bytes taken by coroutine frames of all sessions alive
+  static std::size_t Bytes() { return FrameBytes.load(); }
+
+private:
+  friend class SessionExecutor;
+
+  Handle _handle;
+
+  static inline std::atomic<std::size_t> FrameBytes{0};
+};
+
+/// @brief Handle to post commands to a spawned session
+///
+/// Posting is single producer: one thread posts to a session. A session
+/// must not be posted to after it has been closed.
+class SessionRef
+{
+public:
+  SessionRef() = default;
+
+  /// @brief Give the session a command
+  /// @returns false when the inbox is full and the command is dropped
+  bool Post(Wire::CommandPacket packet);
+
+  /// @brief Ask the session to finish
+  void Close();
+
+private:
+  friend class SessionExecutor;
+
+  explicit SessionRef(Session::promise_type *p)
+      : _p{p}
+  {
+  }
+
+  Session::promise_type *_p{nullptr};
+};
+
+class Session::promise_type
+{
+public:
+  Session get_return_object() { return Session{Handle::from_promise(*this)}; }
+  /// Sessions start when their worker runs them first
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  std::suspend_always final_suspend() noexcept { return {}; }
+  void return_void() {}
+  void unhandled_exception() { std::terminate(); }
+
+  /// Frame goes to the executor's sink, then the session runs again
+  std::suspend_always yield_value(SessionFrame frame)
+  {
+    _frame   = frame;
+    _yielded = true;
+    return {};
+  }
+
+  auto await_transform(NextEvent e);
+
+  static void *operator new(std::size_t size)
+  {
+    FrameBytes.fetch_add(size, std::memory_order_relaxed);
+    return ::operator new(size);
+  }
+  static void operator delete(void *p, std::size_t size)
+  {
+    FrameBytes.fetch_sub(size, std::memory_order_relaxed);
+    ::operator delete(p);
+  }
+
+private:
+  friend class SessionExecutor;
+  friend class SessionRef;
+
+  /// @brief Who runs the session, and whether it has to finish
+  ///
+  /// Whoever takes the session out of `Waiting` hands it to the worker.
+  /// The closing flag is set in the same word, so a closed session
+  /// cannot finish before the closing thread has let go of it.
+  static constexpr std::uint8_t Running{0}; ///< its worker, or its run queue
+  static constexpr std::uint8_t Waiting{1}; ///< nobody, waits for an event
+  static constexpr std::uint8_t Woken{2};   ///< on the way to the run queue
+  static constexpr std::uint8_t Closing{4}; ///< flag, has to finish
+
+  /// @brief Timer of a session on its worker's wheel
+  struct Timer : TimerNode
+  {
+    promise_type *_session;
+  };
+
+  SessionExecutor *_executor{nullptr};
+  std::uint32_t _id{0};
+  std::uint32_t _worker{0};
+  std::atomic<std::uint8_t> _state{Running};
+
+  /// Single producer, single consumer ring of commands
+  std::array<Wire::CommandPacket, InboxSize> _inbox{};
+  std::atomic<std::uint32_t> _head{0};
+  std::atomic<std::uint32_t> _tail{0};
+
+  /// Everything below belongs to the worker
+  Timer _timer{};
+  /// Next session on the worker's wake-up stack
+  promise_type *_nextWoken{nullptr};
+  /// Index in the worker's list of sessions
+  std::size_t _index{0};
+  SessionFrame _frame{};
+  bool _yielded{false};
+
+  bool HasMessage() const
+  {
+    return (_state.load(std::memory_order_seq_cst) & Closing) != 0 ||
+           _head.load(std::memory_order_seq_cst) !=
+               _tail.load(std::memory_order_relaxed);
+  }
+
+  SessionEvent TakeEvent()
+  {
+    if ((_state.load(std::memory_order_acquire) & Closing) != 0)
+      return SessionEvent{SessionEvent::Kind::close, {}};
+    auto tail{_tail.load(std::memory_order_relaxed)};
+    if (_head.load(std::memory_order_acquire) == tail)
+      return SessionEvent{SessionEvent::Kind::timer, {}};
+    auto packet{_inbox[tail % InboxSize]};
+    _tail.store(tail + 1, std::memory_order_release);
+    return SessionEvent{SessionEvent::Kind::command, packet};
+  }
+
+  /// Awaiter of NextEvent
+  struct EventAwaiter
+  {
+    promise_type &_p;
+    std::chrono::steady_clock::time_point _deadline;
+
+    bool await_ready() const
+    {
+      return _p.HasMessage() ||
+             std::chrono::steady_clock::now() >= _deadline;
+    }
+    bool await_suspend(Handle h);
+    SessionEvent await_resume()
+    {
+      _p._timer.Cancel();
+      return _p.TakeEvent();
+    }
+  };
+};
+
+inline auto Session::promise_type::await_transform(NextEvent e)
+{
+  return EventAwaiter{*this, e._deadline};
+}
+
+/// @brief Threads running sessions
+class SessionExecutor
+{
+public:
+  /// Receives frames, called on the worker that runs the session
+  using Sink = std::function<void(const SessionFrame &, std::uint32_t worker)>;
+
+  /// @brief Counters of a worker
+  struct Stats
+  {
+    std::uint64_t _resumes;
+    std::uint64_t _frames;
+    std::uint64_t _sessions;
+    /// Time spent running sessions
+    std::chrono::nanoseconds _busy;
+  };
+
+  /// @param workers - number of threads, usually one per core
+  /// @param sink - receives frames sessions yield
+  SessionExecutor(std::uint32_t workers, Sink sink)
+      : _sink{std::move(sink)}
+      , _start{std::chrono::steady_clock::now()}
+      , _workers(workers)
+  {
+    for (std::uint32_t w{0}; w < workers; w++)
+    {
+      _workers[w]._index  = w;
+      _workers[w]._thread = std::thread{[this, w] { Run(_workers[w]); }};
+    }
+  }
+
+  SessionExecutor(const SessionExecutor &) = delete;
+  void operator=(const SessionExecutor &) = delete;
+
+  /// Stops workers and destroys sessions that have not finished
+  ~SessionExecutor()
+  {
+    _stop.store(true);
+    for (auto &w : _workers)
+      Wake(w);
+    for (auto &w : _workers)
+      w._thread.join();
+
+    for (auto &w : _workers)
+    {
+      for (auto *p : w._sessions)
+        Session::Handle::from_promise(*p).destroy();
+      for (auto *p{w._woken.exchange(nullptr)}; p;)
+      {
+        auto *next{p->_nextWoken};
+        if (p->_index == NotStarted)
+          Session::Handle::from_promise(*p).destroy();
+        p = next;
+      }
+    }
+  }
+
+  /// @brief Run a session on the worker `id % workers`. Thread safe.
+  /// @param s - session to run
+  /// @param id - ID the session's frames carry
+  SessionRef Spawn(Session s, std::uint32_t id)
+  {
+    auto &p{std::exchange(s._handle, nullptr).promise()};
+    p._executor = this;
+    p._id       = id;
+    p._worker   = id % _workers.size();
+    p._index    = NotStarted;
+    Push(p);
+    return SessionRef{&p};
+  }
+
+  /// Number of workers
+  std::uint32_t Workers() const
+  {
+    return static_cast<std::uint32_t>(_workers.size());
+  }
+
+  /// Counters of a worker, updated as it goes
+  Stats Statistics(std::uint32_t worker) const
+  {
+    const auto &w{_workers[worker]};
+    return Stats{w._resumes.load(std::memory_order_relaxed),
+                 w._frames.load(std::memory_order_relaxed),
+                 w._count.load(std::memory_order_relaxed),
+                 std::chrono::nanoseconds{
+                     w._busy.load(std::memory_order_relaxed)}};
+  }
+
+private:
+  friend class SessionRef;
+  friend class Session::promise_type;
+
+  using Promise = Session::promise_type;
+
+  static constexpr std::size_t NotStarted{~std::size_t{0}};
+
+  struct alignas(64) Worker
+  {
+    /// Sessions woken by other threads, a lock-free stack
+    std::atomic<Promise *> _woken{nullptr};
+    /// Worker waits for the semaphore
+    std::atomic<bool> _sleeping{false};
+    std::binary_semaphore _wake{0};
+
+    /// Everything below belongs to the worker's thread
+    std::deque<Promise *> _ready;
+    std::vector<Promise *> _sessions;
+    TimerWheel<Promise::Timer> _timers;
+    std::uint32_t _index{0};
+    std::thread _thread;
+
+    std::atomic<std::uint64_t> _resumes{0};
+    std::atomic<std::uint64_t> _frames{0};
+    std::atomic<std::uint64_t> _count{0};
+    std::atomic<std::int64_t> _busy{0};
+  };
+
+  Sink _sink;
+  std::chrono::steady_clock::time_point _start;
+  std::deque<Worker> _workers;
+  std::atomic<bool> _stop{false};
+
+  /// Milliseconds since the executor has started, the wheels' tick
+  std::uint64_t Tick(std::chrono::steady_clock::time_point t) const
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(t - _start)
+        .count();
+  }
+
+  /// @brief Hand a session to its worker, from any thread
+  void Push(Promise &p)
+  {
+    auto &w{_workers[p._worker]};
+    auto *top{w._woken.load(std::memory_order_relaxed)};
+    do
+      p._nextWoken = top;
+    while (!w._woken.compare_exchange_weak(top, &p, std::memory_order_release,
+                                           std::memory_order_relaxed));
+    Wake(w);
+  }
+
+  /// @brief Wake a session up that waits, from any thread
+  void Wake(Promise &p)
+  {
+    auto waiting{Promise::Waiting};
+    if (p._state.compare_exchange_strong(waiting, Promise::Woken,
+                                         std::memory_order_seq_cst))
+      Push(p);
+  }
+
+  static void Wake(Worker &w)
+  {
+    // only the thread that ends the sleep releases the semaphore
+    if (w._sleeping.exchange(false, std::memory_order_seq_cst))
+      w._wake.release();
+  }
+
+  /// @brief Wait for a wake-up or the next tick
+  void Sleep(Worker &w)
+  {
+    w._sleeping.store(true, std::memory_order_seq_cst);
+    auto woken{w._woken.load(std::memory_order_seq_cst) != nullptr ||
+               _stop.load()};
+    if (woken || !w._wake.try_acquire_until(
+                     _start + std::chrono::milliseconds{Tick(
+                                  std::chrono::steady_clock::now()) + 1}))
+    {
+      // a waker that has seen the flag releases the semaphore; take it
+      if (!w._sleeping.exchange(false, std::memory_order_seq_cst))
+        w._wake.acquire();
+    }
+  }
+
+  void Run(Worker &w)
+  {
+    while (!_stop.load(std::memory_order_relaxed))
+    {
+      // wake-ups arrive newest first, reverse them to keep the order
+      auto *woken{w._woken.exchange(nullptr, std::memory_order_acquire)};
+      auto at{w._ready.size()};
+      for (; woken; woken = woken->_nextWoken)
+      {
+        if (woken->_index == NotStarted)
+        {
+          woken->_index = w._sessions.size();
+          w._sessions.push_back(woken);
+          w._count.store(w._sessions.size(), std::memory_order_relaxed);
+        }
+        // keeps the closing flag
+        woken->_state.fetch_and(Promise::Closing, std::memory_order_relaxed);
+        w._ready.insert(w._ready.begin() + at, woken);
+      }
+
+      auto now{std::chrono::steady_clock::now()};
+      w._timers.Advance(Tick(now), [&](Promise::Timer &t) {
+        auto waiting{Promise::Waiting};
+        if (t._session->_state.compare_exchange_strong(
+                waiting, Promise::Running, std::memory_order_seq_cst))
+          w._ready.push_back(t._session);
+      });
+
+      if (w._ready.empty())
+      {
+        Sleep(w);
+        continue;
+      }
+
+      // run what is ready now; sessions that yield go to the back
+      auto count{w._ready.size()};
+      for (std::size_t i{0}; i < count; i++)
+      {
+        auto *p{w._ready.front()};
+        w._ready.pop_front();
+        auto h{Session::Handle::from_promise(*p)};
+        h.resume();
+        w._resumes.fetch_add(1, std::memory_order_relaxed);
+
+        if (h.done())
+        {
+          w._sessions[p->_index]                  = w._sessions.back();
+          w._sessions[p->_index]->_index          = p->_index;
+          w._sessions.pop_back();
+          w._count.store(w._sessions.size(), std::memory_order_relaxed);
+          h.destroy();
+        }
+        else if (p->_yielded)
+        {
+          p->_yielded        = false;
+          p->_frame._session = p->_id;
+          _sink(p->_frame, w._index);
+          w._frames.fetch_add(1, std::memory_order_relaxed);
+          w._ready.push_back(p);
+        }
+      }
+      std::chrono::nanoseconds busy{std::chrono::steady_clock::now() - now};
+      w._busy.fetch_add(busy.count(), std::memory_order_relaxed);
+    }
+  }
+};
+
+inline bool Session::promise_type::EventAwaiter::await_suspend(Handle)
+{
+  auto &w{_p._executor->_workers[_p._worker]};
+  auto now{w._timers.Now()};
+  auto due{_p._executor->Tick(_deadline)};
+  _p._timer._session = &_p;
+  w._timers.Arm(_p._timer, due > now ? due - now : 1);
+
+  // A command posted after this store sees the session waiting and wakes
+  // it. One posted before is seen by the check that follows.
+  if ((_p._state.fetch_or(Waiting, std::memory_order_seq_cst) & Closing) != 0)
+  {
+    // closed while running, nobody else wakes it up
+    _p._state.store(Running | Closing, std::memory_order_relaxed);
+    return false;
+  }
+  if (_p.HasMessage())
+  {
+    auto waiting{Waiting};
+    if (_p._state.compare_exchange_strong(waiting, Running,
+                                          std::memory_order_seq_cst))
+      return false;
+  }
+  return true;
+}
+
+inline bool SessionRef::Post(Wire::CommandPacket packet)
+{
+  auto head{_p->_head.load(std::memory_order_relaxed)};
+  if (head - _p->_tail.load(std::memory_order_acquire) == Session::InboxSize)
+    return false;
+  _p->_inbox[head % Session::InboxSize] = packet;
+  _p->_head.store(head + 1, std::memory_order_seq_cst);
+  _p->_executor->Wake(*_p);
+  return true;
+}
+
+inline void SessionRef::Close()
+{
+  using Promise = Session::promise_type;
+  auto old{_p->_state.fetch_or(Promise::Closing, std::memory_order_seq_cst)};
+  // Nobody else takes a closing session out of Waiting. Once pushed, the
+  // session may finish any time, so it is not touched after that.
+  if (old == Promise::Waiting)
+    _p->_executor->Push(*_p);
+}
+
+} // namespace Tetris
+
+#endif //__TETRIS_SESSION_EXECUTOR_H__
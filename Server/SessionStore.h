@@ -0,0 +1,194 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Idle games kept in a memory mapped file (POSIX)
+
+#ifndef __TETRIS_SESSION_STORE_H__
+#define __TETRIS_SESSION_STORE_H__
+
+#include "TetrisGame.h"
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace Tetris
+{
+/// @brief Header at the beginning of a store file
+struct StoreHeader
+{
+  static constexpr std::array<char, 4> Magic{'T', 'S', 'T', 'O'};
+  static constexpr std::uint16_t Version{1};
+
+  std::array<char, 4> _magic{Magic};
+  std::uint16_t _version{Version};
+  std::uint16_t _slotSize{sizeof(Game::Packed)};
+  /// Number of slots that follow the header
+  std::uint64_t _slots{0};
+  std::uint8_t _reserved[16]{};
+};
+
+static_assert(sizeof(StoreHeader) == sizeof(Game::Packed),
+              "Header keeps slots aligned to their size");
+
+/// @brief Fixed size slots of games in a mapped file
+///
+/// A session that is idle writes its game into its slot and lets its
+/// coroutine go; the next command starts a new one from the slot. A slot
+/// is a Game::Packed record read and written in place, so keeping a game
+/// costs 32 bytes of the file and nothing else. The kernel decides which
+/// pages stay in memory: a million stored games are a 32 MB file, of
+/// which only the pages of recently touched slots are resident.
+///
+/// A slot is used by one thread at a time; the store does no locking.
+class SessionStore
+{
+public:
+  /// @brief Open a store file, create it or make it bigger if needed
+  /// @param path - file of the store
+  /// @param slots - number of slots needed
+  SessionStore(const std::string &path, std::uint64_t slots)
+  {
+    int fd{::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644)};
+    if (fd < 0)
+    {
+      std::perror(path.c_str());
+      return;
+    }
+    Map(fd, slots);
+    ::close(fd);
+    if (!Ok())
+      std::fprintf(stderr, "%s: not a store file\n", path.c_str());
+  }
+
+  SessionStore(const SessionStore &) = delete;
+  void operator=(const SessionStore &) = delete;
+
+  ~SessionStore()
+  {
+    if (Ok())
+      ::munmap(_map, _size);
+  }
+
+  /// File has been mapped
+  bool Ok() const { return _slots != nullptr; }
+
+  /// Number of slots
+  std::uint64_t Size() const { return _count; }
+
+  /// @brief Slot of a game, in the mapped file
+  ///
+  /// A slot that has never been written is all zeros; it is not a valid
+  /// game. Write a new game into it with Game::Save first.
+  Game::Packed &operator[](std::uint64_t slot) { return _slots[slot]; }
+  const Game::Packed &operator[](std::uint64_t slot) const
+  {
+    return _slots[slot];
+  }
+
+  /// @brief Start writing changed pages to the file, without waiting
+  void Flush() { ::msync(_map, _size, MS_ASYNC); }
+
+  /// @brief Bytes of the file that are in memory now
+  std::size_t Resident() const
+  {
+    auto page{static_cast<std::size_t>(::sysconf(_SC_PAGESIZE))};
+    std::vector<unsigned char> pages((_size + page - 1) / page);
+    if (!Ok() || ::mincore(_map, _size, pages.data()) < 0)
+      return 0;
+    std::size_t resident{0};
+    for (auto p : pages)
+      resident += p & 1;
+    return resident * page;
+  }
+
+private:
+  void *_map{nullptr};
+  std::size_t _size{0};
+  Game::Packed *_slots{nullptr};
+  std::uint64_t _count{0};
+
+  void Map(int fd, std::uint64_t slots)
+  {
+    struct stat st;
+    if (::fstat(fd, &st) < 0)
+      return;
+
+    StoreHeader header;
+    if (st.st_size != 0)
+    {
+      if (::pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+          header._magic != StoreHeader::Magic ||
+          header._version != StoreHeader::Version ||
+          header._slotSize != sizeof(Game::Packed))
+        return;
+      // a truncated store would map slots past the end of the file, touching
+      // them raises SIGBUS
+      if (header._slots > (static_cast<std::uint64_t>(st.st_size) -
+                           sizeof(header)) / sizeof(Game::Packed))
+        return;
+    }
+    if (header._slots < slots)
+    {
+      // new slots are holes in the file, they read as zeros
+      header._slots = slots;
+      if (::ftruncate(fd, sizeof(header) + slots * sizeof(Game::Packed)) < 0 ||
+          ::pwrite(fd, &header, sizeof(header), 0) != sizeof(header))
+        return;
+    }
+
+    std::size_t size{sizeof(header) + header._slots * sizeof(Game::Packed)};
+    void *map{
+        ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)};
+    if (map == MAP_FAILED)
+      return;
+    // sessions come back in no particular order, read-ahead only brings
+    // in pages nobody asked for
+    ::madvise(map, size, MADV_RANDOM);
+
+    _map   = map;
+    _size  = size;
+    _count = header._slots;
+    _slots = reinterpret_cast<Game::Packed *>(static_cast<char *>(map) +
+                                              sizeof(header));
+  }
+};
+
+} // namespace Tetris
+
+#endif //__TETRIS_SESSION_STORE_H__
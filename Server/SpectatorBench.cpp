@@ -0,0 +1,248 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Many spectators of one game in a single process
+///
+/// One thread plays a random game as fast as it can and publishes every
+/// tick to a SpectatorBroadcast. Reader threads poll thousands of
+/// spectators; a share of them polls only now and then, so they read
+/// deltas in batches or fall behind the ring. The harness reports what
+/// the broadcast costs the game's thread, with and without readers, how
+/// the readers caught up and checks their final views against the game.
+///
+/// Ticks are paced in bursts to a given rate, so that on a machine with
+/// fewer cores than threads the readers get a share of the time too; the
+/// cost is measured in CPU time of the game's thread between the sleeps.
+///
+/// Usage: SpectatorBench [spectators] [ticks] [reader threads] [slow %]
+///                       [ticks/s, 0 is as fast as possible]
+
+#include "Broadcast.h"
+#include "Random.h"
+#include "TetrisGame.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using namespace Tetris;
+
+/// CPU time of the calling thread, other threads do not count
+double ThreadNs()
+{
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/// @brief Play random commands
+/// @param rate - ticks per second, 0 is as fast as possible
+/// @param publish - called after every tick, with true after a reset
+/// @returns CPU nanoseconds per tick
+template <typename F>
+double Play(Game &game, std::int32_t ticks, std::int32_t rate, F &&publish)
+{
+  constexpr std::int32_t Burst{64};
+  Random rng{2019};
+  std::uint32_t seed{1};
+  auto next{std::chrono::steady_clock::now()};
+  auto burst{rate ? std::chrono::nanoseconds{std::chrono::seconds{Burst}} /
+                        rate
+                  : std::chrono::nanoseconds{0}};
+  double ns{0};
+  auto start{ThreadNs()};
+  for (std::int32_t t{0}; t < ticks; t++)
+  {
+    if (rate && t % Burst == 0)
+    {
+      ns += ThreadNs() - start;
+      next += burst;
+      std::this_thread::sleep_until(next);
+      start = ThreadNs();
+    }
+    if (game.Over())
+    {
+      game.Reset(seed++);
+      publish(true);
+      continue;
+    }
+    game.Input(static_cast<Command>(
+        rng.Below(static_cast<std::int32_t>(Command::TranslateDown) + 1)));
+    game.Tick();
+    publish(false);
+  }
+  return (ns + ThreadNs() - start) / ticks;
+}
+
+/// A spectator and what it went through
+struct Spectator
+{
+  SpectatorBroadcast::Reader _reader;
+  SpectatorView _view{};
+  /// Polls once in this many rounds
+  std::uint32_t _every;
+  std::uint64_t _polls{0};
+  std::uint64_t _deltas{0};
+  std::uint64_t _batches{0};
+  std::uint64_t _resyncs{0};
+  std::uint64_t _skipped{0};
+
+  void Poll()
+  {
+    auto before{_view._seq};
+    _polls++;
+    if (!_reader.Poll(_view))
+      return;
+    auto read{_view._seq - before - _view._skipped};
+    _deltas += read;
+    _batches += read > 1;
+    _resyncs += _view._skipped > 0;
+    _skipped += _view._skipped;
+  }
+};
+
+/// Spectators polled by one thread
+struct alignas(64) Readers
+{
+  std::vector<Spectator> _spectators;
+};
+
+/// @returns true if the view shows the game
+bool Matches(const SpectatorView &view, const Game &game)
+{
+  auto landed{game.Landed()};
+  for (std::int32_t r{0}; r < TetrisScreen::Depth(); r++)
+    if (view._rows[r] != LineMask(landed.Lines()[r]))
+      return false;
+  return view._synced && view._figure == game.Current().Kind() &&
+         view._rotation == game.Current()->Rotation() &&
+         view._row == game.Current()->Pos()._row &&
+         view._col == game.Current()->Pos()._col &&
+         view._lines == game.Lines() && view._over == game.Over();
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  std::uint32_t spectators{
+      argc > 1 ? static_cast<std::uint32_t>(std::atoi(argv[1])) : 4000};
+  std::int32_t ticks{argc > 2 ? std::atoi(argv[2]) : 600000};
+  std::uint32_t threads{
+      argc > 3 ? static_cast<std::uint32_t>(std::atoi(argv[3])) : 2};
+  std::int32_t slow{argc > 4 ? std::atoi(argv[4]) : 10};
+  std::int32_t rate{argc > 5 ? std::atoi(argv[5]) : 200000};
+  threads = std::max(1u, threads);
+
+  double plain{0}, alone{0}, watched{0};
+  {
+    Game game{1};
+    plain = Play(game, ticks, rate, [](bool) {});
+  }
+  {
+    Game game{1};
+    SpectatorBroadcast broadcast;
+    alone = Play(game, ticks, rate,
+                 [&](bool reset) { broadcast.Publish(game, reset); });
+  }
+
+  Game game{1};
+  SpectatorBroadcast broadcast;
+  broadcast.Publish(game, true);
+
+  Random rng{7};
+  std::vector<Readers> readers(threads);
+  for (std::uint32_t i{0}; i < spectators; i++)
+  {
+    auto every{rng.Below(100) < slow ? 16u + rng.Below(1024) : 1u};
+    readers[i % threads]._spectators.push_back(
+        Spectator{broadcast.Attach(), {}, static_cast<std::uint32_t>(every)});
+  }
+
+  std::atomic<bool> done{false};
+  std::vector<std::thread> pool;
+  for (auto &r : readers)
+    pool.emplace_back([&done, &r] {
+      for (std::uint32_t round{0}; !done.load(std::memory_order_acquire);
+           round++)
+        for (auto &s : r._spectators)
+          if (round % s._every == 0)
+            s.Poll();
+      // catch up with the end of the game
+      for (auto &s : r._spectators)
+        s.Poll();
+    });
+  watched = Play(game, ticks, rate,
+                 [&](bool reset) { broadcast.Publish(game, reset); });
+  done.store(true, std::memory_order_release);
+  for (auto &t : pool)
+    t.join();
+
+  Spectator total{broadcast.Attach(), {}, 0};
+  std::uint32_t wrong{0};
+  for (const auto &r : readers)
+    for (const auto &s : r._spectators)
+    {
+      total._polls += s._polls;
+      total._deltas += s._deltas;
+      total._batches += s._batches;
+      total._resyncs += s._resyncs;
+      total._skipped += s._skipped;
+      wrong += !Matches(s._view, game);
+    }
+
+  std::printf("%u spectators on %u threads, %d ticks at %d/s, %d%% slow\n",
+              spectators, threads, ticks, rate, slow);
+  std::printf("  delta %zu bytes, keyframe every %llu deltas\n",
+              sizeof(SpectatorDelta),
+              static_cast<unsigned long long>(
+                  SpectatorBroadcast::KeyframeInterval));
+  std::printf("  game thread: %.1f ns/tick plain, %.1f with broadcast, "
+              "%.1f with spectators\n",
+              plain, alone, watched);
+  std::printf("  broadcast overhead: %.1f ns/tick, %.1f ns with spectators\n",
+              alone - plain, watched - plain);
+  std::printf("  polls %llu, deltas read %llu, polls reading a batch %llu\n",
+              static_cast<unsigned long long>(total._polls),
+              static_cast<unsigned long long>(total._deltas),
+              static_cast<unsigned long long>(total._batches));
+  std::printf("  jumps to a keyframe %llu, deltas coalesced %llu\n",
+              static_cast<unsigned long long>(total._resyncs),
+              static_cast<unsigned long long>(total._skipped));
+  std::printf("  views different from the game: %u\n", wrong);
+  return wrong == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,193 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Hibernating idle games in a mapped store and resuming them
+///
+/// Fills a SessionStore with games that have been played a little, then
+/// brings random ones back: in place, as Restore, a command and Save on
+/// the slot, and as a ResumeGame session on a SessionExecutor, from the
+/// spawn to the frame that answers the command. The harness reports
+/// the size of the store, how much of it is resident and the latencies.
+///
+/// Usage: StoreBench [games] [store file] [resumes]
+
+#include "GameSession.h"
+#include "Random.h"
+#include "SessionExecutor.h"
+#include "SessionStore.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+/// Resident set of the process in bytes
+std::size_t ResidentSet()
+{
+  unsigned long size{0}, resident{0};
+  if (auto *f{std::fopen("/proc/self/statm", "r")})
+  {
+    if (std::fscanf(f, "%lu %lu", &size, &resident) != 2)
+      resident = 0;
+    std::fclose(f);
+  }
+  return resident * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+/// A few random commands, as a player that has left would have played
+void Play(Tetris::Game &game, Tetris::Random &rng, std::int32_t commands)
+{
+  constexpr auto Commands{
+      static_cast<std::int32_t>(Tetris::Command::TranslateDown) + 1};
+  for (std::int32_t i{0}; i < commands && !game.Over(); i++)
+  {
+    game.Input(static_cast<Tetris::Command>(rng.Below(Commands)));
+    game.Tick();
+  }
+}
+
+/// Median and 99th percentile of latencies, in microseconds
+void Report(const char *what, std::vector<Clock::duration> &latencies)
+{
+  std::sort(latencies.begin(), latencies.end());
+  auto us{[&](std::size_t i) {
+    return std::chrono::duration<double, std::micro>{latencies[i]}.count();
+  }};
+  std::printf("  %s: %.2f us median, %.2f us p99\n", what,
+              us(latencies.size() / 2), us(latencies.size() * 99 / 100));
+}
+
+double Megabytes(std::size_t bytes) { return bytes / (1024.0 * 1024.0); }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  using namespace Tetris;
+
+  std::uint64_t games{argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000};
+  const char *path{argc > 2 ? argv[2] : "sessions.store"};
+  std::uint32_t resumes{argc > 3 ? static_cast<std::uint32_t>(std::atoi(argv[3]))
+                                 : 10000};
+
+  SessionStore store{path, games};
+  if (!store.Ok() || games == 0 || resumes == 0)
+    return EXIT_FAILURE;
+
+  // every game goes through one Game object straight into its slot
+  Random rng{2019};
+  Game game{0};
+  auto start{Clock::now()};
+  for (std::uint64_t slot{0}; slot < games; slot++)
+  {
+    game.Reset(static_cast<std::uint32_t>(slot));
+    Play(game, rng, 20);
+    game.Save(store[slot]);
+  }
+  std::chrono::duration<double, std::nano> fill{Clock::now() - start};
+
+  // a game written back unchanged gives the same record
+  std::uint64_t mismatches{0};
+  for (std::uint64_t slot{0}; slot < std::min<std::uint64_t>(games, 1000);
+       slot++)
+  {
+    Game::Packed again;
+    mismatches += !game.Restore(store[slot]);
+    game.Save(again);
+    mismatches += std::memcmp(&again, &store[slot], sizeof(again)) != 0;
+  }
+
+  std::printf("%llu games in %s, %zu bytes each\n",
+              static_cast<unsigned long long>(games), path,
+              sizeof(Game::Packed));
+  std::printf("  hibernate: %.0f ns per game\n", fill.count() / games);
+  auto bytes{sizeof(StoreHeader) + store.Size() * sizeof(Game::Packed)};
+  std::printf("  store %.1f MB, %.1f MB of it resident, process RSS %.1f MB\n",
+              Megabytes(bytes), Megabytes(store.Resident()),
+              Megabytes(ResidentSet()));
+  std::printf("  records that changed on a round trip: %llu\n",
+              static_cast<unsigned long long>(mismatches));
+
+  // in place: the game comes out of its slot, plays and goes back
+  std::vector<Clock::duration> latencies(resumes);
+  for (auto &l : latencies)
+  {
+    auto slot{static_cast<std::uint64_t>(rng()) % games};
+    auto t{Clock::now()};
+    game.Restore(store[slot]);
+    game.Input(Command::TranslateDown);
+    game.Tick();
+    game.Save(store[slot]);
+    l = Clock::now() - t;
+  }
+  Report("resume in place", latencies);
+
+  // on demand: a session starts from the slot, answers a command and
+  // hibernates again when closed
+  std::atomic<std::uint32_t> frames{0};
+  {
+    SessionExecutor executor{1, [&](const SessionFrame &, std::uint32_t) {
+                               frames.fetch_add(1, std::memory_order_release);
+                             }};
+    std::uint16_t seq{0};
+    for (auto &l : latencies)
+    {
+      auto slot{static_cast<std::uint32_t>(rng() % games)};
+      auto t{Clock::now()};
+      auto expected{frames.load() + 2};
+      auto ref{executor.Spawn(ResumeGame(store[slot]), slot)};
+      auto cmd{static_cast<std::uint8_t>(Command::RotateRight)};
+      ref.Post(Wire::CommandPacket{++seq, cmd, 0});
+      // the first frame is the whole screen, the second answers the command
+      while (frames.load(std::memory_order_acquire) < expected)
+        std::this_thread::yield();
+      l = Clock::now() - t;
+      ref.Close();
+    }
+    while (executor.Statistics(0)._sessions != 0)
+      std::this_thread::yield();
+  }
+  Report("resume as a session", latencies);
+
+  store.Flush();
+  std::printf("  after resumes: %.1f MB of the store resident, process RSS "
+              "%.1f MB\n",
+              Megabytes(store.Resident()), Megabytes(ResidentSet()));
+  return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,134 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Perfect clear puzzles solved in parallel
+///
+/// Each puzzle is an empty board and a random sequence of figures. The
+/// solver looks for the fewest figures of the sequence that clear the
+/// board again. The harness reports how long the puzzles take.
+///
+/// First it checks boards with a well at the left or right wall that a
+/// single vertical figure clears; every column must be reachable.
+///
+/// Usage: PerfectClear [figures per puzzle] [puzzles] [threads] [figures]
+///   figures - classic or tetrominoes
+
+#include "Random.h"
+#include "Solver.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using namespace Tetris;
+
+/// @brief Solve a board with a one column well by a single figure
+/// @param kind - vertical figure as high as the well
+/// @param height - rows of the well at the bottom of the screen
+/// @param col - column of the well
+/// @param rotation - kicks tried when the figure rotates
+/// @returns true if the figure is the solution
+bool WellCleared(std::uint8_t kind, std::int32_t height, ColumnIdx col,
+                 RotationSystem rotation)
+{
+  TetrisScreen board;
+  for (auto r{TetrisScreen::Depth() - height}; r < TetrisScreen::Depth(); r++)
+    for (std::int32_t c{0}; c < TetrisScreen::Width(); c++)
+      if (c != col)
+        board[Position{r, c}] = Colour::red;
+
+  PerfectClearSolver solver{1};
+  std::uint8_t figures[]{kind};
+  auto s{solver.Solve(board, figures, rotation)};
+  auto ok{s._status == SolveStatus::solved && s._placements.size() == 1};
+  std::printf("well in column %d, figure %d: %s\n", col, kind,
+              ok ? "cleared" : "FAILED");
+  return ok;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  bool wells{true};
+  for (ColumnIdx col : {0, TetrisScreen::Width() - 1})
+  {
+    wells = WellCleared(1, 3, col, RotationSystem::none) && wells;
+    wells = WellCleared(4, 4, col, RotationSystem::srs) && wells;
+  }
+
+  std::int32_t length{argc > 1 ? std::atoi(argv[1]) : 8};
+  std::int32_t puzzles{argc > 2 ? std::atoi(argv[2]) : 100};
+  std::int32_t threads{argc > 3 ? std::atoi(argv[3])
+                                : static_cast<std::int32_t>(std::max(
+                                      1u, std::thread::hardware_concurrency()))};
+  bool tetrominoes{argc > 4 && std::string_view{argv[4]} == "tetrominoes"};
+  auto rotation{tetrominoes ? RotationSystem::srs : RotationSystem::none};
+
+  PerfectClearSolver solver{threads};
+  std::int32_t counts[3]{};
+  std::int64_t nodes{0};
+  double totalMs{0}, maxMs{0};
+  for (std::int32_t p{0}; p < puzzles; p++)
+  {
+    Random rng{static_cast<std::uint32_t>(p + 1)};
+    std::vector<std::uint8_t> figures(length);
+    for (auto &f : figures)
+      f = tetrominoes ? Tetrominoes[rng.Below(Tetrominoes.size())]
+                      : ClassicFigures[rng.Below(ClassicFigures.size())];
+
+    auto start{std::chrono::steady_clock::now()};
+    auto s{solver.Solve(TetrisScreen{}, figures, rotation,
+                        std::chrono::seconds{1})};
+    std::chrono::duration<double, std::milli> ms{
+        std::chrono::steady_clock::now() - start};
+
+    counts[static_cast<std::int32_t>(s._status)]++;
+    nodes += s._nodes;
+    totalMs += ms.count();
+    maxMs = std::max(maxMs, ms.count());
+    if (s._status == SolveStatus::solved)
+      std::printf("puzzle %d: %zu figures, %zu commands, %.3f ms\n", p + 1,
+                  s._placements.size(), s._commands.size(), ms.count());
+  }
+
+  std::printf("%d puzzles of %d figures, %d threads: solved %d, unsolvable "
+              "%d, cancelled %d\n",
+              puzzles, length, threads, counts[0], counts[1], counts[2]);
+  std::printf("time avg %.3f ms, max %.3f ms, %.0f boards per puzzle\n",
+              totalMs / puzzles, maxMs, static_cast<double>(nodes) / puzzles);
+  return wells ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,148 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Auto repeat of held keys
+
+#ifndef __TETRIS_AUTO_REPEAT_H__
+#define __TETRIS_AUTO_REPEAT_H__
+
+#include "Command.h"
+#include <algorithm>
+#include <chrono>
+
+namespace Tetris
+{
+/// @brief Delayed auto shift (DAS) and auto repeat rate (ARR)
+///
+/// A pressed key gives its command at once. When the key is held, after
+/// `_das` the command repeats every `_arr`. Only moves repeat; rotations
+/// are given once per press.
+///
+/// A terminal does not report key releases. Holding a key is recognised
+/// by the keyboard's own repeats of that key: the first one comes after
+/// the keyboard's repeat delay (not earlier than `_firstRepeat`), then
+/// every keyboard repeat interval. Key is released when its repeats stop
+/// for `_release`. Hence, with a terminal, the effective DAS is not
+/// shorter than the keyboard's repeat delay; the repeat rate is ARR,
+/// independent of the keyboard.
+struct AutoRepeatTiming
+{
+  std::chrono::microseconds _das{std::chrono::milliseconds{170}};
+  std::chrono::microseconds _arr{std::chrono::milliseconds{50}};
+  /// Faster second press of a key is a new press, not a keyboard repeat
+  std::chrono::microseconds _firstRepeat{std::chrono::milliseconds{200}};
+  /// Longest keyboard repeat delay still taken as a held key
+  std::chrono::microseconds _lastFirstRepeat{std::chrono::milliseconds{750}};
+  /// Time without repeats after which a held key is released
+  std::chrono::microseconds _release{std::chrono::milliseconds{100}};
+};
+
+/// @brief Turns key presses into commands with auto repeat
+class AutoRepeat
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit AutoRepeat(AutoRepeatTiming timing = {})
+      : _timing{timing}
+  {
+  }
+
+  /// @brief Key of a command has been seen
+  /// @param cmd - command of the key
+  /// @param t - time the key was read
+  /// @returns command to execute, Idle for a keyboard repeat
+  Command Press(Command cmd, Clock::time_point t)
+  {
+    auto sincePress{t - _pressed};
+    bool repeat{cmd == _cmd &&
+                (_held ? t - _lastSeen <= _timing._release
+                       : sincePress >= _timing._firstRepeat &&
+                             sincePress <= _timing._lastFirstRepeat)};
+    _lastSeen = t;
+    if (repeat)
+    {
+      if (!_held)
+      {
+        _held       = true;
+        _nextRepeat = std::max(_pressed + _timing._das, t);
+      }
+      return Command::Idle;
+    }
+
+    _cmd     = cmd;
+    _pressed = t;
+    _held    = false;
+    return cmd;
+  }
+
+  /// @brief Command repeated by a held key
+  ///
+  /// Call it until it returns Idle. Each call gives at most one command.
+  ///
+  /// @param now - present time
+  Command Step(Clock::time_point now)
+  {
+    if (!_held)
+      return Command::Idle;
+    if (now - _lastSeen > _timing._release)
+    {
+      _held = false;
+      _cmd  = Command::Idle;
+      return Command::Idle;
+    }
+    if (!Repeats(_cmd) || now < _nextRepeat)
+      return Command::Idle;
+
+    _nextRepeat += _timing._arr;
+    return _cmd;
+  }
+
+  /// Commands that repeat when a key is held
+  static bool Repeats(Command cmd)
+  {
+    return cmd == Command::TranslateLeft || cmd == Command::TranslateRigth ||
+           cmd == Command::TranslateDown;
+  }
+
+private:
+  AutoRepeatTiming _timing;
+  Command _cmd{Command::Idle};
+  bool _held{false};
+  Clock::time_point _pressed{};
+  Clock::time_point _lastSeen{};
+  Clock::time_point _nextRepeat{};
+};
+
+} // namespace Tetris
+
+#endif //__TETRIS_AUTO_REPEAT_H__
@@ -0,0 +1,335 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Features of a board used by bots to score placements
+
+#ifndef __TETRIS_BOARD_FEATURES_H__
+#define __TETRIS_BOARD_FEATURES_H__
+
+#include "ScreenDef.h"
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#if !defined(TETRIS_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define TETRIS_FEATURES_AVX2
+#elif !defined(TETRIS_NO_SIMD) &&                                             \
+    (defined(__SSE2__) || defined(_M_X64) ||                                   \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define TETRIS_FEATURES_SSE2
+#endif
+
+namespace Tetris
+{
+/// @brief Standard heuristic features of a board
+struct BoardFeatures
+{
+  /// Sum of heights of all columns
+  std::int32_t _aggregateHeight;
+  /// Empty blocks with a non-empty block above in the same column
+  std::int32_t _holes;
+  /// Sum of height differences of neighbouring columns
+  std::int32_t _bumpiness;
+  /// Changes between empty and non-empty blocks along lines. Walls count
+  /// as non-empty.
+  std::int32_t _rowTransitions;
+  /// Changes between empty and non-empty blocks along columns. The floor
+  /// counts as non-empty.
+  std::int32_t _columnTransitions;
+  /// Well sums: empty blocks with both neighbours non-empty, weighted
+  /// 1, 2, 3... by how deep they are in a run of such blocks in a column
+  std::int32_t _wells;
+};
+
+/// @brief Portable lanes: a line of a single board in a 64 bit word
+///
+/// Line of TetrisScreen is 8 blocks. Each block is a byte, so a line fits
+/// a 64 bit word and byte operations on the word handle all columns at
+/// once. Counters stay small enough not to carry into a neighbour byte.
+struct ScalarLanes
+{
+  using Vector = std::uint64_t;
+  static constexpr std::size_t Boards{1};
+
+  static Vector Bytes(std::uint8_t b) { return 0x0101010101010101ull * b; }
+  static Vector Word(std::uint64_t w) { return w; }
+
+  /// Non-empty blocks of line `row` as 0xFF bytes
+  static Vector Occupied(const TetrisScreen *const *boards, RowIdx row)
+  {
+    Vector v;
+    std::memcpy(&v, boards[0]->Lines()[row].data(), sizeof(v));
+    // top bit of each byte is set when any bit of the byte is set
+    auto nonZero{(((v & Bytes(0x7F)) + Bytes(0x7F)) | v) & Bytes(0x80)};
+    return (nonZero >> 7) * 0xFF;
+  }
+
+  static Vector And(Vector a, Vector b) { return a & b; }
+  static Vector Or(Vector a, Vector b) { return a | b; }
+  static Vector Xor(Vector a, Vector b) { return a ^ b; }
+  /// `~a & b`
+  static Vector AndNot(Vector a, Vector b) { return ~a & b; }
+  static Vector Add(Vector a, Vector b) { return a + b; }
+  /// Byte of column c gets the byte of column c - 1; column 0 gets zero
+  static Vector NextColumn(Vector a) { return a << 8; }
+  /// Byte of column c gets the byte of column c + 1; last column gets zero
+  static Vector PrevColumn(Vector a) { return a >> 8; }
+
+  static Vector AbsDiff(Vector a, Vector b)
+  {
+    Vector d{0};
+    for (std::uint32_t i{0}; i < 64; i += 8)
+    {
+      auto x{static_cast<std::int32_t>((a >> i) & 0xFF)};
+      auto y{static_cast<std::int32_t>((b >> i) & 0xFF)};
+      d |= static_cast<Vector>(x > y ? x - y : y - x) << i;
+    }
+    return d;
+  }
+
+  /// Sum of bytes of each board
+  static void Sum(Vector a, std::int32_t *sums)
+  {
+    constexpr std::uint64_t even{0x00FF00FF00FF00FFull};
+    auto pairs{(a & even) + ((a >> 8) & even)};
+    sums[0] = static_cast<std::int32_t>((pairs * 0x0001000100010001ull) >> 48);
+  }
+};
+
+#ifdef TETRIS_FEATURES_SSE2
+/// @brief SSE2 lanes: a line of two boards
+struct Sse2Lanes
+{
+  using Vector = __m128i;
+  static constexpr std::size_t Boards{2};
+
+  static Vector Bytes(std::uint8_t b)
+  {
+    return _mm_set1_epi8(static_cast<char>(b));
+  }
+  static Vector Word(std::uint64_t w)
+  {
+    return _mm_set1_epi64x(static_cast<long long>(w));
+  }
+
+  static Vector Occupied(const TetrisScreen *const *boards, RowIdx row)
+  {
+    std::uint64_t lines[Boards];
+    for (std::size_t i{0}; i < Boards; i++)
+      std::memcpy(&lines[i], boards[i]->Lines()[row].data(), sizeof(lines[i]));
+    auto v{_mm_loadu_si128(reinterpret_cast<const __m128i *>(lines))};
+    auto empty{_mm_cmpeq_epi8(v, _mm_setzero_si128())};
+    return _mm_xor_si128(empty, _mm_set1_epi8(-1));
+  }
+
+  static Vector And(Vector a, Vector b) { return _mm_and_si128(a, b); }
+  static Vector Or(Vector a, Vector b) { return _mm_or_si128(a, b); }
+  static Vector Xor(Vector a, Vector b) { return _mm_xor_si128(a, b); }
+  static Vector AndNot(Vector a, Vector b) { return _mm_andnot_si128(a, b); }
+  static Vector Add(Vector a, Vector b) { return _mm_add_epi8(a, b); }
+  static Vector NextColumn(Vector a) { return _mm_slli_epi64(a, 8); }
+  static Vector PrevColumn(Vector a) { return _mm_srli_epi64(a, 8); }
+  static Vector AbsDiff(Vector a, Vector b)
+  {
+    return _mm_sub_epi8(_mm_max_epu8(a, b), _mm_min_epu8(a, b));
+  }
+
+  static void Sum(Vector a, std::int32_t *sums)
+  {
+    std::uint64_t s[Boards];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(s),
+                     _mm_sad_epu8(a, _mm_setzero_si128()));
+    for (std::size_t i{0}; i < Boards; i++)
+      sums[i] = static_cast<std::int32_t>(s[i]);
+  }
+};
+#endif
+
+#ifdef TETRIS_FEATURES_AVX2
+/// @brief AVX2 lanes: a line of four boards
+struct Avx2Lanes
+{
+  using Vector = __m256i;
+  static constexpr std::size_t Boards{4};
+
+  static Vector Bytes(std::uint8_t b)
+  {
+    return _mm256_set1_epi8(static_cast<char>(b));
+  }
+  static Vector Word(std::uint64_t w)
+  {
+    return _mm256_set1_epi64x(static_cast<long long>(w));
+  }
+
+  static Vector Occupied(const TetrisScreen *const *boards, RowIdx row)
+  {
+    std::uint64_t lines[Boards];
+    for (std::size_t i{0}; i < Boards; i++)
+      std::memcpy(&lines[i], boards[i]->Lines()[row].data(), sizeof(lines[i]));
+    auto v{_mm256_loadu_si256(reinterpret_cast<const __m256i *>(lines))};
+    auto empty{_mm256_cmpeq_epi8(v, _mm256_setzero_si256())};
+    return _mm256_xor_si256(empty, _mm256_set1_epi8(-1));
+  }
+
+  static Vector And(Vector a, Vector b) { return _mm256_and_si256(a, b); }
+  static Vector Or(Vector a, Vector b) { return _mm256_or_si256(a, b); }
+  static Vector Xor(Vector a, Vector b) { return _mm256_xor_si256(a, b); }
+  static Vector AndNot(Vector a, Vector b)
+  {
+    return _mm256_andnot_si256(a, b);
+  }
+  static Vector Add(Vector a, Vector b) { return _mm256_add_epi8(a, b); }
+  static Vector NextColumn(Vector a) { return _mm256_slli_epi64(a, 8); }
+  static Vector PrevColumn(Vector a) { return _mm256_srli_epi64(a, 8); }
+  static Vector AbsDiff(Vector a, Vector b)
+  {
+    return _mm256_sub_epi8(_mm256_max_epu8(a, b), _mm256_min_epu8(a, b));
+  }
+
+  static void Sum(Vector a, std::int32_t *sums)
+  {
+    std::uint64_t s[Boards];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(s),
+                        _mm256_sad_epu8(a, _mm256_setzero_si256()));
+    for (std::size_t i{0}; i < Boards; i++)
+      sums[i] = static_cast<std::int32_t>(s[i]);
+  }
+};
+#endif
+
+/// @brief Compute features of `Lanes::Boards` boards in a single pass
+///
+/// Lines are visited from the top. Each column's byte keeps its counters,
+/// so all columns of all boards in the vector are processed at once.
+/// Byte sums of each board are taken at the end.
+///
+/// @tparam Lanes - ScalarLanes, Sse2Lanes or Avx2Lanes
+/// @param boards - `Lanes::Boards` boards
+/// @param out - `Lanes::Boards` results
+template <class Lanes>
+void ExtractFeatures(const TetrisScreen *const *boards, BoardFeatures *out)
+{
+  static_assert(TetrisScreen::Width() == 8,
+                "a line of blocks must fill a 64 bit lane");
+  using L = Lanes;
+  using V = typename Lanes::Vector;
+
+  const V ones{L::Bytes(1)};
+  // walls on both sides count as non-empty blocks
+  const V leftWall{L::Word(0x00000000000000FFull)};
+  const V rightWall{L::Word(0xFF00000000000000ull)};
+
+  V zero{L::Bytes(0)};
+  V seen{zero}, prev{zero}, run{zero};
+  V heights{zero}, holes{zero}, rowTrans{zero}, colTrans{zero}, wells{zero};
+  for (RowIdx r{0}; r < TetrisScreen::Depth(); r++)
+  {
+    V line{L::Occupied(boards, r)};
+    V left{L::Or(L::NextColumn(line), leftWall)};
+    V right{L::Or(L::PrevColumn(line), rightWall)};
+
+    rowTrans = L::Add(rowTrans, L::And(L::Xor(line, left), ones));
+    rowTrans = L::Add(rowTrans, L::And(L::AndNot(line, rightWall), ones));
+    if (r > 0)
+      colTrans = L::Add(colTrans, L::And(L::Xor(line, prev), ones));
+
+    holes   = L::Add(holes, L::And(L::AndNot(line, seen), ones));
+    seen    = L::Or(seen, line);
+    heights = L::Add(heights, L::And(seen, ones));
+
+    V well{L::AndNot(line, L::And(left, right))};
+    run   = L::And(L::Add(run, ones), well);
+    wells = L::Add(wells, run);
+    prev  = line;
+  }
+  colTrans = L::Add(colTrans, L::AndNot(prev, ones));
+  V bumps{L::AndNot(rightWall,
+                    L::AbsDiff(heights, L::PrevColumn(heights)))};
+
+  std::int32_t sums[6][L::Boards];
+  L::Sum(heights, sums[0]);
+  L::Sum(holes, sums[1]);
+  L::Sum(bumps, sums[2]);
+  L::Sum(rowTrans, sums[3]);
+  L::Sum(colTrans, sums[4]);
+  L::Sum(wells, sums[5]);
+  for (std::size_t i{0}; i < L::Boards; i++)
+    out[i] = BoardFeatures{sums[0][i], sums[1][i], sums[2][i],
+                           sums[3][i], sums[4][i], sums[5][i]};
+}
+
+/// Widest lanes the build supports
+#if defined(TETRIS_FEATURES_AVX2)
+using FeatureLanes = Avx2Lanes;
+#elif defined(TETRIS_FEATURES_SSE2)
+using FeatureLanes = Sse2Lanes;
+#else
+using FeatureLanes = ScalarLanes;
+#endif
+
+/// @brief Features of a single board
+inline BoardFeatures ExtractFeatures(const TetrisScreen &board)
+{
+  const TetrisScreen *boards[]{&board};
+  BoardFeatures f;
+  ExtractFeatures<ScalarLanes>(boards, &f);
+  return f;
+}
+
+/// @brief Features of many candidate boards
+///
+/// Boards are processed in groups as wide as the widest supported
+/// vector; the remaining ones one by one.
+///
+/// @param boards - boards to evaluate
+/// @param out - features of each board, at least as many as boards
+inline void ExtractFeatures(std::span<const TetrisScreen> boards,
+                           std::span<BoardFeatures> out)
+{
+  constexpr auto Width{FeatureLanes::Boards};
+  const TetrisScreen *group[Width];
+  auto full{boards.size() / Width};
+  for (std::size_t g{0}; g < full; g++)
+  {
+    for (std::size_t j{0}; j < Width; j++)
+      group[j] = &boards[g * Width + j];
+    ExtractFeatures<FeatureLanes>(group, &out[g * Width]);
+  }
+  for (auto i{full * Width}; i < boards.size(); i++)
+    out[i] = ExtractFeatures(boards[i]);
+}
+
+} // namespace Tetris
+
+#endif //__TETRIS_BOARD_FEATURES_H__
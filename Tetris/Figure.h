@@ -36,6 +36,7 @@
 #define __TETRIS_FIGURE_H__
 
 #include "Block.h"
+#include "RotationSystem.h"
 #include "ScreenDef.h"
 #include <array>
 #include <cstdint>
@@ -68,18 +69,30 @@ public:
   virtual std::int32_t BlocksCount() const = 0;
   /// Position of a figure
   virtual Position Pos() const             = 0;
+  /// Index of the figure's rotation, 0 as created
+  virtual std::int32_t Rotation() const    = 0;
 
   /// Move the figure
   ///
   /// @returns false if there is a colision and the figure cannot be translated
   virtual bool Translate(TetrisScreen &, Position direction) { return true; };
-  /// Rotate the figure
+  /// Rotate the figure, trying kicks of the rotation system
   /// @returns false if there is a colision and the figure cannot be rotated
-  virtual bool Rotate(TetrisScreen &, Direction) { return true; }
+  virtual bool Rotate(TetrisScreen &, Direction, RotationSystem)
+  {
+    return true;
+  }
+  /// Move the figure down as far as it can go
+  /// @returns number of lines the figure has moved by
+  virtual std::int32_t Fall(const TetrisScreen &) = 0;
   /// Draw or clear the figure
   virtual void Draw(TetrisScreen &, DrawMode) = 0;
 
-  virtual ~Figure() {}
+protected:
+  /// Figures are held by value and never deleted through this interface.
+  /// Without a virtual destructor there is no deleting destructor, so the
+  /// figures do not refer to operator delete.
+  ~Figure() = default;
 };
 
 } // namespace Tetris
@@ -38,296 +38,323 @@
 #include "Block.h"
 #include "Figure.h"
 #include "ScreenDef.h"
+#include "Shape.h"
 #include <array>
 #include <cstdint>
+#include <utility>
+#include <variant>
 
 namespace Tetris
 {
-/// @brief Draw blocks on a screen
+/// @brief Rows of a screen as bit masks, for fast colision tests
 ///
-/// @tparam BlocksArray - array type
-/// @param blocks - array of blocks to draw
-/// @param screen - screen with the game; blocks will be drawn on it
-/// @param mode - drawing mode
-template <class BlocksArray>
-void Draw(BlocksArray &blocks, TetrisScreen &screen, DrawMode mode)
+/// Bit Guard + N is column N. Columns outside the screen and rows
+/// outside the screen are filled, so walls and the floor collide the same
+/// way as blocks.
+///
+/// @tparam Rows - number of rows read
+template <std::int32_t Rows>
+class RowMasks
 {
-  if (mode == DrawMode::clear)
-  {
-    for (auto &block : blocks)
-      screen[block.Pos()] = Colour::background;
-  }
-  else if (mode == DrawMode::draw)
+public:
+  /// @brief Read rows first .. first + Rows - 1 of a screen
+  RowMasks(const TetrisScreen &screen, RowIdx first)
   {
-    for (auto &block : blocks)
-      screen[block.Pos()] = Colour::red;
+    constexpr std::uint32_t Inside{((1u << TetrisScreen::Width()) - 1)
+                                   << Guard};
+    for (std::int32_t i{0}; i < Rows; i++)
+    {
+      auto row{first + i};
+      _rows[i] = ~0u;
+      if (row >= 0 && row < TetrisScreen::Depth())
+        _rows[i] = ~Inside | LineMask(screen.Lines()[row]) << Guard;
+    }
   }
-}
 
-/// @brief Translate figure on a screen
-///
-/// Function checks colision with screen boundary
-/// and with other blocks already present on the screen.
-///
-/// Satisfies requirements:
-///   [REQ_MoveLimit](https://github.com/grygorek/TetrisArch#REQ_MoveLimit)
-///   [REQ_BlocksNotOverlap](https://github.com/grygorek/TetrisArch#REQ_BlocksNotOverlap)
-///
-/// @tparem FigureType - type of a figure to translate
-/// @param fig - figure to translate
-/// @param screen - screen with the game
-/// @param vec - direction of translation
-/// @retval true - figure has been translated
-/// @retval false - figure could not be translated due to colision with
-///    a different object on the screen
-template <class FigureType>
-bool Translate(FigureType &fig, TetrisScreen &screen, Position vect)
-{
-  FigureType f{fig.Pos() + vect};
-  for (const auto &b : f._blocks)
-    if (screen.Colision(b.Pos()))
-      return false;
-  fig = f;
-  return true;
-}
-
-/// @brief Rotate figure on a screen
-///
-/// Function checks colision with screen boundary
-/// and with other blocks already present on the screen.
-///
-/// Satisfies requirements:
-///   [REQ_MoveLimit](https://github.com/grygorek/TetrisArch#REQ_MoveLimit)
-///   [REQ_BlocksNotOverlap](https://github.com/grygorek/TetrisArch#REQ_BlocksNotOverlap)
-///
-/// @tparem FigureType - type of a figure to rotate
-/// @param fig - figure to rotate
-/// @param screen - screen with the game
-/// @param dir - direction of rotation
-/// @retval true - figure has been rotated
-/// @retval false - figure could not be rotated due to colision with
-///    a different object on the screen
-template <class FigureType>
-bool Rotate(FigureType &fig, TetrisScreen &screen, Direction dir)
-{
-  FigureType b{dir};
-
-  for (auto &bl : b._blocks)
+  /// @brief Shape fits the rows
+  /// @param shape - blocks of each row of the shape, bit N is column N
+  /// @param row - index of the shape's top row in these rows
+  /// @param col - screen column of the shape's left edge
+  template <std::size_t N>
+  bool Fits(const std::array<std::uint8_t, N> &shape, std::int32_t row,
+            ColumnIdx col) const
   {
-    bl = Block{bl.Pos() + fig.Pos()};
-    if (screen.Colision(bl.Pos()))
+    if (col < -Guard || Guard + col + MaxShapeBox > 32)
       return false;
+    for (std::size_t i{0}; i < N; i++)
+    {
+      if (shape[i] == 0)
+        continue;
+      auto r{row + static_cast<std::int32_t>(i)};
+      if (r < 0 || r >= Rows ||
+          (_rows[r] & std::uint32_t{shape[i]} << (Guard + col)) != 0)
+        return false;
+    }
+    return true;
   }
-  b._pos = fig.Pos();
-  fig    = b;
-  return true;
-}
 
-/// @brief Bar T figure
+private:
+  static constexpr std::int32_t Guard{8};
+  static_assert(TetrisScreen::Width() + 2 * Guard <= 32);
+
+  std::array<std::uint32_t, Rows> _rows;
+};
+
+/// @brief Figure made of a shape
+///
+/// All figures share this implementation. The figure is just a position
+/// and an index of rotation; its blocks come from the shape's tables that
+/// are computed at compile time.
 ///
 /// Satisfies requirements:
 ///   [REQ_FiguresType](https://github.com/grygorek/TetrisArch#REQ_FiguresType)
-class BarT final : public Figure
+///
+/// @tparam Art - shape of the figure, see Shape
+template <ShapeArt Art>
+class ShapeFigure final : public Figure
 {
-  friend bool Tetris::Translate<BarT>(BarT &, TetrisScreen &screen,
-                                      Position direction);
-  friend bool Tetris::Rotate<BarT>(BarT &fig, TetrisScreen &screen,
-                                   Direction dir);
-
 public:
+  using ShapeType = Shape<Art>;
+
   /// Create figure at given position
-  /// @param p - positon
-  explicit BarT(Position p)
+  /// @param p - position of the top left corner of the shape's box
+  /// @param rotation - index of the rotation, see Shape
+  explicit ShapeFigure(Position p, std::int32_t rotation = 0)
       : _pos{p}
+      , _idx{rotation % ShapeType::Rotations}
   {
-    for (auto &b : _blocks)
-      b = Block{b.Pos() + p};
   }
 
   Position Pos() const override { return _pos; }
-  std::int32_t BlocksCount() const override { return _blocks.size(); }
+  std::int32_t BlocksCount() const override { return ShapeType::Blocks; }
+
+  /// Index of the current rotation, see Shape
+  std::int32_t Rotation() const override { return _idx; }
 
   /// @brief Translate the figure on a screen in given direction
+  ///
+  /// Function checks colision with screen boundary
+  /// and with other blocks already present on the screen.
+  ///
+  /// Satisfies requirements:
+  ///   [REQ_MoveLimit](https://github.com/grygorek/TetrisArch#REQ_MoveLimit)
+  ///   [REQ_BlocksNotOverlap](https://github.com/grygorek/TetrisArch#REQ_BlocksNotOverlap)
+  ///
   /// @param screen - game screen
   /// @param direction - direction to translate
   /// @returns true on success, false on colision
   bool Translate(TetrisScreen &screen, Position direction) override
   {
-    return Tetris::Translate<BarT>(*this, screen, direction);
-  }
-
-  /// @brief Draw the figure on a screen with given mode
-  /// @param screen - game screen
-  /// @param mode - drawing mode (show or hide the figure)
-  void Draw(TetrisScreen &screen, DrawMode mode) override
-  {
-    Tetris::Draw(_blocks, screen, mode);
+    if (!Fits(screen, _pos + direction, _idx))
+      return false;
+    _pos = _pos + direction;
+    return true;
   }
 
   /// @brief Rotate the figure on a screen in given direction
+  ///
+  /// Function checks colision with screen boundary
+  /// and with other blocks already present on the screen. When the rotated
+  /// figure collides, it is moved by the kicks of the rotation system, one
+  /// after another, until it fits.
+  ///
+  /// Satisfies requirements:
+  ///   [REQ_MoveLimit](https://github.com/grygorek/TetrisArch#REQ_MoveLimit)
+  ///   [REQ_BlocksNotOverlap](https://github.com/grygorek/TetrisArch#REQ_BlocksNotOverlap)
+  ///
   /// @param screen - game screen
   /// @param dir - rotation direction
+  /// @param system - rotation system
   /// @returns true on success, false on colision
-  bool Rotate(TetrisScreen &screen, Direction dir) override
+  bool Rotate(TetrisScreen &screen, Direction dir,
+              RotationSystem system) override
   {
-    return Tetris::Rotate(*this, screen, dir);
+    auto idx{(_idx + dir + ShapeType::Rotations) % ShapeType::Rotations};
+    if (Fits(screen, _pos, idx))
+    {
+      _idx = idx;
+      return true;
+    }
+
+    const auto &kicks{KicksOf(system, ShapeType::Box)};
+    if (kicks._tests < 2)
+      return false;
+
+    // Kicks move the figure by up to two blocks each way. Rows around
+    // the figure are read once, then every kick is a few mask tests.
+    constexpr std::int32_t Reach{2};
+    RowMasks<ShapeType::Box + 2 * Reach> rows{screen, _pos._row - Reach};
+    const auto &shape{ShapeType::Table[idx]._rows};
+    const auto &tests{kicks._kicks[KickTransition(_idx, dir == right)]};
+    for (std::int32_t k{1}; k < kicks._tests; k++)
+    {
+      Position p{_pos + tests[k]};
+      if (rows.Fits(shape, p._row - _pos._row + Reach, p._col))
+      {
+        _pos = p;
+        _idx = idx;
+        return true;
+      }
+    }
+    return false;
   }
 
-private:
-  /// @brief Figures array
+  /// @brief Move the figure down as far as it can go
   ///
-  /// This is a static implementation.
-  /// Array holds figures of all possible rotations.
-  /// Rotation of a figure is just simply selecting different index
-  /// in the array.
-  static const std::array<std::array<Block, 4>, 4> _figure;
-
-  Position _pos{};
-  std::int32_t _idx{0};
-  std::array<Block, 4> _blocks{_figure[0]};
-
-  explicit BarT(Direction dir)
+  /// Same as translating down until there is a colision, only the screen
+  /// is read once as bit masks.
+  ///
+  /// @param screen - game screen
+  /// @returns number of lines the figure has moved by
+  std::int32_t Fall(const TetrisScreen &screen) override
   {
-    std::int32_t size{_figure.size()};
-    _idx += dir;
-    if (_idx >= size)
-      _idx = 0;
-    else if (_idx < 0)
-      _idx = size - 1;
-
-    _blocks = _figure[_idx];
+    RowMasks<TetrisScreen::Depth()> rows{screen, 0};
+    const auto &shape{ShapeType::Table[_idx]._rows};
+    std::int32_t lines{0};
+    while (rows.Fits(shape, _pos._row + lines + 1, _pos._col))
+      lines++;
+    _pos._row += lines;
+    return lines;
   }
-};
 
-/// @brief Square figure
-///
-/// Satisfies requirements:
-///   [REQ_FiguresType](https://github.com/grygorek/TetrisArch#REQ_FiguresType)
-class Square final : public Figure
-{
-  friend bool Tetris::Translate<Square>(Square &, TetrisScreen &screen,
-                                        Position direction);
-
-public:
-  explicit Square(Position p)
-      : _blocks{std::array<Block, 1>{Block{p}}}
+  /// @brief Draw the figure on a screen with given mode
+  /// @param screen - game screen
+  /// @param mode - drawing mode (show or hide the figure)
+  void Draw(TetrisScreen &screen, DrawMode mode) override
   {
+    auto colour{mode == DrawMode::draw ? Colour::red : Colour::background};
+    for (auto offset : ShapeType::Table[_idx]._offsets)
+      screen[_pos + offset] = colour;
   }
 
-  Position Pos() const override { return _blocks[0].Pos(); }
-  std::int32_t BlocksCount() const override { return _blocks.size(); }
-
-  bool Translate(TetrisScreen &screen, Position direction) override
-  {
-    return Tetris::Translate<Square>(*this, screen, direction);
-  }
+private:
+  Position _pos;
+  std::int32_t _idx{0};
 
-  void Draw(TetrisScreen &screen, DrawMode mode) override
+  static bool Fits(const TetrisScreen &screen, Position p, std::int32_t idx)
   {
-    Tetris::Draw(_blocks, screen, mode);
+    for (auto offset : ShapeType::Table[idx]._offsets)
+      if (screen.Colision(p + offset))
+        return false;
+    return true;
   }
-
-private:
-  std::array<Block, 1> _blocks;
 };
 
-/// @brief Big Square figure
+// clang-format off
+/// Single block
+using Square    = ShapeFigure<"X">;
+/// Four blocks in a square, also the 'O' tetromino
+using BigSquare = ShapeFigure<"XX\n"
+                              "XX">;
+/// Three blocks in a line
+using Bar       = ShapeFigure<".X.\n"
+                              ".X.\n"
+                              ".X.">;
+/// Three blocks in a line and one under the middle one
+using BarT      = ShapeFigure<"XXX\n"
+                              ".X.\n"
+                              "...">;
+
+/// @brief Standard tetrominoes
 ///
-/// Satisfies requirements:
-///   [REQ_FiguresType](https://github.com/grygorek/TetrisArch#REQ_FiguresType)
-class BigSquare final : public Figure
+/// Drawn in their spawn rotation, in boxes they rotate in by the Super
+/// Rotation System. 'O' is the BigSquare.
+using TetrominoI = ShapeFigure<"....\n"
+                               "XXXX\n"
+                               "....\n"
+                               "....">;
+using TetrominoJ = ShapeFigure<"X..\n"
+                               "XXX\n"
+                               "...">;
+using TetrominoL = ShapeFigure<"..X\n"
+                               "XXX\n"
+                               "...">;
+using TetrominoS = ShapeFigure<".XX\n"
+                               "XX.\n"
+                               "...">;
+using TetrominoT = ShapeFigure<".X.\n"
+                               "XXX\n"
+                               "...">;
+using TetrominoZ = ShapeFigure<"XX.\n"
+                               ".XX\n"
+                               "...">;
+// clang-format on
+
+/// @brief Holder of any figure by value
+///
+/// Figures are small. Keeping them in place instead of on the heap makes
+/// the game state a plain value: it can be copied, saved and restored
+/// without allocation. Access is through the Figure interface.
+class AnyFigure
 {
-  friend bool Tetris::Translate<BigSquare>(BigSquare &, TetrisScreen &screen,
-                                           Position direction);
-
 public:
-  explicit BigSquare(Position p)
-      : _blocks{std::array<Block, 4>{
-            Block{{p._row, p._col}}, Block{{p._row, p._col + 1}},
-            Block{{p._row + 1, p._col}}, Block{{p._row + 1, p._col + 1}}}}
-  {
-  }
-
-  Position Pos() const override { return _blocks[0].Pos(); }
-  std::int32_t BlocksCount() const override { return _blocks.size(); }
-
-  bool Translate(TetrisScreen &screen, Position direction) override
+  /// Default figure, only to make containers of game states possible
+  AnyFigure()
+      : _figure{Square{Position{}}}
   {
-    return Tetris::Translate<BigSquare>(*this, screen, direction);
   }
 
-  void Draw(TetrisScreen &screen, DrawMode mode) override
+  /// @brief Hold given figure
+  /// @tparam FigureType - one of the figures from this file
+  template <class FigureType>
+  AnyFigure(const FigureType &f)
+      : _figure{f}
   {
-    Tetris::Draw(_blocks, screen, mode);
   }
 
-private:
-  std::array<Block, 4> _blocks;
-};
+  /// Number of different figures
+  static constexpr std::int32_t Kinds{10};
 
-/// @brief Simple Bar figure
-///
-/// Satisfies requirements:
-///   [REQ_FiguresType](https://github.com/grygorek/TetrisArch#REQ_FiguresType)
-class Bar final : public Figure
-{
-  friend bool Tetris::Translate<Bar>(Bar &, TetrisScreen &screen,
-                                     Position direction);
-  friend bool Tetris::Rotate<Bar>(Bar &fig, TetrisScreen &screen,
-                                  Direction dir);
-
-public:
-  explicit Bar(Position p)
-      : _pos{p}
+  /// @brief Create a figure of a given kind
+  /// @param kind - index of the figure in the list of figures held:
+  ///   0 big square, 1 bar, 2 T, 3 square, 4..9 tetrominoes I, J, L, S, T, Z
+  /// @param p - position of the figure
+  /// @param rotation - index of the rotation, see Figure::Rotation
+  static AnyFigure Make(std::int32_t kind, Position p,
+                        std::int32_t rotation = 0)
   {
-    for (auto &b : _blocks)
-      b = Block{b.Pos() + p};
+    AnyFigure f;
+    f.Emplace(kind, p, rotation, std::make_index_sequence<Kinds>{});
+    return f;
   }
 
-  Position Pos() const override { return _pos; }
-  std::int32_t BlocksCount() const override { return _blocks.size(); }
-
-  bool Translate(TetrisScreen &screen, Position direction) override
+  /// Kind of the held figure, see Make
+  std::int32_t Kind() const
   {
-    return Tetris::Translate<Bar>(*this, screen, direction);
+    return static_cast<std::int32_t>(_figure.index());
   }
 
-  void Draw(TetrisScreen &screen, DrawMode mode) override
+  Figure *operator->() { return &**this; }
+  const Figure *operator->() const { return &**this; }
+
+  Figure &operator*()
   {
-    Tetris::Draw(_blocks, screen, mode);
+    return std::visit([](auto &f) -> Figure & { return f; }, _figure);
   }
-
-  bool Rotate(TetrisScreen &screen, Direction dir) override
+  const Figure &operator*() const
   {
-    return Tetris::Rotate(*this, screen, dir);
+    return std::visit([](auto &f) -> const Figure & { return f; }, _figure);
   }
 
 private:
-  /// @brief Figures array
-  ///
-  /// This is a static implementation.
-  /// Array holds figures of all possible rotations.
-  /// Rotation of a figure is just simply selecting different index
-  /// in the array.
-  static const std::array<std::array<Block, 3>, 2> _figure;
-
-  Position _pos{};
-  std::int32_t _idx{0};
-  std::array<Block, 3> _blocks{_figure[0]};
+  std::variant<BigSquare, Bar, BarT, Square, TetrominoI, TetrominoJ,
+               TetrominoL, TetrominoS, TetrominoT, TetrominoZ>
+      _figure;
 
-  explicit Bar(Direction dir)
+  template <std::size_t... Kind>
+  void Emplace(std::int32_t kind, Position p, std::int32_t rotation,
+               std::index_sequence<Kind...>)
   {
-    std::int32_t size{_figure.size()};
-
-    _idx += dir;
-    if (_idx >= size)
-      _idx = 0;
-    else if (_idx < 0)
-      _idx = size - 1;
-
-    _blocks = _figure[_idx];
+    ((kind == Kind ? (void)_figure.template emplace<Kind>(p, rotation)
+                   : void()),
+     ...);
   }
 };
+
+/// Figures of the original game, by kind
+constexpr std::array<std::uint8_t, 4> ClassicFigures{0, 1, 2, 3};
+/// Seven standard tetrominoes, by kind
+constexpr std::array<std::uint8_t, 7> Tetrominoes{4, 5, 6, 0, 7, 8, 9};
 } // namespace Tetris
 
 #endif //__TETRIS_FIGURE_IMPL_H__
@@ -0,0 +1,181 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Games constructed once and reused by many simulations
+
+#ifndef __TETRIS_GAME_POOL_H__
+#define __TETRIS_GAME_POOL_H__
+
+#include "TetrisGame.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+namespace Tetris
+{
+/// @brief Fixed set of games handed out and taken back
+///
+/// All games are constructed with the pool. Acquire resets a free game
+/// in place with a new seed, Release puts it back; neither allocates. Free
+/// games are kept on a lock-free stack, so threads of a batch runner can
+/// take and return games without waiting for each other.
+class GamePool
+{
+  struct Slot
+  {
+    Slot(FigureSet set, RotationSystem rotation)
+        : _game{1, set, rotation}
+    {
+    }
+
+    Game _game;
+    /// Next free slot
+    std::atomic<std::uint32_t> _next{Empty};
+  };
+
+public:
+  /// @brief Game borrowed from the pool, returned when it goes away
+  class Lease
+  {
+  public:
+    Lease() = default;
+    Lease(Lease &&l)
+        : _pool{l._pool}
+        , _slot{l._slot}
+    {
+      l._pool = nullptr;
+    }
+    Lease &operator=(Lease &&l)
+    {
+      std::swap(_pool, l._pool);
+      std::swap(_slot, l._slot);
+      return *this;
+    }
+    ~Lease()
+    {
+      if (_pool)
+        _pool->Release(_slot);
+    }
+
+    /// Pool had no free game
+    explicit operator bool() const { return _pool != nullptr; }
+
+    Game &operator*() const { return _pool->_slots[_slot]._game; }
+    Game *operator->() const { return &**this; }
+
+  private:
+    friend class GamePool;
+    Lease(GamePool &pool, std::uint32_t slot)
+        : _pool{&pool}
+        , _slot{slot}
+    {
+    }
+
+    GamePool *_pool{nullptr};
+    std::uint32_t _slot{0};
+  };
+
+  /// @brief Construct all games of the pool
+  /// @param count - number of games
+  /// @param set - figures the games are played with
+  /// @param rotation - rotation system of the games
+  explicit GamePool(std::uint32_t count, FigureSet set = FigureSet::classic,
+                    RotationSystem rotation = RotationSystem::none)
+  {
+    for (std::uint32_t i{0}; i < count; i++)
+      _slots.emplace_back(set, rotation);
+    for (std::uint32_t i{count}; i > 0; i--)
+      Release(i - 1);
+  }
+
+  GamePool(const GamePool &) = delete;
+  void operator=(const GamePool &) = delete;
+
+  /// @brief Take a free game and start it with a seed
+  /// @returns the game or an empty lease if all games are taken
+  Lease Acquire(std::uint32_t seed)
+  {
+    auto head{_free.load(std::memory_order_acquire)};
+    while (Index(head) != Empty)
+    {
+      auto next{_slots[Index(head)]._next.load(std::memory_order_relaxed)};
+      if (_free.compare_exchange_weak(head, Link(next, head),
+                                      std::memory_order_acquire))
+      {
+        _slots[Index(head)]._game.Reset(seed);
+        return Lease{*this, Index(head)};
+      }
+    }
+    return Lease{};
+  }
+
+  /// Number of games in the pool
+  std::uint32_t Size() const
+  {
+    return static_cast<std::uint32_t>(_slots.size());
+  }
+
+private:
+  static constexpr std::uint32_t Empty{~0u};
+
+  std::deque<Slot> _slots;
+  /// Top of the stack of free slots: index in the low half and a count of
+  /// changes in the high half, so a slot taken and returned meanwhile does
+  /// not fool compare-exchange
+  std::atomic<std::uint64_t> _free{Empty};
+
+  static std::uint32_t Index(std::uint64_t head)
+  {
+    return static_cast<std::uint32_t>(head);
+  }
+
+  /// New top of the stack after 'head'
+  static std::uint64_t Link(std::uint32_t index, std::uint64_t head)
+  {
+    return ((head >> 32) + 1) << 32 | index;
+  }
+
+  void Release(std::uint32_t slot)
+  {
+    auto head{_free.load(std::memory_order_relaxed)};
+    do
+      _slots[slot]._next.store(Index(head), std::memory_order_relaxed);
+    while (!_free.compare_exchange_weak(head, Link(slot, head),
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed));
+  }
+};
+
+} // namespace Tetris
+
+#endif //__TETRIS_GAME_POOL_H__
@@ -0,0 +1,70 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Speed of falling figures
+
+#ifndef __TETRIS_GRAVITY_H__
+#define __TETRIS_GRAVITY_H__
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace Tetris
+{
+/// @brief Time for a figure to fall by one line at a given level
+///
+/// Values follow the usual curve (0.8 - (level - 1) * 0.007)^(level - 1)
+/// seconds, rounded to milliseconds. Levels past the table keep the
+/// fastest speed.
+///
+/// Satisfies requirements:
+///   [REQ_OnTimerCommand](https://github.com/grygorek/TetrisArch#REQ_OnTimerCommand)
+///
+/// @param level - game level, starts at 1
+constexpr std::chrono::milliseconds FallInterval(std::int32_t level)
+{
+  constexpr std::array<std::int32_t, 15> intervals{
+      1000, 793, 618, 473, 355, 262, 190, 135, 94, 64, 43, 28, 18, 11, 7};
+  std::int32_t last = intervals.size() - 1; // changing type
+  auto idx{level < 1 ? 0 : (level - 1 > last ? last : level - 1)};
+  return std::chrono::milliseconds{intervals[idx]};
+}
+
+/// @brief Time a figure stays on the ground before it is locked
+///
+/// Gives the player a moment to slide the figure after it has landed.
+constexpr std::chrono::milliseconds LockDelay{500};
+
+} // namespace Tetris
+
+#endif //__TETRIS_GRAVITY_H__
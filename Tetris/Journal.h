@@ -0,0 +1,295 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Journal of snapshots kept as differences, for undo and redo
+
+#ifndef __TETRIS_JOURNAL_H__
+#define __TETRIS_JOURNAL_H__
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+
+namespace Tetris
+{
+/// @brief Ring of differences between consecutive snapshots
+///
+/// Every Record stores only the bytes of a snapshot that have changed,
+/// as pairs of an index and the XOR of the old and the new value. XOR
+/// works both ways, so the same record takes a snapshot back for Undo and
+/// forward for Redo. The record is framed by its length on both sides to
+/// be walked in both directions. A tick of a game that only moves the
+/// figure changes its position and the rows it covers, about seven bytes
+/// on average; one that does nothing takes two.
+///
+/// Every KeyframeInterval records the whole snapshot is stored as well.
+/// Going many records at once starts from the keyframe closest to the
+/// target, so it applies about KeyframeInterval records at most. When
+/// the ring is full, the oldest records are dropped up to the next
+/// keyframe; the journal always starts with a keyframe.
+///
+/// Memory of the ring is given by the owner, the journal does not
+/// allocate.
+///
+/// @tparam Size - bytes of a snapshot
+template <std::size_t Size>
+class DeltaJournal
+{
+public:
+  using Snapshot = std::array<std::uint8_t, Size>;
+
+  /// Records between keyframes
+  static constexpr std::int64_t KeyframeInterval{64};
+  /// Bytes of the biggest record; the ring must hold two of them
+  static constexpr std::size_t MaxRecord{2 + 2 * Size};
+
+  /// @param ring - memory of the journal, at least 2 * MaxRecord bytes
+  explicit DeltaJournal(std::span<std::uint8_t> ring)
+      : _ring{ring}
+  {
+  }
+
+  DeltaJournal(const DeltaJournal &) = delete;
+  void operator=(const DeltaJournal &) = delete;
+
+  /// @brief Forget everything and start from a snapshot
+  void Start(const Snapshot &s)
+  {
+    _begin = _cursor = _end = 0;
+    _back = _forward = 0;
+    _head            = s;
+    WriteKeyframe();
+  }
+
+  /// @brief Record the next snapshot
+  ///
+  /// Records that could be redone are dropped.
+  void Record(const Snapshot &s)
+  {
+    _end     = _cursor;
+    _forward = 0;
+
+    std::array<std::uint8_t, MaxRecord> record;
+    std::size_t size{1};
+    for (std::size_t i{0}; i < Size; i++)
+      if (auto x{static_cast<std::uint8_t>(_head[i] ^ s[i])}; x != 0)
+      {
+        record[size++] = static_cast<std::uint8_t>(i);
+        record[size++] = x;
+      }
+    record[0]      = static_cast<std::uint8_t>(size / 2);
+    record[size++] = record[0];
+
+    _head = s;
+    if (!Write(record.data(), size))
+    {
+      Start(s);
+      return;
+    }
+    _back++;
+    if (++_sinceKeyframe >= KeyframeInterval)
+      WriteKeyframe();
+  }
+
+  /// Current snapshot
+  const Snapshot &Head() const { return _head; }
+
+  /// Number of records that can be undone
+  std::int64_t Undoable() const { return _back; }
+
+  /// Number of records that can be redone
+  std::int64_t Redoable() const { return _forward; }
+
+  /// Bytes of the ring in use
+  std::uint64_t Bytes() const { return _end - _begin; }
+
+  /// @brief Go back up to n records
+  /// @returns snapshot after undo
+  const Snapshot &Undo(std::int64_t n)
+  {
+    n = std::clamp<std::int64_t>(n, 0, _back);
+    if (n == 0)
+      return _head;
+
+    auto target{_cursor};
+    for (auto i{n}; i > 0;)
+    {
+      target = Previous(target);
+      i -= !IsKeyframe(target);
+    }
+
+    if (n <= KeyframeInterval)
+    {
+      for (auto p{_cursor}; p != target;)
+      {
+        p = Previous(p);
+        if (!IsKeyframe(p))
+          Apply(p);
+      }
+    }
+    else
+    {
+      // journal starts with a keyframe, so there is one before the target
+      auto key{target};
+      do
+        key = Previous(key);
+      while (!IsKeyframe(key));
+      Forward(key, target);
+    }
+
+    _cursor = target;
+    _back -= n;
+    _forward += n;
+    return _head;
+  }
+
+  /// @brief Go forward up to n records that have been undone
+  /// @returns snapshot after redo
+  const Snapshot &Redo(std::int64_t n)
+  {
+    n = std::clamp<std::int64_t>(n, 0, _forward);
+
+    auto from{_cursor};
+    auto target{_cursor};
+    for (auto i{n}; i > 0; target = Next(target))
+      if (IsKeyframe(target))
+        from = target;
+      else
+        i--;
+    Forward(from, target);
+
+    _cursor = target;
+    _back += n;
+    _forward -= n;
+    return _head;
+  }
+
+private:
+  /// Length byte that marks a keyframe
+  static constexpr std::uint8_t Keyframe{0xFF};
+  static constexpr std::size_t KeyframeSize{2 + Size};
+
+  static_assert(Size < Keyframe, "Length of a record must not be a keyframe");
+
+  std::span<std::uint8_t> _ring;
+  /// Snapshot at the cursor
+  Snapshot _head{};
+  /// Positions in the ring grow forever; the byte is at position % size
+  std::uint64_t _begin{0};
+  std::uint64_t _cursor{0};
+  std::uint64_t _end{0};
+  /// Records between the beginning and the cursor, and after the cursor
+  std::int64_t _back{0};
+  std::int64_t _forward{0};
+  std::int64_t _sinceKeyframe{0};
+
+  std::uint8_t &At(std::uint64_t p) { return _ring[p % _ring.size()]; }
+
+  bool IsKeyframe(std::uint64_t p) { return At(p) == Keyframe; }
+
+  /// Beginning of the record that ends at p
+  std::uint64_t Previous(std::uint64_t p)
+  {
+    auto length{At(p - 1)};
+    return p - (length == Keyframe ? KeyframeSize : 2 + 2 * length);
+  }
+
+  /// End of the record that begins at p
+  std::uint64_t Next(std::uint64_t p)
+  {
+    auto length{At(p)};
+    return p + (length == Keyframe ? KeyframeSize : 2 + 2 * length);
+  }
+
+  /// XOR the differences of the record at p into the head
+  void Apply(std::uint64_t p)
+  {
+    for (std::uint8_t i{0}, n{At(p)}; i < n; i++)
+      _head[At(p + 1 + 2 * i)] ^= At(p + 2 + 2 * i);
+  }
+
+  /// @brief Bring the head from p to the target
+  /// @param p - the cursor or a keyframe before the target
+  void Forward(std::uint64_t p, std::uint64_t target)
+  {
+    for (; p != target; p = Next(p))
+      if (IsKeyframe(p))
+        for (std::size_t i{0}; i < Size; i++)
+          _head[i] = At(p + 1 + i);
+      else
+        Apply(p);
+  }
+
+  void WriteKeyframe()
+  {
+    std::array<std::uint8_t, KeyframeSize> record;
+    record[0] = record[KeyframeSize - 1] = Keyframe;
+    std::copy(_head.begin(), _head.end(), record.begin() + 1);
+    if (Write(record.data(), record.size()))
+      _sinceKeyframe = 0;
+  }
+
+  /// @brief Append a record at the cursor
+  /// @returns false when the ring cannot hold it even without old records
+  bool Write(const std::uint8_t *record, std::size_t size)
+  {
+    while (_end + size - _begin > _ring.size())
+      if (!DropOldest())
+        return false;
+    for (std::size_t i{0}; i < size; i++)
+      At(_end + i) = record[i];
+    _end += size;
+    _cursor = _end;
+    return true;
+  }
+
+  /// @brief Drop the first keyframe and the records up to the next one
+  bool DropOldest()
+  {
+    if (_begin == _cursor)
+      return false;
+    std::int64_t dropped{0};
+    auto p{Next(_begin)};
+    for (; p != _cursor && !IsKeyframe(p); p = Next(p))
+      dropped++;
+    if (p == _cursor)
+      return false;
+    _begin = p;
+    _back -= dropped;
+    return true;
+  }
+};
+
+} // namespace Tetris
+
+#endif //__TETRIS_JOURNAL_H__
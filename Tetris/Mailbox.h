@@ -0,0 +1,104 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Passing commands from an interrupt to the game
+
+#ifndef __TETRIS_MAILBOX_H__
+#define __TETRIS_MAILBOX_H__
+
+#include "Command.h"
+#include "TetrisGame.h"
+#include <atomic>
+#include <cstdint>
+
+namespace Tetris
+{
+/// @brief Single command waiting for the next tick
+///
+/// A key interrupt posts commands, the game's tick takes them. The latest
+/// command replaces the one that has not been taken yet.
+///
+/// The command and a count of posts share one word. The interrupt is its
+/// only writer and the tick only reads it, remembering the last count it
+/// has seen. Both sides use plain atomic loads and stores, no
+/// read-modify-write, so they are wait-free even on cores without
+/// exclusive access instructions and neither disables interrupts.
+///
+/// Satisfies requirements:
+///   [REQ_NoPendingCommands](https://github.com/grygorek/TetrisArch#REQ_NoPendingCommands)
+class CommandMailbox
+{
+public:
+  /// @brief Leave a command for the next tick
+  ///
+  /// Called from a single interrupt (or a single thread) only.
+  void Post(Command cmd)
+  {
+    _posted += 1u << CountShift;
+    _box.store(_posted | static_cast<std::uint32_t>(cmd),
+               std::memory_order_release);
+  }
+
+  /// @brief Take the command posted since the last call
+  /// @returns the command or Idle if there is none
+  Command Take()
+  {
+    auto box{_box.load(std::memory_order_acquire)};
+    if ((box >> CountShift) == _taken)
+      return Command::Idle;
+    _taken = box >> CountShift;
+    return static_cast<Command>(box & CommandMask);
+  }
+
+private:
+  static constexpr std::uint32_t CountShift{8};
+  static constexpr std::uint32_t CommandMask{(1u << CountShift) - 1};
+
+  std::atomic<std::uint32_t> _box{0};
+  /// Posts so far, in the upper bits; used by the poster only
+  std::uint32_t _posted{0};
+  /// Count of the last command taken; used by the taker only
+  std::uint32_t _taken{0};
+};
+
+/// @brief Progress a game with the command waiting in a mailbox
+///
+/// Called from a timer interrupt or the main loop, but not from both.
+inline void Tick(Game &game, CommandMailbox &mailbox)
+{
+  game.Input(mailbox.Take());
+  game.Tick();
+}
+
+} // namespace Tetris
+
+#endif //__TETRIS_MAILBOX_H__
@@ -0,0 +1,592 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Small neural network scoring candidate placements on the CPU
+
+#ifndef __TETRIS_MLP_H__
+#define __TETRIS_MLP_H__
+
+#include "BoardFeatures.h"
+#include "ScreenDef.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <span>
+#include <utility>
+#include <vector>
+
+// MSVC has no macro for FMA; /arch:AVX2 allows it
+#if !defined(TETRIS_NO_SIMD) && defined(__AVX2__) &&                           \
+    (defined(__FMA__) || defined(_MSC_VER))
+#include <immintrin.h>
+#define TETRIS_MLP_AVX2
+#endif
+
+namespace Tetris
+{
+/// @brief What a network is given about a candidate placement
+enum class MlpInput : std::uint8_t
+{
+  /// Lines removed, landing height and BoardFeatures, in this order
+  features,
+  /// The same followed by every block of the board, 1 when not empty
+  board
+};
+
+/// Numbers of MlpInput::features
+constexpr std::int32_t MlpFeatureInputs{8};
+
+/// @brief Number of inputs of a network
+constexpr std::int32_t MlpInputs(MlpInput input)
+{
+  return MlpFeatureInputs + (input == MlpInput::board
+                                 ? TetrisScreen::Depth() * TetrisScreen::Width()
+                                 : 0);
+}
+
+/// @brief Write inputs of a candidate placement
+/// @param input - what the network expects
+/// @param cleared - lines removed by the placement
+/// @param landing - height above the floor the figure has landed at
+/// @param f - features of the board after the placement
+/// @param board - board after the placement
+/// @param row - MlpInputs(input) numbers
+inline void MlpEncode(MlpInput input, std::int32_t cleared,
+                      std::int32_t landing, const BoardFeatures &f,
+                      const TetrisScreen &board, float *row)
+{
+  const std::int32_t numbers[MlpFeatureInputs]{
+      cleared,          landing,
+      f._aggregateHeight, f._holes,
+      f._bumpiness,     f._rowTransitions,
+      f._columnTransitions, f._wells};
+  for (std::int32_t i{0}; i < MlpFeatureInputs; i++)
+    row[i] = static_cast<float>(numbers[i]);
+  if (input != MlpInput::board)
+    return;
+  row += MlpFeatureInputs;
+  // a comparison here becomes a branch that mispredicts on every other
+  // block; any colour plus 255 carries into bit 8, background does not
+  for (const auto &line : board.Lines())
+    for (auto block : line)
+      *row++ =
+          static_cast<float>((static_cast<std::uint32_t>(block) + 0xFF) >> 8);
+}
+
+/// @brief Header of a network file
+///
+/// The header is followed by the layers. Each layer is an MlpLayerHeader
+/// followed by its numbers, little endian:
+///   float layer: weights [outputs][inputs] float, bias [outputs] float
+///   int8 layer:  scale [outputs] float, weights [outputs][inputs] int8,
+///                bias [outputs] float; weight is int8 * scale of its output
+struct MlpHeader
+{
+  static constexpr std::array<char, 4> Magic{'T', 'M', 'L', 'P'};
+  static constexpr std::uint16_t Version{1};
+
+  std::array<char, 4> _magic{Magic};
+  std::uint16_t _version{Version};
+  /// MlpInput
+  std::uint8_t _input{0};
+  std::uint8_t _layers{0};
+};
+
+/// @brief Header of a layer in a network file
+struct MlpLayerHeader
+{
+  enum : std::uint8_t
+  {
+    Float = 0, ///< weights are floats
+    Int8  = 1  ///< weights are bytes with a scale per output
+  };
+  enum : std::uint8_t
+  {
+    Linear = 0,
+    Relu   = 1
+  };
+
+  std::uint16_t _inputs;
+  std::uint16_t _outputs;
+  std::uint8_t _type;
+  std::uint8_t _activation;
+  std::uint16_t _reserved;
+};
+
+static_assert(sizeof(MlpHeader) == 8 && sizeof(MlpLayerHeader) == 8,
+              "Headers are read as they are");
+
+/// @brief Layer of a network to be written, see MlpWrite
+struct MlpLayer
+{
+  std::int32_t _inputs;
+  std::int32_t _outputs;
+  /// Store weights as int8, each output with its own scale
+  bool _int8;
+  bool _relu;
+  /// [outputs][inputs]
+  std::vector<float> _weights;
+  std::vector<float> _bias;
+};
+
+/// @brief Network file of given layers
+///
+/// Weights of int8 layers are rounded to the nearest step of their
+/// output's scale, the largest weight of the output over 127.
+inline std::vector<std::uint8_t> MlpWrite(MlpInput input,
+                                          std::span<const MlpLayer> layers)
+{
+  std::vector<std::uint8_t> file;
+  auto put{[&file](const void *data, std::size_t size) {
+    auto bytes{static_cast<const std::uint8_t *>(data)};
+    file.insert(file.end(), bytes, bytes + size);
+  }};
+
+  MlpHeader header;
+  header._input  = static_cast<std::uint8_t>(input);
+  header._layers = static_cast<std::uint8_t>(layers.size());
+  put(&header, sizeof(header));
+  for (const auto &l : layers)
+  {
+    MlpLayerHeader h{static_cast<std::uint16_t>(l._inputs),
+                     static_cast<std::uint16_t>(l._outputs),
+                     l._int8 ? MlpLayerHeader::Int8 : MlpLayerHeader::Float,
+                     l._relu ? MlpLayerHeader::Relu : MlpLayerHeader::Linear,
+                     0};
+    put(&h, sizeof(h));
+    if (!l._int8)
+      put(l._weights.data(), l._weights.size() * sizeof(float));
+    else
+    {
+      std::vector<float> scales(l._outputs);
+      std::vector<std::int8_t> bytes(l._weights.size());
+      for (std::int32_t o{0}; o < l._outputs; o++)
+      {
+        auto row{&l._weights[o * l._inputs]};
+        float max{0};
+        for (std::int32_t i{0}; i < l._inputs; i++)
+          max = std::max(max, std::abs(row[i]));
+        scales[o] = max > 0 ? max / 127 : 1;
+        for (std::int32_t i{0}; i < l._inputs; i++)
+          bytes[o * l._inputs + i] =
+              static_cast<std::int8_t>(std::lround(row[i] / scales[o]));
+      }
+      put(scales.data(), scales.size() * sizeof(float));
+      put(bytes.data(), bytes.size());
+    }
+    put(l._bias.data(), l._bias.size() * sizeof(float));
+  }
+  return file;
+}
+
+/// @brief Portable lanes: eight floats
+///
+/// Loops over a small array; the compiler may vectorise them itself.
+struct MlpScalar
+{
+  struct Vector
+  {
+    float _v[8];
+  };
+  static constexpr std::int32_t Width{8};
+
+  static Vector Broadcast(float x)
+  {
+    Vector r;
+    for (auto &v : r._v)
+      v = x;
+    return r;
+  }
+  static Vector Load(const float *p)
+  {
+    Vector r;
+    std::memcpy(r._v, p, sizeof(r._v));
+    return r;
+  }
+  static Vector Load(const std::int8_t *p)
+  {
+    Vector r;
+    for (std::int32_t i{0}; i < Width; i++)
+      r._v[i] = p[i];
+    return r;
+  }
+  /// `a * b + c`
+  static Vector MulAdd(Vector a, Vector b, Vector c)
+  {
+    for (std::int32_t i{0}; i < Width; i++)
+      c._v[i] += a._v[i] * b._v[i];
+    return c;
+  }
+  static Vector Relu(Vector a)
+  {
+    for (auto &v : a._v)
+      v = std::max(v, 0.0f);
+    return a;
+  }
+  static void Store(float *p, Vector a)
+  {
+    std::memcpy(p, a._v, sizeof(a._v));
+  }
+};
+
+#ifdef TETRIS_MLP_AVX2
+/// @brief AVX2 lanes: eight floats in a register, multiply-add by FMA
+struct MlpAvx2
+{
+  using Vector = __m256;
+  static constexpr std::int32_t Width{8};
+
+  static Vector Broadcast(float x) { return _mm256_set1_ps(x); }
+  static Vector Load(const float *p) { return _mm256_loadu_ps(p); }
+  static Vector Load(const std::int8_t *p)
+  {
+    auto bytes{_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p))};
+    return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(bytes));
+  }
+  static Vector MulAdd(Vector a, Vector b, Vector c)
+  {
+    return _mm256_fmadd_ps(a, b, c);
+  }
+  static Vector Relu(Vector a)
+  {
+    return _mm256_max_ps(a, _mm256_setzero_ps());
+  }
+  static void Store(float *p, Vector a) { _mm256_storeu_ps(p, a); }
+};
+
+/// Widest lanes the build supports
+using MlpLanes = MlpAvx2;
+#else
+using MlpLanes = MlpScalar;
+#endif
+
+/// @brief Multilayer perceptron scoring a batch of candidates
+///
+/// Hidden layers are usually ReLU; the last layer has a single output,
+/// the score. Weights are kept transposed, [inputs][outputs] with outputs
+/// rounded up to the width of lanes, so one vector of weights serves
+/// eight outputs and each input is broadcast to them. Inputs that are
+/// zero are skipped: empty blocks of the board and outputs cut off by
+/// ReLU cost nothing.
+///
+/// Buffers for inputs and activations are made once for the largest
+/// batch. Candidates' inputs are written in place with Row and
+/// evaluated together; nothing is allocated or copied per call.
+class Mlp
+{
+public:
+  /// Largest number of inputs or outputs of a layer
+  static constexpr std::int32_t MaxWidth{1024};
+
+  /// @param batch - most candidates evaluated at once
+  explicit Mlp(std::int32_t batch)
+      : _batch{batch}
+  {
+  }
+
+  /// @brief Read a network file
+  /// @returns false when the file does not hold a valid network
+  bool Load(const char *path)
+  {
+    std::vector<std::uint8_t> file;
+    if (auto *f{std::fopen(path, "rb")})
+    {
+      std::uint8_t chunk[4096];
+      for (std::size_t n; (n = std::fread(chunk, 1, sizeof(chunk), f)) > 0;)
+        file.insert(file.end(), chunk, chunk + n);
+      std::fclose(f);
+    }
+    return Load(file);
+  }
+
+  /// @brief Read a network, see MlpHeader
+  ///
+  /// A network that is not valid leaves nothing behind, so Ok() is false.
+  /// @returns false when it is not a valid network
+  bool Load(std::span<const std::uint8_t> file)
+  {
+    _layers.clear();
+    _floats.clear();
+    _bytes.clear();
+    _stride = 0;
+
+    MlpHeader header;
+    std::size_t at{0};
+    auto get{[&](void *data, std::size_t size) {
+      if (file.size() - at < size)
+        return Fail();
+      std::memcpy(data, file.data() + at, size);
+      at += size;
+      return true;
+    }};
+    if (!get(&header, sizeof(header)) || header._magic != MlpHeader::Magic ||
+        header._version != MlpHeader::Version ||
+        header._input > static_cast<std::uint8_t>(MlpInput::board) ||
+        header._layers == 0)
+      return Fail();
+    _input = static_cast<MlpInput>(header._input);
+
+    std::int32_t inputs{MlpInputs(_input)};
+    _stride = Round(inputs);
+    for (std::uint8_t n{0}; n < header._layers; n++)
+    {
+      MlpLayerHeader h;
+      if (!get(&h, sizeof(h)) || h._inputs != inputs || h._outputs == 0 ||
+          h._outputs > MaxWidth || h._type > MlpLayerHeader::Int8)
+        return Fail();
+
+      Layer l{h._inputs, h._outputs, Round(h._outputs),
+              h._type == MlpLayerHeader::Int8,
+              h._activation == MlpLayerHeader::Relu, 0, 0, 0};
+      std::vector<float> scales(l._outputs, 1.0f);
+      std::vector<float> floats(std::size_t(l._outputs) * l._inputs);
+      std::vector<std::int8_t> bytes(l._int8 ? floats.size() : 0);
+      std::vector<float> bias(l._outputs);
+      if ((l._int8 && !get(scales.data(), scales.size() * sizeof(float))) ||
+          !get(l._int8 ? static_cast<void *>(bytes.data()) : floats.data(),
+               l._int8 ? bytes.size() : floats.size() * sizeof(float)) ||
+          !get(bias.data(), bias.size() * sizeof(float)))
+        return Fail();
+
+      // transpose to [inputs][width]; outputs over the real ones stay zero
+      std::size_t size{std::size_t(l._inputs) * l._width};
+      l._weights = l._int8 ? _bytes.size() : _floats.size();
+      if (l._int8)
+        _bytes.resize(_bytes.size() + size);
+      else
+        _floats.resize(_floats.size() + size);
+      for (std::int32_t o{0}; o < l._outputs; o++)
+        for (std::int32_t i{0}; i < l._inputs; i++)
+        {
+          auto from{std::size_t(o) * l._inputs + i};
+          auto to{l._weights + std::size_t(i) * l._width + o};
+          if (l._int8)
+            _bytes[to] = bytes[from];
+          else
+            _floats[to] = floats[from];
+        }
+      scales.resize(l._width, 0.0f);
+      bias.resize(l._width, 0.0f);
+      l._scale = _floats.size();
+      _floats.insert(_floats.end(), scales.begin(), scales.end());
+      l._bias = _floats.size();
+      _floats.insert(_floats.end(), bias.begin(), bias.end());
+
+      _layers.push_back(l);
+      _stride = std::max(_stride, l._width);
+      inputs  = l._outputs;
+    }
+    if (inputs != 1 || at != file.size())
+      return Fail();
+
+    _in.assign(std::size_t(_batch) * _stride, 0.0f);
+    _out.assign(std::size_t(_batch) * _stride, 0.0f);
+    _nonZero.assign(_stride, 0);
+    return true;
+  }
+
+  /// Network has been loaded
+  bool Ok() const { return !_layers.empty(); }
+
+  /// What the network expects, see MlpEncode
+  MlpInput Input() const { return _input; }
+
+  /// Most candidates evaluated at once
+  std::int32_t Batch() const { return _batch; }
+
+  /// @brief Inputs of a candidate, MlpInputs(Input()) numbers
+  ///
+  /// Evaluate overwrites them; write them again for the next batch.
+  float *Row(std::int32_t candidate) { return &_in[candidate * _stride]; }
+
+  /// @brief Score the first `count` candidates of the batch
+  /// @tparam Lanes - MlpScalar or MlpAvx2
+  /// @param count - up to Batch()
+  /// @param scores - `count` results
+  template <class Lanes = MlpLanes>
+  void Evaluate(std::int32_t count, float *scores)
+  {
+    float *x{_in.data()};
+    float *y{_out.data()};
+    for (const auto &l : _layers)
+    {
+      if (l._int8)
+        Run<Lanes>(l, &_bytes[l._weights], count, x, y);
+      else
+        Run<Lanes>(l, &_floats[l._weights], count, x, y);
+      std::swap(x, y);
+    }
+    for (std::int32_t c{0}; c < count; c++)
+      scores[c] = x[c * _stride];
+  }
+
+private:
+  struct Layer
+  {
+    std::int32_t _inputs;
+    std::int32_t _outputs;
+    /// Outputs rounded up to the width of lanes
+    std::int32_t _width;
+    bool _int8;
+    bool _relu;
+    /// Offsets of weights in _bytes or _floats, of scales and of biases
+    /// in _floats
+    std::size_t _weights;
+    std::size_t _scale;
+    std::size_t _bias;
+  };
+
+  /// Outputs computed together, the width of all lanes
+  static constexpr std::int32_t Width{8};
+
+  std::int32_t _batch;
+  MlpInput _input{MlpInput::features};
+  std::vector<Layer> _layers;
+  std::vector<float> _floats;
+  std::vector<std::int8_t> _bytes;
+  /// Numbers between a candidate's row and the next one
+  std::int32_t _stride{0};
+  /// Inputs and activations of the batch, layers go back and forth
+  std::vector<float> _in;
+  std::vector<float> _out;
+  /// Indices of inputs of a candidate that are not zero
+  std::vector<std::int32_t> _nonZero;
+
+  static std::int32_t Round(std::int32_t n)
+  {
+    return (n + Width - 1) / Width * Width;
+  }
+
+  /// Forget a network loaded in part
+  bool Fail()
+  {
+    _layers.clear();
+    _floats.clear();
+    _bytes.clear();
+    _in.clear();
+    _out.clear();
+    _nonZero.clear();
+    _stride = 0;
+    return false;
+  }
+
+  /// Outputs of a layer for `count` candidates
+  template <class L, class Weight>
+  void Run(const Layer &l, const Weight *w, std::int32_t count,
+           const float *x, float *y)
+  {
+    static_assert(L::Width == Width, "Weights are laid out for 8 lanes");
+    for (std::int32_t c{0}; c < count; c++, x += _stride, y += _stride)
+    {
+      // Inputs that are zero add nothing. Most blocks of a board are
+      // empty and ReLU gives many zeros, so only the others are visited.
+      std::int32_t n{0};
+      for (std::int32_t i{0}; i < l._inputs; i++)
+      {
+        _nonZero[n] = i;
+        n += x[i] != 0.0f;
+      }
+      std::int32_t o{0};
+      for (; o + 8 * Width <= l._width; o += 8 * Width)
+        Block<L, 8>(l, w + o, x, n, y + o, o);
+      for (; o + 4 * Width <= l._width; o += 4 * Width)
+        Block<L, 4>(l, w + o, x, n, y + o, o);
+      for (; o < l._width; o += Width)
+        Block<L, 1>(l, w + o, x, n, y + o, o);
+    }
+  }
+
+  /// @brief `G` * 8 outputs of a candidate
+  ///
+  /// Every output vector has its own accumulator, kept in a register.
+  /// Eight of them keep the multiply-adders busy while each one waits
+  /// for its previous result.
+  /// @param w - weights of the first output
+  /// @param n - number of inputs in _nonZero
+  /// @param o - index of the first output
+  template <class L, std::int32_t G, class Weight>
+  void Block(const Layer &l, const Weight *w, const float *x, std::int32_t n,
+             float *y, std::int32_t o)
+  {
+    static_assert(G == 1 || G == 4 || G == 8, "Accumulators are spelled out");
+    auto a0{L::Broadcast(0.0f)}, a1{a0}, a2{a0}, a3{a0};
+    auto a4{a0}, a5{a0}, a6{a0}, a7{a0};
+    for (std::int32_t k{0}; k < n; k++)
+    {
+      auto i{_nonZero[k]};
+      auto xi{L::Broadcast(x[i])};
+      auto *row{w + std::size_t(i) * l._width};
+      a0 = L::MulAdd(xi, L::Load(row), a0);
+      if constexpr (G >= 4)
+      {
+        a1 = L::MulAdd(xi, L::Load(row + Width), a1);
+        a2 = L::MulAdd(xi, L::Load(row + 2 * Width), a2);
+        a3 = L::MulAdd(xi, L::Load(row + 3 * Width), a3);
+      }
+      if constexpr (G == 8)
+      {
+        a4 = L::MulAdd(xi, L::Load(row + 4 * Width), a4);
+        a5 = L::MulAdd(xi, L::Load(row + 5 * Width), a5);
+        a6 = L::MulAdd(xi, L::Load(row + 6 * Width), a6);
+        a7 = L::MulAdd(xi, L::Load(row + 7 * Width), a7);
+      }
+    }
+
+    auto store{[&](std::int32_t g, typename L::Vector a) {
+      auto at{o + g * Width};
+      auto v{L::MulAdd(a, L::Load(&_floats[l._scale + at]),
+                       L::Load(&_floats[l._bias + at]))};
+      L::Store(y + g * Width, l._relu ? L::Relu(v) : v);
+    }};
+    store(0, a0);
+    if constexpr (G >= 4)
+    {
+      store(1, a1);
+      store(2, a2);
+      store(3, a3);
+    }
+    if constexpr (G == 8)
+    {
+      store(4, a4);
+      store(5, a5);
+      store(6, a6);
+      store(7, a7);
+    }
+  }
+};
+
+} // namespace Tetris
+
+#endif //__TETRIS_MLP_H__
@@ -0,0 +1,250 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Memory of a simulation thread, on its own NUMA node
+
+#ifndef __TETRIS_NODE_ARENA_H__
+#define __TETRIS_NODE_ARENA_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#ifdef __linux__
+#include <fstream>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace Tetris
+{
+/// Size of a cache line; every allocation of an arena starts on one
+constexpr std::size_t CacheLine{64};
+
+/// @brief CPUs the process may run on, grouped by NUMA node
+struct Topology
+{
+  /// CPUs node after node, lowest number first
+  std::vector<std::int32_t> _cpus;
+  /// Node of each CPU of _cpus
+  std::vector<std::int32_t> _nodes;
+  /// Number of nodes with CPUs
+  std::int32_t _nodeCount{1};
+
+  /// @brief Read the topology of this machine
+  ///
+  /// On Linux it comes from sysfs and the affinity of the process. When
+  /// it is not known, all CPUs are on node 0.
+  static Topology Read()
+  {
+    Topology t;
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+      CPU_ZERO(&allowed);
+
+    t._nodeCount = 0;
+    for (std::int32_t node{0}; node < 1024; node++)
+    {
+      std::ifstream list{"/sys/devices/system/node/node" +
+                         std::to_string(node) + "/cpulist"};
+      if (!list)
+        continue;
+      // "0-3,8-11"
+      auto before{t._cpus.size()};
+      std::int32_t first{0}, last{0};
+      while (list >> first)
+      {
+        last = first;
+        if (list.peek() == '-')
+          list.ignore() >> last;
+        for (auto cpu{first}; cpu <= last; cpu++)
+          if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+          {
+            t._cpus.push_back(cpu);
+            t._nodes.push_back(node);
+          }
+        if (list.peek() == ',')
+          list.ignore();
+      }
+      t._nodeCount += t._cpus.size() > before;
+    }
+    if (!t._cpus.empty())
+      return t;
+
+    t._nodeCount = 1;
+    for (std::int32_t cpu{0}; cpu < CPU_SETSIZE; cpu++)
+      if (CPU_ISSET(cpu, &allowed))
+      {
+        t._cpus.push_back(cpu);
+        t._nodes.push_back(0);
+      }
+#endif
+    if (t._cpus.empty())
+      for (std::uint32_t cpu{0}; cpu < std::thread::hardware_concurrency();
+           cpu++)
+      {
+        t._cpus.push_back(static_cast<std::int32_t>(cpu));
+        t._nodes.push_back(0);
+      }
+    return t;
+  }
+};
+
+/// @brief Memory for the games and buffers of one simulation thread
+///
+/// The memory is taken from the system at once and handed out from the
+/// front; it is given back when the arena goes away. Every allocation is
+/// padded to whole cache lines, so objects of different arenas, or
+/// different objects of one arena, never share a line.
+///
+/// On Linux the memory prefers a NUMA node; pages go elsewhere only when
+/// the node is full. The thread that makes the arena writes every page of
+/// it, so pages are placed on the node of that thread as well when no node
+/// is given.
+class NodeArena
+{
+public:
+  /// @brief Take memory from the system
+  /// @param bytes - capacity, rounded up to whole pages
+  /// @param node - node the memory is on; -1 for the node of the calling
+  ///   thread
+  explicit NodeArena(std::size_t bytes, std::int32_t node = -1)
+      : _size{(bytes + PageSize - 1) / PageSize * PageSize}
+  {
+#ifdef __linux__
+    auto p{::mmap(nullptr, _size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+    if (p == MAP_FAILED)
+      return;
+    _base = static_cast<std::byte *>(p);
+    if (node >= 0 && node < 64)
+    {
+      // preferred, not bound: a full node falls back to another one
+      // instead of failing the page fault
+      unsigned long mask{1ul << node};
+      ::syscall(SYS_mbind, _base, _size, MPOL_PREFERRED, &mask, 64, 0);
+    }
+#else
+    (void)node;
+    _base = static_cast<std::byte *>(
+        ::operator new(_size, std::align_val_t{PageSize}, std::nothrow));
+    if (_base == nullptr)
+      return;
+#endif
+    for (std::size_t at{0}; at < _size; at += PageSize)
+      _base[at] = std::byte{0};
+  }
+
+  ~NodeArena()
+  {
+    if (_base == nullptr)
+      return;
+#ifdef __linux__
+    ::munmap(_base, _size);
+#else
+    ::operator delete(_base, std::align_val_t{PageSize});
+#endif
+  }
+
+  NodeArena(const NodeArena &) = delete;
+  void operator=(const NodeArena &) = delete;
+
+  /// Memory has been taken from the system
+  bool Ok() const { return _base != nullptr; }
+
+  /// @brief Memory aligned and padded to cache lines
+  /// @returns nullptr when the arena is full
+  void *Allocate(std::size_t bytes)
+  {
+    bytes = (bytes + CacheLine - 1) / CacheLine * CacheLine;
+    if (_base == nullptr || bytes > _size - _used)
+      return nullptr;
+    auto p{_base + _used};
+    _used += bytes;
+    return p;
+  }
+
+  /// @brief Construct an object in the arena
+  ///
+  /// Objects are never destroyed, only their memory is given back; hence
+  /// only types that need no destructor.
+  /// @returns nullptr when the arena is full
+  template <class T, class... Args>
+  T *New(Args &&...args)
+  {
+    static_assert(std::is_trivially_destructible_v<T>);
+    auto p{Allocate(sizeof(T))};
+    return p ? new (p) T(std::forward<Args>(args)...) : nullptr;
+  }
+
+  /// @brief Construct an array of objects in the arena
+  /// @param count - number of objects
+  /// @param make - make(i) returns the object at index i
+  /// @returns nullptr when the arena is full
+  template <class T, class Make>
+  T *Array(std::size_t count, Make make)
+  {
+    static_assert(std::is_trivially_destructible_v<T>);
+    static_assert(alignof(T) <= CacheLine);
+    auto p{static_cast<T *>(Allocate(count * sizeof(T)))};
+    for (std::size_t i{0}; p && i < count; i++)
+      new (p + i) T(make(i));
+    return p;
+  }
+
+  /// Bytes handed out
+  std::size_t Used() const { return _used; }
+
+  /// Bytes the arena has
+  std::size_t Capacity() const { return _size; }
+
+private:
+  static constexpr std::size_t PageSize{4096};
+
+  std::byte *_base{nullptr};
+  std::size_t _size;
+  std::size_t _used{0};
+};
+
+} // namespace Tetris
+
+#endif //__TETRIS_NODE_ARENA_H__
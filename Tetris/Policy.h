@@ -0,0 +1,108 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Interface of bots playing the game
+
+#ifndef __TETRIS_POLICY_H__
+#define __TETRIS_POLICY_H__
+
+#include "TetrisGame.h"
+#include <cstdint>
+
+namespace Tetris
+{
+/// @brief Where to put the falling figure, see Game::Place
+struct Placement
+{
+  std::int32_t _rotation;
+  ColumnIdx _col;
+};
+
+/// @brief Leftmost column a placement asks for
+///
+/// A placement gives the column of the figure's box. Blocks of a figure
+/// may start up to MaxShapeBox - 1 columns right of its box, e.g. those
+/// of a vertical bar, so for the blocks to reach column 0 the box has to
+/// reach left of the screen.
+constexpr ColumnIdx PlacementLeft{-(MaxShapeBox - 1)};
+
+/// Number of columns a placement can ask for
+constexpr std::int32_t PlacementColumns{TetrisScreen::Width() -
+                                        PlacementLeft};
+
+/// @brief Number of different placements
+///
+/// Placements that move the figure as far as a wall or blocks let it land
+/// the same way; callers that need distinct landings compare the results.
+constexpr std::int32_t Placements{Game::Rotations * PlacementColumns};
+
+/// @brief Placement by its index, 0 .. Placements - 1
+constexpr Placement PlacementAt(std::int32_t i)
+{
+  return Placement{i / PlacementColumns,
+                   i % PlacementColumns + PlacementLeft};
+}
+
+/// @brief Bot choosing a placement for every figure
+///
+/// A policy may keep scratch state between calls, so each thread plays
+/// with its own instance.
+class Policy
+{
+public:
+  virtual ~Policy() = default;
+
+  /// @brief Choose a placement of the falling figure
+  /// @param game - game that is not over
+  virtual Placement Choose(const Game &game) = 0;
+};
+
+/// @brief Play a game to its end with a policy
+/// @param game - game to play, as it is
+/// @param policy - bot choosing placements
+/// @param maxPieces - stop after so many figures even if not over
+/// @returns number of figures placed
+inline std::int64_t Play(Game &game, Policy &policy, std::int64_t maxPieces)
+{
+  std::int64_t pieces{0};
+  while (!game.Over() && pieces < maxPieces)
+  {
+    auto p{policy.Choose(game)};
+    game.Place(p._rotation, p._col);
+    pieces++;
+  }
+  return pieces;
+}
+
+} // namespace Tetris
+
+#endif //__TETRIS_POLICY_H__
@@ -51,16 +51,16 @@ using ColumnIdx = std::int32_t;
 {
  public:
   /// @brief Position is equal when row and colum are the same
-  bool operator==(const Position &rhs) const
+  constexpr bool operator==(const Position &rhs) const
   {
     return rhs._row == _row && rhs._col == _col;
   }
 
   /// @brief Position is not equal when row or column is different
-  bool operator!=(const Position &rhs) const { return !(*this == rhs); }
+  constexpr bool operator!=(const Position &rhs) const { return !(*this == rhs); }
 
   /// @brief row+row, column+column
-  Position operator+(Position p) const
+  constexpr Position operator+(Position p) const
   {
     return Position{_row + p._row, _col + p._col};
   }
@@ -0,0 +1,135 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Pseudo random numbers for the game
+
+#ifndef __TETRIS_RANDOM_H__
+#define __TETRIS_RANDOM_H__
+
+#include <cstdint>
+#ifndef TETRIS_BARE_METAL
+#include <random>
+#endif
+
+namespace Tetris
+{
+/// @brief Small, deterministic random number generator
+///
+/// `std::default_random_engine` differs between standard libraries and
+/// may be several kilobytes big. The game needs the same sequence of
+/// figures on every platform for a given seed and the generator is part
+/// of the game state that is saved and restored. Hence, this is a 32 bit
+/// xorshift generator. Its whole state is a single word.
+class Random
+{
+public:
+  Random() = default;
+
+  /// @brief Generator with a given seed
+  ///
+  /// Seed is scrambled first. Xorshift started from a small seed gives
+  /// small numbers for a while, so seeds 1, 2, 3... would start games with
+  /// the same figures.
+  /// @param seed - any value
+  explicit Random(std::uint32_t seed)
+      : _state{Scramble(seed)}
+  {
+  }
+
+  /// @brief Next raw value
+  std::uint32_t operator()()
+  {
+    _state ^= _state << 13;
+    _state ^= _state >> 17;
+    _state ^= _state << 5;
+    return _state;
+  }
+
+  /// @brief Uniform value in range [0, n)
+  ///
+  /// Multiply-shift mapping. It does not depend on the library's
+  /// distributions, so it gives the same result everywhere.
+  std::int32_t Below(std::int32_t n)
+  {
+    return static_cast<std::int32_t>(
+        (static_cast<std::uint64_t>((*this)()) * static_cast<std::uint32_t>(n))
+        >> 32);
+  }
+
+  /// @brief Whole state of the generator, e.g. to store a game
+  std::uint32_t State() const { return _state; }
+
+  /// @brief Generator that continues from a stored state
+  /// @param state - value returned by State
+  static Random FromState(std::uint32_t state)
+  {
+    Random r;
+    r._state = state != 0 ? state : DefaultSeed;
+    return r;
+  }
+
+  /// @brief Generators are equal when they produce the same sequence
+  bool operator==(const Random &r) const { return _state == r._state; }
+
+private:
+  /// Xorshift must not be seeded with zero
+  static constexpr std::uint32_t DefaultSeed{0x9E3779B9u};
+
+  /// murmur3 finalizer, a bijection that maps only zero to zero
+  static constexpr std::uint32_t Scramble(std::uint32_t x)
+  {
+    x ^= x >> 16;
+    x *= 0x85EBCA6Bu;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35u;
+    x ^= x >> 16;
+    return x != 0 ? x : DefaultSeed;
+  }
+
+  std::uint32_t _state{DefaultSeed};
+};
+
+#ifdef TETRIS_BARE_METAL
+/// @brief Source of a random seed, supplied by the application
+///
+/// A bare metal target has no std::random_device. The application defines
+/// this function, e.g. from ADC noise, a hardware RNG or the time of the
+/// first key press.
+std::uint32_t Entropy();
+#else
+/// @brief Source of a random seed
+inline std::uint32_t Entropy() { return std::random_device{}(); }
+#endif
+
+} // namespace Tetris
+
+#endif //__TETRIS_RANDOM_H__
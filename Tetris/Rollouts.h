@@ -0,0 +1,398 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Placements valued by random playouts
+///
+/// Every placement of the falling figure is played on a copy of the game,
+/// then the game goes on for a few more figures placed by a cheap policy.
+/// Lines removed, whether the game survived and the board it ended with,
+/// averaged over many such rollouts, value the placement. The figures in
+/// the preview are the game's own; figures after them are drawn from the
+/// rollout's generator, so rollouts of the same placement see different
+/// futures.
+///
+/// Rollouts of all placements are interleaved into one batch of tasks
+/// that the workers of a SimRuntime steal from each other. The batch has
+/// a time budget; when it runs out, every placement has been played about
+/// as many times as the others. A worker plays on a scratch game restored
+/// from a 32 byte Game::Packed record, with its own generator and tallies
+/// in its arena, so a rollout allocates nothing and shares no cache line.
+
+#ifndef __TETRIS_ROLLOUTS_H__
+#define __TETRIS_ROLLOUTS_H__
+
+#include "Policy.h"
+#include "Random.h"
+#include "SimRuntime.h"
+#include "TaskRange.h"
+#include "TetrisGame.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace Tetris
+{
+/// @brief How figures are placed during a rollout
+enum class RolloutPolicy : std::uint8_t
+{
+  random, ///< Any placement
+  sampled ///< Best of a few random placements, see RolloutEvaluator
+};
+
+/// @brief Value of a placement, see RolloutEvaluator
+struct RolloutValue
+{
+  /// Lines removed per rollout, by the placement and the figures after
+  double _lines;
+  /// Share of rollouts in which the game was not over at the end
+  double _survival;
+  /// Score of the board at the end of a rollout, see
+  /// RolloutEvaluator::Score; holes and a high stack cost. 0 when no
+  /// rollout was played.
+  double _board;
+  /// Rollouts played; 0 when the placement ends the game or no rollouts
+  /// were asked for
+  std::int32_t _rollouts;
+};
+
+/// @brief Result of RolloutEvaluator::Evaluate
+struct Rollouts
+{
+  /// Value of every placement, see PlacementAt
+  std::array<RolloutValue, Placements> _values;
+  /// Placement with the best value
+  Placement _best;
+  /// Rollouts played in total
+  std::int64_t _played;
+  /// Every rollout asked for was played within the budget
+  bool _complete;
+};
+
+/// @brief Parallel Monte Carlo evaluator of placements
+class RolloutEvaluator
+{
+public:
+  /// Lines a game that is over is worth less than one that goes on
+  static constexpr double LostGame{TetrisScreen::Depth()};
+  /// Random placements the 'sampled' policy chooses from
+  static constexpr std::int32_t Samples{8};
+
+  /// @param threads - workers, including the caller's thread
+  /// @param depth - figures placed after the evaluated one
+  /// @param policy - how those figures are placed
+  /// @param seed - first seed of the workers' generators
+  /// @param pin - pin workers to CPUs, see SimRuntime
+  explicit RolloutEvaluator(std::int32_t threads, std::int32_t depth = 8,
+                            RolloutPolicy policy = RolloutPolicy::sampled,
+                            std::uint32_t seed = 1, bool pin = true)
+      : _depth{depth}
+      , _policy{policy}
+      , _runtime{threads, sizeof(Worker) + CacheLine, pin}
+      , _workers(_runtime.Threads())
+  {
+    _runtime.Run([this, seed](std::int32_t w) {
+      _workers[w] = _runtime.Arena(w).New<Worker>(
+          seed + static_cast<std::uint32_t>(w));
+    });
+  }
+
+  /// @brief Value every placement of the falling figure
+  ///
+  /// @param game - game that is not over
+  /// @param rollouts - rollouts of every placement, at most
+  /// @param budget - time after which no more rollouts are started; the
+  ///   first rollout of every placement is played in any case
+  Rollouts Evaluate(const Game &game, std::int32_t rollouts,
+                    std::chrono::steady_clock::duration budget =
+                        std::chrono::milliseconds{16})
+  {
+    _deadline = std::chrono::steady_clock::now() + budget;
+    _stop.store(false, std::memory_order_relaxed);
+    _lines = game.Lines();
+    Candidates(game);
+
+    // Task t plays rollout t / count of candidate t % count
+    auto threads{_runtime.Threads()};
+    auto tasks{static_cast<std::uint64_t>(_count) * std::max(rollouts, 0)};
+    for (std::int32_t t{0}; t < threads; t++)
+    {
+      _workers[t]->_tallies.fill(Tally{});
+      _workers[t]->_tasks.Assign(
+          static_cast<std::uint32_t>(tasks * t / threads),
+          static_cast<std::uint32_t>(tasks * (t + 1) / threads));
+    }
+    auto range{[this](std::int32_t t) -> TaskRange & {
+      return _workers[t]->_tasks;
+    }};
+    // The first rollout of every candidate is played whatever the budget,
+    // so that all values are made of the same parts, see Value
+    auto play{[this](std::uint32_t task, std::int32_t w) {
+      if (task >= static_cast<std::uint32_t>(_count))
+      {
+        if (_stop.load(std::memory_order_relaxed))
+          return;
+        if (std::chrono::steady_clock::now() > _deadline)
+        {
+          _stop.store(true, std::memory_order_relaxed);
+          return;
+        }
+      }
+      Play(*_workers[w], task % _count);
+    }};
+    _runtime.Run([&](std::int32_t self) {
+      WorkOnTasks(range, self, threads, play);
+    });
+
+    Rollouts r{};
+    std::array<Tally, Placements> total{};
+    for (const auto *w : _workers)
+      for (std::int32_t c{0}; c < _count; c++)
+      {
+        total[c]._lines += w->_tallies[c]._lines;
+        total[c]._board += w->_tallies[c]._board;
+        total[c]._survived += w->_tallies[c]._survived;
+        total[c]._played += w->_tallies[c]._played;
+      }
+
+    double best{-std::numeric_limits<double>::infinity()};
+    for (std::int32_t i{0}; i < Placements; i++)
+    {
+      auto c{_candidate[i]};
+      auto &v{r._values[i]};
+      if (c < 0 || total[c]._played == 0)
+      {
+        // value of the placement alone, its board is counted by Value
+        v = RolloutValue{static_cast<double>(_cleared[i]),
+                         c < 0 ? 0.0 : 1.0, 0, 0};
+      }
+      else
+      {
+        v._rollouts = total[c]._played;
+        v._lines    = static_cast<double>(total[c]._lines) / v._rollouts;
+        v._survival = static_cast<double>(total[c]._survived) / v._rollouts;
+        v._board    = static_cast<double>(total[c]._board) / v._rollouts;
+        r._played += v._rollouts;
+      }
+      // ties go to the first placement
+      auto value{Value(v, _board[i])};
+      if (value > best)
+      {
+        best    = value;
+        r._best = PlacementAt(i);
+      }
+    }
+    r._complete = !_stop.load(std::memory_order_relaxed);
+    return r;
+  }
+
+  /// Number of workers
+  std::int32_t Threads() const { return _runtime.Threads(); }
+
+  /// @brief Value of a placement, the best one is chosen
+  ///
+  /// Rollouts are short and a cheap policy plays them, so lines and
+  /// survival alone seldom tell placements apart. The board the
+  /// placement leaves and the boards at the end of the rollouts count
+  /// too.
+  /// @param v - value found by rollouts
+  /// @param board - score of the board right after the placement
+  static double Value(const RolloutValue &v, std::int32_t board)
+  {
+    return v._lines + board + v._board - LostGame * (1 - v._survival);
+  }
+
+private:
+  /// Rollouts of a candidate played by a worker
+  struct Tally
+  {
+    std::int64_t _lines;
+    std::int64_t _board;
+    std::int32_t _survived;
+    std::int32_t _played;
+  };
+
+  /// State of a worker, in its arena
+  struct Worker
+  {
+    explicit Worker(std::uint32_t seed)
+        : _rng{seed}
+    {
+    }
+
+    TaskRange _tasks;
+    Random _rng;
+    Game _game{1};
+    std::array<Tally, Placements> _tallies{};
+  };
+
+  std::int32_t _depth;
+  RolloutPolicy _policy;
+  SimRuntime _runtime;
+  std::vector<Worker *> _workers;
+
+  /// Games after every distinct placement that does not end the game
+  std::array<Game::Packed, Placements> _candidates{};
+  std::int32_t _count{0};
+  /// Candidate of every placement, -1 when the placement ends the game
+  std::array<std::int32_t, Placements> _candidate{};
+  /// Lines removed by every placement and the score of its board
+  std::array<std::int32_t, Placements> _cleared{};
+  std::array<std::int32_t, Placements> _board{};
+  /// Lines of the evaluated game
+  std::int32_t _lines{0};
+
+  std::chrono::steady_clock::time_point _deadline;
+  std::atomic<bool> _stop{false};
+
+  /// @brief Play every placement once, on the caller's thread
+  ///
+  /// Placements often move the figure to the same place, e.g. rotations
+  /// of a square, or columns beyond a wall. Each distinct game is a
+  /// single candidate and its rollouts count for all of them.
+  void Candidates(const Game &game)
+  {
+    auto &scratch{_workers[0]->_game};
+    Game::Packed start;
+    game.Save(start);
+    _count = 0;
+    for (std::int32_t i{0}; i < Placements; i++)
+    {
+      auto p{PlacementAt(i)};
+      scratch.Restore(start);
+      auto out{scratch.Place(p._rotation, p._col)};
+      _cleared[i]   = out._cleared;
+      _board[i]     = Score(scratch);
+      _candidate[i] = -1;
+      if (scratch.Over())
+        continue;
+
+      Game::Packed after;
+      scratch.Save(after);
+      for (std::int32_t c{0}; c < _count && _candidate[i] < 0; c++)
+        if (std::memcmp(&_candidates[c], &after, sizeof(after)) == 0)
+          _candidate[i] = c;
+      if (_candidate[i] < 0)
+      {
+        _candidates[_count] = after;
+        _candidate[i]       = _count++;
+      }
+    }
+  }
+
+  /// @brief One rollout of a candidate
+  void Play(Worker &w, std::int32_t candidate)
+  {
+    auto start{_candidates[candidate]};
+    // figures after the preview come from the worker's generator
+    start._rng = w._rng() | 1;
+    auto &game{w._game};
+    game.Restore(start);
+    for (std::int32_t d{0}; d < _depth && !game.Over(); d++)
+      if (_policy == RolloutPolicy::random)
+      {
+        auto p{PlacementAt(w._rng.Below(Placements))};
+        game.Place(p._rotation, p._col);
+      }
+      else
+        PlaceSampled(w);
+
+    auto &t{w._tallies[candidate]};
+    t._lines += game.Lines() - _lines;
+    t._board += Score(game);
+    t._survived += !game.Over();
+    t._played++;
+  }
+
+  /// @brief Score of the landed blocks, at most 0
+  ///
+  /// A hole costs 4, a row of the stack's height costs 1; the weights
+  /// are this file's own. Rows are read as bit masks.
+  static std::int32_t Score(const Game &game)
+  {
+    auto landed{game.Landed()};
+    std::uint32_t covered{0};
+    std::int32_t holes{0}, height{0};
+    for (std::int32_t r{0}; r < TetrisScreen::Depth(); r++)
+    {
+      auto row{LineMask(landed.Lines()[r])};
+      if (row != 0 && height == 0)
+        height = TetrisScreen::Depth() - r;
+      holes += std::popcount(covered & ~row);
+      covered |= row;
+    }
+    return -4 * holes - height;
+  }
+
+  /// @brief Place the figure at the best of a few random placements
+  ///
+  /// Placements that remove more lines are better, then those that land
+  /// the figure lower; one that ends the game is the worst.
+  static void PlaceSampled(Worker &w)
+  {
+    auto &game{w._game};
+    auto state{game.Save()};
+    Placement best{};
+    std::int32_t bestScore{std::numeric_limits<std::int32_t>::min()};
+    bool last{false};
+    for (std::int32_t i{0}; i < Samples; i++)
+    {
+      auto p{PlacementAt(w._rng.Below(Placements))};
+      if (i > 0)
+        game.Restore(state);
+      auto out{game.Place(p._rotation, p._col)};
+      auto score{game.Over() ? std::numeric_limits<std::int32_t>::min() + 1
+                             : out._cleared + Score(game)};
+      last = score > bestScore;
+      if (last)
+      {
+        best      = p;
+        bestScore = score;
+      }
+    }
+    // the game is already there when the last sample was the best
+    if (!last)
+    {
+      game.Restore(state);
+      game.Place(best._rotation, best._col);
+    }
+  }
+};
+
+} // namespace Tetris
+
+#endif //__TETRIS_ROLLOUTS_H__
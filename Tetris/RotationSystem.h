@@ -0,0 +1,132 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Wall kicks tried when a figure rotates
+
+#ifndef __TETRIS_ROTATION_SYSTEM_H__
+#define __TETRIS_ROTATION_SYSTEM_H__
+
+#include "Position.h"
+#include <array>
+#include <cstdint>
+
+namespace Tetris
+{
+/// @brief How a figure rotates when the rotated blocks collide
+enum class RotationSystem : std::uint8_t
+{
+  none, ///< Rotation fails, the figure stays as it was
+  srs   ///< Super Rotation System: figure is moved by one of a few kicks
+};
+
+/// @brief Offsets tried, in order, when rotating from each rotation
+///
+/// The first offset that fits wins. Transitions are indexed by
+/// KickTransition. Positions are in rows and columns, so 'up' is a
+/// negative row.
+struct KickTable
+{
+  static constexpr std::int32_t MaxTests{5};
+  static constexpr std::int32_t Transitions{8};
+
+  std::int32_t _tests;
+  std::array<std::array<Position, MaxTests>, Transitions> _kicks;
+};
+
+/// @brief Index of a transition in KickTable
+/// @param from - rotation the figure starts from, 0 .. 3
+/// @param clockwise - rotation to the right
+constexpr std::int32_t KickTransition(std::int32_t from, bool clockwise)
+{
+  return from * 2 + (clockwise ? 0 : 1);
+}
+
+namespace Kicks
+{
+/// @brief Convert a table written in SRS coordinates
+///
+/// SRS tables are written as (x, y) with y going up, for transitions
+/// 0->R, 0->L, R->2, R->0, 2->L, 2->R, L->0, L->2 in this order.
+constexpr KickTable FromSrs(const std::int32_t (&xy)[8][5][2])
+{
+  KickTable t{KickTable::MaxTests, {}};
+  for (std::int32_t i{0}; i < KickTable::Transitions; i++)
+    for (std::int32_t k{0}; k < KickTable::MaxTests; k++)
+      t._kicks[i][k] = Position{-xy[i][k][1], xy[i][k][0]};
+  return t;
+}
+
+// clang-format off
+/// J, L, S, T, Z and other figures rotating in a 3x3 box
+constexpr std::int32_t Srs3[8][5][2]{
+  {{0, 0}, {-1, 0}, {-1, +1}, {0, -2}, {-1, -2}}, // 0->R
+  {{0, 0}, {+1, 0}, {+1, +1}, {0, -2}, {+1, -2}}, // 0->L
+  {{0, 0}, {+1, 0}, {+1, -1}, {0, +2}, {+1, +2}}, // R->2
+  {{0, 0}, {+1, 0}, {+1, -1}, {0, +2}, {+1, +2}}, // R->0
+  {{0, 0}, {+1, 0}, {+1, +1}, {0, -2}, {+1, -2}}, // 2->L
+  {{0, 0}, {-1, 0}, {-1, +1}, {0, -2}, {-1, -2}}, // 2->R
+  {{0, 0}, {-1, 0}, {-1, -1}, {0, +2}, {-1, +2}}, // L->0
+  {{0, 0}, {-1, 0}, {-1, -1}, {0, +2}, {-1, +2}}, // L->2
+};
+
+/// I rotating in a 4x4 box
+constexpr std::int32_t Srs4[8][5][2]{
+  {{0, 0}, {-2, 0}, {+1, 0}, {-2, -1}, {+1, +2}}, // 0->R
+  {{0, 0}, {-1, 0}, {+2, 0}, {-1, +2}, {+2, -1}}, // 0->L
+  {{0, 0}, {-1, 0}, {+2, 0}, {-1, +2}, {+2, -1}}, // R->2
+  {{0, 0}, {+2, 0}, {-1, 0}, {+2, +1}, {-1, -2}}, // R->0
+  {{0, 0}, {+2, 0}, {-1, 0}, {+2, +1}, {-1, -2}}, // 2->L
+  {{0, 0}, {+1, 0}, {-2, 0}, {+1, -2}, {-2, +1}}, // 2->R
+  {{0, 0}, {+1, 0}, {-2, 0}, {+1, -2}, {-2, +1}}, // L->0
+  {{0, 0}, {-2, 0}, {+1, 0}, {-2, -1}, {+1, +2}}, // L->2
+};
+// clang-format on
+
+/// Only the rotation in place is tried
+constexpr KickTable None{1, {}};
+constexpr KickTable Srs3x3{FromSrs(Srs3)};
+constexpr KickTable Srs4x4{FromSrs(Srs4)};
+} // namespace Kicks
+
+/// @brief Kicks of a figure
+/// @param system - rotation system of the game
+/// @param box - size of the box the figure rotates in, see Shape
+constexpr const KickTable &KicksOf(RotationSystem system, std::int32_t box)
+{
+  if (system != RotationSystem::srs || box < 3)
+    return Kicks::None;
+  return box == 3 ? Kicks::Srs3x3 : Kicks::Srs4x4;
+}
+
+} // namespace Tetris
+
+#endif //__TETRIS_ROTATION_SYSTEM_H__
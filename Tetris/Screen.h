@@ -35,6 +35,7 @@
 #ifndef __TETRIS_SCREEN_H__
 #define __TETRIS_SCREEN_H__
 
+#include "Block.h"
 #include "Position.h"
 #include <algorithm>
 #include <array>
@@ -74,6 +75,22 @@ bool IsLineFull(const SingleLineType &line)
   return true;
 }
 
+/// @brief Line as a bit mask
+///
+/// Bit N is set when block in column N is not empty.
+///
+/// @tparem SingleLineType - type of the line
+/// @param line - line to convert
+template <class SingleLineType>
+std::uint32_t LineMask(const SingleLineType &line)
+{
+  std::uint32_t mask{0};
+  for (std::uint32_t i{0}; i < line.size(); i++)
+    if (line[i] != Colour::background)
+      mask |= 1u << i;
+  return mask;
+}
+
 /// @brief Remove full lines from the screen
 ///
 /// Search for the full lines. It starts from the bottom.
@@ -85,8 +102,12 @@ bool IsLineFull(const SingleLineType &line)
 ///   [REQ_LineFull](https://github.com/grygorek/TetrisArch#REQ_LineFull)
 /// 
 /// @param lines - collection of lines
+/// @param removed - if given, bit N is set when line N was removed; lines
+///   are numbered as they were before any was removed
+/// @returns number of removed lines
 template <class CollectionType>
-void RemoveFullLines(CollectionType &lines)
+std::int32_t RemoveFullLines(CollectionType &lines,
+                             std::uint32_t *removed = nullptr)
 {
   auto move{[&lines](std::int32_t count) mutable {
     for (auto i{count}; i > 0; i--)
@@ -96,12 +117,43 @@ void RemoveFullLines(CollectionType &lines)
     lines[0].fill(Colour::background);
   }};
 
+  std::int32_t count{0};
   std::int32_t size = lines.size(); // changing type
   for (auto i{1}; i < size; i++)
     if (IsLineFull(lines[i]))
+    {
       /// Satisfies requirements:
       ///   [REQ_BlocksDrop](https://github.com/grygorek/TetrisArch#REQ_BlocksDrop)
       move(i);
+      count++;
+      if (removed)
+        *removed |= 1u << i;
+    }
+  return count;
+}
+
+/// @brief Push garbage lines from the bottom of the screen
+///
+/// Used in a versus game. All lines are moved up by `count`. Lines
+/// that go above the top are lost. The bottom `count` lines are
+/// filled in except a single hole in `hole` column.
+///
+/// @param lines - collection of lines
+/// @param count - number of garbage lines to insert
+/// @param hole - column left empty in each garbage line
+template <class CollectionType>
+void PushGarbageLines(CollectionType &lines, std::int32_t count,
+                      ColumnIdx hole)
+{
+  std::int32_t size = lines.size(); // changing type
+  count             = std::min(count, size);
+  for (auto i{0}; i < size - count; i++)
+    lines[i] = lines[i + count];
+  for (auto i{size - count}; i < size; i++)
+  {
+    lines[i].fill(Colour::red);
+    lines[i][hole] = Colour::background;
+  }
 }
 
 
@@ -142,7 +194,21 @@ public:
   /// @brief Search for full lines and remove them.
   /// Satisfies requirements:
   ///   [REQ_LineFull](https://github.com/grygorek/TetrisArch#REQ_LineFull)
-  void RemoveFullLines() { Tetris::RemoveFullLines(_lines); }
+  /// @param removed - if given, rows removed, see Tetris::RemoveFullLines
+  /// @returns number of removed lines
+  std::int32_t RemoveFullLines(std::uint32_t *removed = nullptr)
+  {
+    return Tetris::RemoveFullLines(_lines, removed);
+  }
+
+  /// @brief Insert garbage lines at the bottom. See Tetris::PushGarbageLines
+  void PushGarbageLines(std::int32_t count, ColumnIdx hole)
+  {
+    Tetris::PushGarbageLines(_lines, count, hole);
+  }
+
+  /// Read only access to all lines
+  const auto &Lines() const { return _lines; }
 
 private:
   /// Screen is made of lines
@@ -0,0 +1,257 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Compile time description of figures
+///
+/// A figure is drawn as text, the same way as in README:
+///
+///     Shape<".X.\n"
+///           "XXX\n"
+///           "...">
+///
+/// `X` is a block, any other character is empty and rows are separated by
+/// a new line. Everything else - rotations, offsets of blocks, bounding
+/// boxes and profiles - is computed by the compiler.
+
+#ifndef __TETRIS_SHAPE_H__
+#define __TETRIS_SHAPE_H__
+
+#include "Position.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace Tetris
+{
+/// @brief Text of a shape, usable as a template argument
+template <std::size_t N>
+struct ShapeArt
+{
+  constexpr ShapeArt(const char (&text)[N])
+  {
+    for (std::size_t i{0}; i < N; i++)
+      _text[i] = text[i];
+  }
+
+  /// Number of blocks
+  constexpr std::int32_t Blocks() const
+  {
+    std::int32_t n{0};
+    for (auto c : _text)
+      n += c == 'X';
+    return n;
+  }
+
+  /// Size of the square the shape rotates in
+  constexpr std::int32_t Box() const
+  {
+    std::int32_t rows{1};
+    std::int32_t cols{0};
+    std::int32_t col{0};
+    for (std::size_t i{0}; i + 1 < N; i++)
+    {
+      if (_text[i] == '\n')
+      {
+        rows++;
+        col = 0;
+      }
+      else if (++col > cols)
+        cols = col;
+    }
+    return rows > cols ? rows : cols;
+  }
+
+  char _text[N]{};
+};
+
+/// Largest box of a shape
+constexpr std::int32_t MaxShapeBox{4};
+
+/// @brief Everything known about a shape
+///
+/// Rotation 0 is the shape as drawn. Each next rotation is the previous
+/// one turned clockwise inside the shape's box, so the figure turns around
+/// the centre of the box. There are always four rotations; `Distinct`
+/// tells how many of them differ in shape.
+template <ShapeArt Art>
+class Shape
+{
+public:
+  /// Number of blocks of the shape
+  static constexpr std::int32_t Blocks{Art.Blocks()};
+  /// Size of the square box the shape rotates in
+  static constexpr std::int32_t Box{Art.Box()};
+  /// Number of rotations, some may be the same
+  static constexpr std::int32_t Rotations{4};
+
+  static_assert(Blocks > 0, "Shape needs at least one block");
+  static_assert(Box <= MaxShapeBox, "Shape is too big");
+
+  /// @brief Single rotation of the shape
+  ///
+  /// All positions are relative to the top left corner of the box.
+  /// Profiles have -1 where a column or a row has no blocks.
+  struct Rotation
+  {
+    /// Blocks, sorted by row then column
+    std::array<Position, Blocks> _offsets;
+    /// Top left and bottom right corner of the bounding box
+    Position _min;
+    Position _max;
+    /// Lowest row with a block in each column
+    std::array<std::int8_t, MaxShapeBox> _bottom;
+    /// Leftmost and rightmost column with a block in each row
+    std::array<std::int8_t, MaxShapeBox> _left;
+    std::array<std::int8_t, MaxShapeBox> _right;
+    /// Blocks of each row, bit N is column N
+    std::array<std::uint8_t, MaxShapeBox> _rows;
+  };
+
+private:
+  static constexpr std::array<Position, Blocks> Parse()
+  {
+    std::array<Position, Blocks> blocks{};
+    std::int32_t n{0};
+    Position p{0, 0};
+    for (auto c : Art._text)
+    {
+      if (c == '\n')
+        p = Position{p._row + 1, 0};
+      else
+      {
+        if (c == 'X')
+          blocks[n++] = p;
+        p._col++;
+      }
+    }
+    return blocks;
+  }
+
+  static constexpr void Sort(std::array<Position, Blocks> &blocks)
+  {
+    for (std::int32_t i{1}; i < Blocks; i++)
+      for (std::int32_t j{i}; j > 0; j--)
+      {
+        auto &a{blocks[j - 1]};
+        auto &b{blocks[j]};
+        if (a._row < b._row || (a._row == b._row && a._col <= b._col))
+          break;
+        auto t{a};
+        a = b;
+        b = t;
+      }
+  }
+
+  static constexpr Rotation Describe(const std::array<Position, Blocks> &b)
+  {
+    Rotation r{};
+    r._offsets = b;
+    Sort(r._offsets);
+    r._min = Position{Box, Box};
+    r._max = Position{-1, -1};
+    for (std::int32_t i{0}; i < MaxShapeBox; i++)
+      r._bottom[i] = r._left[i] = r._right[i] = -1;
+
+    for (auto p : r._offsets)
+    {
+      r._min._row = p._row < r._min._row ? p._row : r._min._row;
+      r._min._col = p._col < r._min._col ? p._col : r._min._col;
+      r._max._row = p._row > r._max._row ? p._row : r._max._row;
+      r._max._col = p._col > r._max._col ? p._col : r._max._col;
+      if (p._row > r._bottom[p._col])
+        r._bottom[p._col] = static_cast<std::int8_t>(p._row);
+      if (r._left[p._row] < 0 || p._col < r._left[p._row])
+        r._left[p._row] = static_cast<std::int8_t>(p._col);
+      if (p._col > r._right[p._row])
+        r._right[p._row] = static_cast<std::int8_t>(p._col);
+      r._rows[p._row] |= static_cast<std::uint8_t>(1u << p._col);
+    }
+    return r;
+  }
+
+  static constexpr std::array<Rotation, Rotations> Generate()
+  {
+    std::array<Rotation, Rotations> table{};
+    auto blocks{Parse()};
+    for (auto &r : table)
+    {
+      r = Describe(blocks);
+      // clockwise: row becomes column, column becomes row from the bottom
+      for (auto &p : blocks)
+        p = Position{p._col, Box - 1 - p._row};
+    }
+    return table;
+  }
+
+  /// Same shape, wherever it is in the box
+  static constexpr bool Same(const Rotation &a, const Rotation &b)
+  {
+    for (std::int32_t i{0}; i < Blocks; i++)
+    {
+      Position pa{a._offsets[i]._row - a._min._row,
+                  a._offsets[i]._col - a._min._col};
+      Position pb{b._offsets[i]._row - b._min._row,
+                  b._offsets[i]._col - b._min._col};
+      if (pa != pb)
+        return false;
+    }
+    return true;
+  }
+
+  static constexpr std::array<bool, Rotations> FindFirst()
+  {
+    std::array<bool, Rotations> first{};
+    for (std::int32_t i{0}; i < Rotations; i++)
+    {
+      first[i] = true;
+      for (std::int32_t j{0}; j < i; j++)
+        if (Same(Generate()[i], Generate()[j]))
+          first[i] = false;
+    }
+    return first;
+  }
+
+public:
+  /// All rotations
+  static constexpr std::array<Rotation, Rotations> Table{Generate()};
+
+  /// Rotation differs from all rotations before it
+  static constexpr std::array<bool, Rotations> First{FindFirst()};
+
+  /// Number of rotations that differ in shape
+  static constexpr std::int32_t Distinct{First[0] + First[1] + First[2] +
+                                         First[3]};
+};
+
+} // namespace Tetris
+
+#endif //__TETRIS_SHAPE_H__
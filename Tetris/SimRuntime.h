@@ -0,0 +1,252 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Pinned simulation threads with memory on their own node
+
+#ifndef __TETRIS_SIM_RUNTIME_H__
+#define __TETRIS_SIM_RUNTIME_H__
+
+#include "NodeArena.h"
+#include <barrier>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace Tetris
+{
+/// @brief Reads of memory served by NUMA nodes, from performance counters
+struct NodeTraffic
+{
+  /// Counters could be read; the machine and the system allow it
+  bool _available{false};
+  /// Reads served by memory of any node
+  std::uint64_t _loads{0};
+  /// Reads served by memory of another node than the reading CPU's
+  std::uint64_t _remote{0};
+};
+
+/// @brief Threads stepping a batch of simulations
+///
+/// Worker 0 is the caller's thread; other workers are started once and
+/// wait at a barrier between calls of Run, so a call does not create
+/// threads or allocate. Workers are pinned to CPUs, one node filled
+/// before the next, so the first workers share a socket. Every worker has
+/// a NodeArena made by the worker itself on its node: games and buffers
+/// a worker steps should be taken from it, so they are near the worker's
+/// CPU and no cache line is shared with another worker.
+///
+/// On Linux, every worker counts the reads it makes from memory of its own
+/// and of other nodes, when the CPU and perf_event_paranoid allow it.
+/// Counts of worker 0 include everything the caller's thread does.
+class SimRuntime
+{
+public:
+  /// @brief Start the workers and make their arenas
+  /// @param threads - number of workers, including the caller's thread
+  /// @param arenaBytes - size of the arena of every worker
+  /// @param pin - pin workers other than the caller's to CPUs
+  SimRuntime(std::int32_t threads, std::size_t arenaBytes, bool pin = true)
+      : _start{threads}
+      , _done{threads}
+  {
+    auto topology{Topology::Read()};
+    for (std::int32_t w{0}; w < threads; w++)
+    {
+      _workers.push_back(std::make_unique<Worker>());
+      if (!pin || w == 0)
+        continue;
+      auto at{static_cast<std::size_t>(w) % topology._cpus.size()};
+      _workers[w]->_cpu  = topology._cpus[at];
+      _workers[w]->_node = topology._nodes[at];
+    }
+
+    Prepare(*_workers[0], arenaBytes);
+    for (std::int32_t w{1}; w < threads; w++)
+      _threads.emplace_back([this, w, arenaBytes] {
+        Prepare(*_workers[w], arenaBytes);
+        Work(w);
+      });
+    // arenas are ready when every worker has come to the first barrier
+    _done.arrive_and_wait();
+  }
+
+  ~SimRuntime()
+  {
+    _stop = true;
+    if (!_threads.empty())
+      _start.arrive_and_wait();
+    for (auto &t : _threads)
+      t.join();
+#ifdef __linux__
+    for (auto &w : _workers)
+      for (auto fd : {w->_loads, w->_remote})
+        if (fd >= 0)
+          ::close(fd);
+#endif
+  }
+
+  SimRuntime(const SimRuntime &) = delete;
+  void operator=(const SimRuntime &) = delete;
+
+  /// Number of workers
+  std::int32_t Threads() const
+  {
+    return static_cast<std::int32_t>(_workers.size());
+  }
+
+  /// Arena of a worker
+  NodeArena &Arena(std::int32_t worker) { return *_workers[worker]->_arena; }
+
+  /// NUMA node a worker is pinned to, -1 when it is not pinned
+  std::int32_t Node(std::int32_t worker) const
+  {
+    return _workers[worker]->_node;
+  }
+
+  /// @brief Call f(worker) on every worker and wait until all return
+  template <class F>
+  void Run(F &&f)
+  {
+    using Job = std::remove_reference_t<F>;
+    _job     = [](void *f, std::int32_t w) { (*static_cast<Job *>(f))(w); };
+    _context = &f;
+    if (_threads.empty())
+      return f(0);
+
+    _start.arrive_and_wait();
+    f(0);
+    _done.arrive_and_wait();
+  }
+
+  /// Reads counted by all workers since they started
+  NodeTraffic Traffic() const
+  {
+    NodeTraffic t;
+#ifdef __linux__
+    t._available = true;
+    for (const auto &w : _workers)
+    {
+      std::uint64_t loads{0}, remote{0};
+      t._available = t._available &&
+                     ::read(w->_loads, &loads, sizeof(loads)) ==
+                         sizeof(loads) &&
+                     ::read(w->_remote, &remote, sizeof(remote)) ==
+                         sizeof(remote);
+      t._loads += loads;
+      t._remote += remote;
+    }
+#endif
+    return t;
+  }
+
+private:
+  struct Worker
+  {
+    std::int32_t _cpu{-1};
+    std::int32_t _node{-1};
+    std::optional<NodeArena> _arena;
+    /// Performance counters of the worker's thread
+    int _loads{-1};
+    int _remote{-1};
+  };
+
+  std::vector<std::unique_ptr<Worker>> _workers;
+  std::barrier<> _start;
+  std::barrier<> _done;
+  bool _stop{false};
+  std::vector<std::thread> _threads;
+
+  /// Current job of Run
+  void (*_job)(void *, std::int32_t){nullptr};
+  void *_context{nullptr};
+
+  /// Pin the calling thread, make its arena and open its counters
+  static void Prepare(Worker &w, std::size_t arenaBytes)
+  {
+#ifdef __linux__
+    if (w._cpu >= 0)
+    {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(w._cpu, &cpus);
+      pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+    w._loads  = OpenCounter(PERF_COUNT_HW_CACHE_RESULT_ACCESS);
+    w._remote = OpenCounter(PERF_COUNT_HW_CACHE_RESULT_MISS);
+#endif
+    // after pinning, so pages are written from the worker's node
+    w._arena.emplace(arenaBytes, w._node);
+  }
+
+#ifdef __linux__
+  /// @brief Count reads of memory of the calling thread
+  /// @param result - all reads, or misses of the local node
+  static int OpenCounter(std::uint64_t result)
+  {
+    perf_event_attr a{};
+    a.type           = PERF_TYPE_HW_CACHE;
+    a.size           = sizeof(a);
+    a.config         = PERF_COUNT_HW_CACHE_NODE |
+                       PERF_COUNT_HW_CACHE_OP_READ << 8 | result << 16;
+    a.exclude_kernel = 1;
+    a.exclude_hv     = 1;
+    return static_cast<int>(
+        ::syscall(SYS_perf_event_open, &a, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+  }
+#endif
+
+  void Work(std::int32_t w)
+  {
+    _done.arrive_and_wait();
+    for (;;)
+    {
+      _start.arrive_and_wait();
+      if (_stop)
+        return;
+      _job(_context, w);
+      _done.arrive_and_wait();
+    }
+  }
+};
+
+} // namespace Tetris
+
+#endif //__TETRIS_SIM_RUNTIME_H__
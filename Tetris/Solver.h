@@ -0,0 +1,543 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Exhaustive search for perfect clears
+///
+/// Given a board and the figures that will fall on it, the solver finds
+/// placements that leave the board empty, with the fewest figures and,
+/// among those, the fewest commands.
+///
+/// Figures land exactly like Game::Place moves them, so the commands of a
+/// solution given to a game with the same board and figures clear it.
+/// The search is depth first over placements, for one number of figures
+/// at a time:
+/// - the number of blocks must be a multiple of the screen width, or the
+///   board cannot be empty after that many figures,
+/// - every line with blocks has to be removed, so the stack must not be
+///   higher than the number of lines the remaining blocks can fill,
+/// - boards already reached with as few commands are not searched again.
+///   They are kept in a lock-free table of hashes.
+/// The first two levels of the tree are split into tasks that threads
+/// steal from each other.
+
+#ifndef __TETRIS_SOLVER_H__
+#define __TETRIS_SOLVER_H__
+
+#include "Command.h"
+#include "Policy.h"
+#include "TaskRange.h"
+#include "TetrisGame.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <span>
+#include <vector>
+
+namespace Tetris
+{
+/// @brief How a search has ended
+enum class SolveStatus : std::uint8_t
+{
+  solved,     ///< Shortest solution found
+  unsolvable, ///< No placements clear the board
+  cancelled   ///< Cancelled or out of time before the search completed
+};
+
+/// @brief Result of PerfectClearSolver::Solve
+struct Solution
+{
+  SolveStatus _status;
+  /// Placement of each figure used. When cancelled, the best solution
+  /// found so far, if any.
+  std::vector<Placement> _placements;
+  /// The same placements as commands, only those that move the figure
+  std::vector<Command> _commands;
+  /// Boards searched
+  std::int64_t _nodes;
+};
+
+/// @brief Parallel perfect clear solver
+class PerfectClearSolver
+{
+public:
+  /// Most figures a solution can use
+  static constexpr std::int32_t MaxFigures{16};
+
+  /// @param threads - threads searching, at least 1
+  /// @param tableBits - log2 of the number of boards remembered
+  explicit PerfectClearSolver(std::int32_t threads,
+                              std::int32_t tableBits = 20)
+      : _threads{threads}
+      , _tableBits{tableBits}
+      , _table(std::size_t{1} << tableBits)
+  {
+  }
+
+  /// @brief Find the shortest way to clear the board
+  ///
+  /// Solutions use at least one figure, also when the board is empty.
+  ///
+  /// @param board - landed blocks, without a falling figure
+  /// @param figures - kinds of figures in the order they fall, the
+  ///   current one first. See AnyFigure::Make. Only the first MaxFigures
+  ///   are used; figures after them are ignored.
+  /// @param rotation - kicks tried when a figure rotates
+  /// @param limit - time after which the search is cancelled
+  Solution Solve(const TetrisScreen &board,
+                 std::span<const std::uint8_t> figures,
+                 RotationSystem rotation,
+                 std::chrono::steady_clock::duration limit =
+                     std::chrono::hours{1})
+  {
+    _stop.store(false, std::memory_order_relaxed);
+    _deadline = std::chrono::steady_clock::now() + limit;
+    _rotation = rotation;
+    _nodes.store(0, std::memory_order_relaxed);
+    for (auto &e : _table)
+      e.store(0, std::memory_order_relaxed);
+
+    auto count{std::min<std::int32_t>(figures.size(), MaxFigures)};
+    std::copy_n(figures.begin(), count, _figures.begin());
+    // blocks[i] - blocks of the first i figures
+    std::array<std::int32_t, MaxFigures + 1> blocks{};
+    for (std::int32_t i{0}; i < count; i++)
+      blocks[i + 1] =
+          blocks[i] + AnyFigure::Make(_figures[i], Game::Spawn)->BlocksCount();
+
+    Solution s{SolveStatus::unsolvable, {}, {}, 0};
+    for (_target = 1; _target <= count; _target++)
+    {
+      if ((Blocks(board) + blocks[_target]) % TetrisScreen::Width() != 0)
+        continue;
+      _granularity[_target] = 0;
+      _balances[_target]    = Balances{}.set(MaxImbalance);
+      for (auto i{_target}; i >= 0; i--)
+      {
+        _blocks[i] = blocks[_target] - blocks[i];
+        if (i == _target)
+          continue;
+        _granularity[i] =
+            std::gcd(_granularity[i + 1], blocks[i + 1] - blocks[i]);
+        _balances[i].reset();
+        for (auto d : ColumnImbalances(_figures[i]))
+          _balances[i] |= d < 0 ? _balances[i + 1] >> -d
+                                : _balances[i + 1] << d;
+      }
+
+      _best.store(std::numeric_limits<std::int32_t>::max(),
+                  std::memory_order_relaxed);
+      _path.clear();
+      SolveTarget(board);
+
+      if (!_path.empty() || _stop.load(std::memory_order_relaxed))
+      {
+        s._status = _stop.load(std::memory_order_relaxed)
+                        ? SolveStatus::cancelled
+                        : SolveStatus::solved;
+        break;
+      }
+    }
+
+    s._placements = _path;
+    s._nodes      = _nodes.load(std::memory_order_relaxed);
+    auto replay{board};
+    for (std::size_t i{0}; i < s._placements.size(); i++)
+      Land(replay, static_cast<std::int32_t>(i), s._placements[i],
+           &s._commands);
+    return s;
+  }
+
+  /// @brief Stop a search running on another thread
+  void Cancel() { _stop.store(true, std::memory_order_relaxed); }
+
+  /// @brief Let a figure fall the way Game::Place moves it
+  ///
+  /// Rotations and moves that are blocked are skipped. Full lines are
+  /// removed.
+  ///
+  /// @param board - landed blocks, the figure lands on it
+  /// @param kind - kind of the figure
+  /// @param p - where to put the figure
+  /// @param rotation - kicks tried when the figure rotates
+  /// @param commands - when given, commands that moved the figure are
+  ///   added to it
+  /// @returns number of commands that moved the figure, 0 when the figure
+  ///   had no place on the board to appear at
+  static std::int32_t Land(TetrisScreen &board, std::uint8_t kind,
+                           Placement p, RotationSystem rotation,
+                           std::vector<Command> *commands = nullptr)
+  {
+    AnyFigure figure;
+    auto count{Steer(board, kind, p, rotation, figure, commands)};
+    if (count < 0)
+      return 0;
+    return count + Drop(board, figure, commands);
+  }
+
+private:
+  /// Levels of the tree split into tasks
+  static constexpr std::int32_t SplitLevels{2};
+
+  using Masks = std::array<std::uint32_t, TetrisScreen::Depth()>;
+
+  /// Blocks in even columns less blocks in odd columns, at most
+  static constexpr std::int32_t MaxImbalance{MaxFigures * MaxShapeBox};
+  /// Bit MaxImbalance + N is set when imbalance N can be reached
+  using Balances = std::bitset<2 * MaxImbalance + 1>;
+  static_assert(TetrisScreen::Width() % 2 == 0);
+
+  /// @brief State of a thread's search
+  struct Worker
+  {
+    std::array<Placement, MaxFigures> _path;
+    std::int64_t _nodes;
+  };
+
+  /// @brief Rotate and move a new figure, the first part of Land
+  /// @returns number of commands, -1 when the figure has no place to
+  ///   appear at
+  static std::int32_t Steer(TetrisScreen &board, std::uint8_t kind,
+                            Placement p, RotationSystem rotation,
+                            AnyFigure &figure,
+                            std::vector<Command> *commands = nullptr)
+  {
+    figure = AnyFigure::Make(kind, Game::Spawn);
+    if (!figure->Translate(board, Position{0, 0}))
+      return -1;
+
+    std::int32_t count{0};
+    auto moved{[&](bool ok, Command cmd) {
+      if (ok && commands)
+        commands->push_back(cmd);
+      count += ok;
+      return ok;
+    }};
+
+    for (std::int32_t i{0}; i < p._rotation; i++)
+      moved(figure->Rotate(board, Direction::right, rotation),
+            Command::RotateRight);
+
+    auto shift{p._col - figure->Pos()._col};
+    Direction d{shift < 0 ? Direction::left : Direction::right};
+    auto cmd{shift < 0 ? Command::TranslateLeft : Command::TranslateRigth};
+    for (std::int32_t i{0}; i < shift * d; i++)
+      if (!moved(figure->Translate(board, Position{0, d}), cmd))
+        break;
+    return count;
+  }
+
+  /// @brief Drop a steered figure and remove full lines, the second part
+  ///   of Land
+  /// @returns number of commands
+  static std::int32_t Drop(TetrisScreen &board, AnyFigure &figure,
+                           std::vector<Command> *commands = nullptr)
+  {
+    // one 'down' more lands the figure
+    auto count{figure->Fall(board) + 1};
+    if (commands)
+      commands->insert(commands->end(), count, Command::TranslateDown);
+    figure->Draw(board, DrawMode::draw);
+    board.RemoveFullLines();
+    return count;
+  }
+
+  std::int32_t Land(TetrisScreen &board, std::int32_t depth, Placement p,
+                    std::vector<Command> *commands = nullptr) const
+  {
+    return Land(board, _figures[depth], p, _rotation, commands);
+  }
+
+  /// Search for the current target, in parallel
+  void SolveTarget(const TetrisScreen &board)
+  {
+    // Task t places the first figures at digits of t in base Placements
+    auto levels{std::min(_target, SplitLevels)};
+    std::uint32_t tasks{1};
+    for (std::int32_t i{0}; i < levels; i++)
+      tasks *= Placements;
+
+    RunTasks(tasks, _threads, [&](std::uint32_t task, std::int32_t) {
+      if (_stop.load(std::memory_order_relaxed))
+        return;
+
+      Worker w{{}, 0};
+      auto b{board};
+      std::int32_t cost{0};
+      for (std::int32_t depth{0}; depth < levels; depth++, task /= Placements)
+      {
+        w._path[depth] = PlacementAt(task % Placements);
+        auto c{Land(b, depth, w._path[depth])};
+        if (c == 0)
+          return;
+        cost += c;
+      }
+      Search(w, b, levels, cost);
+      _nodes.fetch_add(w._nodes, std::memory_order_relaxed);
+    });
+  }
+
+  void Search(Worker &w, const TetrisScreen &board, std::int32_t depth,
+              std::int32_t cost)
+  {
+    if ((++w._nodes & 0xFFF) == 0 &&
+        std::chrono::steady_clock::now() > _deadline)
+      Cancel();
+    if (_stop.load(std::memory_order_relaxed))
+      return;
+
+    Masks rows;
+    std::int32_t blocks{0};
+    for (std::int32_t r{0}; r < TetrisScreen::Depth(); r++)
+    {
+      rows[r] = LineMask(board.Lines()[r]);
+      blocks += std::popcount(rows[r]);
+    }
+
+    if (depth == _target)
+    {
+      if (blocks == 0)
+        Record(w, cost);
+      return;
+    }
+
+    // every figure takes at least one command
+    if (cost + _target - depth >= _best.load(std::memory_order_relaxed))
+      return;
+    if (!Fits(rows, blocks, depth) || !Visit(Hash(rows, depth), cost))
+      return;
+
+    // Placements that steer the figure to the same place land it the
+    // same way, only the first one is searched
+    std::array<Position, Placements> steered;
+    std::array<std::int32_t, Placements> rotations;
+    std::int32_t count{0};
+    for (std::int32_t i{0}; i < Placements; i++)
+    {
+      auto b{board};
+      AnyFigure figure;
+      w._path[depth] = PlacementAt(i);
+      auto c{Steer(b, _figures[depth], w._path[depth], _rotation, figure)};
+      if (c < 0)
+        return; // no place for the figure, whatever the placement
+
+      bool seen{false};
+      for (std::int32_t j{0}; j < count && !seen; j++)
+        seen = steered[j] == figure->Pos() &&
+               rotations[j] == figure->Rotation();
+      if (seen)
+        continue;
+      steered[count]   = figure->Pos();
+      rotations[count] = figure->Rotation();
+      count++;
+
+      c += Drop(b, figure);
+      Search(w, b, depth + 1, cost + c);
+    }
+  }
+
+  /// @brief Can the remaining figures fill the board up
+  ///
+  /// Lines the remaining blocks fill are the bottom ones. A column full in
+  /// all of them stays full until the end, so figures on its left and
+  /// right fill the blocks on each side separately.
+  bool Fits(const Masks &rows, std::int32_t blocks, std::int32_t depth) const
+  {
+    constexpr auto Width{TetrisScreen::Width()};
+    constexpr auto Depth{TetrisScreen::Depth()};
+    constexpr std::uint32_t Even{0x55555555u & ((1u << Width) - 1)};
+
+    // Every line removed has as many blocks in even columns as in odd
+    // ones, so the remaining figures must make up for the difference
+    std::int32_t imbalance{0};
+    for (auto row : rows)
+      imbalance += std::popcount(row & ~Even) - std::popcount(row & Even);
+    if (!_balances[depth].test(MaxImbalance + imbalance))
+      return false;
+
+    auto lines{(blocks + _blocks[depth]) / Width};
+    auto top{Depth - lines};
+    for (std::int32_t r{0}; r < top; r++)
+      if (rows[r] != 0)
+        return false;
+
+    std::uint32_t full{(1u << Width) - 1};
+    for (auto r{top}; r < Depth; r++)
+      full &= rows[r];
+    if (full == 0)
+      return true;
+
+    // empty blocks between neighbouring full columns
+    std::int32_t empty{0};
+    for (ColumnIdx c{0}; c <= Width; c++)
+    {
+      if (c < Width && (full & 1u << c) == 0)
+      {
+        for (auto r{top}; r < Depth; r++)
+          empty += (rows[r] & 1u << c) == 0;
+        continue;
+      }
+      if (empty % _granularity[depth] != 0)
+        return false;
+      empty = 0;
+    }
+    return true;
+  }
+
+  /// @brief Imbalances a figure can add in any rotation and column
+  /// @returns each imbalance once
+  static std::vector<std::int32_t> ColumnImbalances(std::uint8_t kind)
+  {
+    std::vector<std::int32_t> out;
+    TetrisScreen screen{};
+    auto figure{AnyFigure::Make(kind, Game::Spawn)};
+    for (std::int32_t r{0}; r < Game::Rotations; r++)
+    {
+      figure->Draw(screen, DrawMode::draw);
+      std::int32_t d{0};
+      for (const auto &line : screen.Lines())
+        for (ColumnIdx c{0}; c < TetrisScreen::Width(); c++)
+          if (line[c] != Colour::background)
+            d += c % 2 == 0 ? 1 : -1;
+      figure->Draw(screen, DrawMode::clear);
+      figure->Rotate(screen, Direction::right, RotationSystem::none);
+
+      // one column to the side swaps even and odd columns
+      for (auto v : {d, -d})
+        if (std::find(out.begin(), out.end(), v) == out.end())
+          out.push_back(v);
+    }
+    return out;
+  }
+
+  void Record(const Worker &w, std::int32_t cost)
+  {
+    std::lock_guard lock{_found};
+    if (cost >= _best.load(std::memory_order_relaxed))
+      return;
+    _best.store(cost, std::memory_order_relaxed);
+    _path.assign(w._path.begin(), w._path.begin() + _target);
+  }
+
+  /// @brief Remember a board
+  /// @returns false when the board has been reached with as few commands
+  bool Visit(std::uint64_t hash, std::int32_t cost)
+  {
+    // An entry is the hash with its low 16 bits replaced by the cost.
+    // Hashes that differ only in those bits are taken for the same board.
+    // A cost that does not fit is not remembered: a saturated cost would
+    // make a cheaper path look as expensive as the first one.
+    constexpr std::uint64_t CostMask{0xFFFF};
+    if (cost >= static_cast<std::int32_t>(CostMask))
+      return true;
+    auto key{hash & ~CostMask};
+    if (key == 0)
+      key = CostMask + 1;
+    auto entry{key | static_cast<std::uint64_t>(cost)};
+
+    constexpr std::int32_t Probes{8};
+    auto mask{_table.size() - 1};
+    auto i{hash >> (64 - _tableBits)};
+    for (std::int32_t p{0}; p < Probes; p++, i = (i + 1) & mask)
+    {
+      auto &slot{_table[i]};
+      auto e{slot.load(std::memory_order_relaxed)};
+      for (;;)
+      {
+        if (e != 0 && (e & ~CostMask) != key)
+          break; // another board, try the next slot
+        if (e != 0 && (e & CostMask) <= (entry & CostMask))
+          return false;
+        if (slot.compare_exchange_weak(e, entry, std::memory_order_relaxed))
+          return true;
+      }
+    }
+    // no room, search the board again if reached again
+    return true;
+  }
+
+  std::uint64_t Hash(const Masks &rows, std::int32_t depth) const
+  {
+    std::uint64_t h{static_cast<std::uint64_t>(depth) |
+                    static_cast<std::uint64_t>(_target) << 8};
+    for (auto row : rows)
+      h = (h ^ row) * 0x100000001B3ull;
+    // murmur3 finaliser, so that all bits depend on all lines
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+  }
+
+  static std::int32_t Blocks(const TetrisScreen &board)
+  {
+    std::int32_t n{0};
+    for (const auto &line : board.Lines())
+      n += std::popcount(LineMask(line));
+    return n;
+  }
+
+  std::int32_t _threads;
+  std::int32_t _tableBits;
+  /// Boards reached, see Visit
+  std::vector<std::atomic<std::uint64_t>> _table;
+  std::atomic<bool> _stop{false};
+  std::chrono::steady_clock::time_point _deadline{};
+  RotationSystem _rotation{RotationSystem::none};
+  std::array<std::uint8_t, MaxFigures> _figures{};
+  /// Number of figures the board is cleared with
+  std::int32_t _target{0};
+  /// _blocks[i] - blocks of figures i .. _target - 1
+  std::array<std::int32_t, MaxFigures + 1> _blocks{};
+  /// _granularity[i] - blocks of figures i .. _target - 1 come in
+  /// multiples of it
+  std::array<std::int32_t, MaxFigures + 1> _granularity{};
+  /// _balances[i] - imbalances figures i .. _target - 1 can add up to
+  std::array<Balances, MaxFigures + 1> _balances{};
+  std::atomic<std::int64_t> _nodes{0};
+  /// Commands of the best solution so far
+  std::atomic<std::int32_t> _best{0};
+  std::mutex _found;
+  std::vector<Placement> _path;
+};
+
+} // namespace Tetris
+
+#endif //__TETRIS_SOLVER_H__
@@ -0,0 +1,172 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Range of tasks a thread works on, other threads may steal from
+
+#ifndef __TETRIS_TASK_RANGE_H__
+#define __TETRIS_TASK_RANGE_H__
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace Tetris
+{
+/// @brief Range of task indexes owned by a thread
+///
+/// The owner takes tasks from the front. A thread that has run out of
+/// its own tasks steals the back half of another range. Both ends share
+/// a single word, so the owner and thieves agree on every task with one
+/// CAS.
+class TaskRange
+{
+public:
+  /// @brief Give the range new tasks. Only the owner, when it is empty.
+  void Assign(std::uint32_t begin, std::uint32_t end)
+  {
+    _range.store(Pack(begin, end), std::memory_order_release);
+  }
+
+  /// @brief Take the first task
+  /// @returns false when the range is empty
+  bool Pop(std::uint32_t &task)
+  {
+    auto r{_range.load(std::memory_order_acquire)};
+    while (Begin(r) < End(r))
+      if (_range.compare_exchange_weak(r, Pack(Begin(r) + 1, End(r)),
+                                       std::memory_order_acq_rel))
+      {
+        task = Begin(r);
+        return true;
+      }
+    return false;
+  }
+
+  /// @brief Take the back half of the tasks, at least one
+  /// @returns false when the range is empty
+  bool Steal(std::uint32_t &begin, std::uint32_t &end)
+  {
+    auto r{_range.load(std::memory_order_acquire)};
+    while (Begin(r) < End(r))
+    {
+      auto half{(End(r) - Begin(r) + 1) / 2};
+      if (_range.compare_exchange_weak(r, Pack(Begin(r), End(r) - half),
+                                       std::memory_order_acq_rel))
+      {
+        begin = End(r) - half;
+        end   = End(r);
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  static std::uint64_t Pack(std::uint32_t begin, std::uint32_t end)
+  {
+    return begin | static_cast<std::uint64_t>(end) << 32;
+  }
+  static std::uint32_t Begin(std::uint64_t r)
+  {
+    return static_cast<std::uint32_t>(r);
+  }
+  static std::uint32_t End(std::uint64_t r)
+  {
+    return static_cast<std::uint32_t>(r >> 32);
+  }
+
+  std::atomic<std::uint64_t> _range{0};
+};
+
+/// @brief Work on own tasks, then on tasks stolen from other threads
+///
+/// Returns when no range has tasks left.
+///
+/// @param range - range(t) is the TaskRange of thread t
+/// @param self - calling thread
+/// @param threads - number of threads
+/// @param run - called as run(task, self) for every task taken
+template <class Range, class Run>
+void WorkOnTasks(Range &&range, std::int32_t self, std::int32_t threads,
+                 Run &&run)
+{
+  for (;;)
+  {
+    std::uint32_t task;
+    while (range(self).Pop(task))
+      run(task, self);
+
+    // Own range is empty, so nobody steals from it. Look for a victim
+    // starting from the next thread.
+    std::uint32_t begin, end;
+    bool stolen{false};
+    for (std::int32_t i{1}; i < threads && !stolen; i++)
+      stolen = range((self + i) % threads).Steal(begin, end);
+    if (!stolen)
+      return;
+    range(self).Assign(begin, end);
+  }
+}
+
+/// @brief Run tasks on threads that steal from each other
+///
+/// Tasks 0 .. count - 1 are split into equal ranges, one per thread. The
+/// calling thread is one of them.
+///
+/// @param count - number of tasks
+/// @param threads - number of threads, at least 1
+/// @param run - called as run(task, thread) once for every task
+template <class Run>
+void RunTasks(std::uint32_t count, std::int32_t threads, Run run)
+{
+  std::vector<TaskRange> ranges(threads);
+  for (std::int32_t t{0}; t < threads; t++)
+    ranges[t].Assign(static_cast<std::uint64_t>(count) * t / threads,
+                     static_cast<std::uint64_t>(count) * (t + 1) / threads);
+
+  auto work{[&](std::int32_t self) {
+    WorkOnTasks([&](std::int32_t t) -> TaskRange & { return ranges[t]; },
+                self, threads, run);
+  }};
+
+  std::vector<std::thread> pool;
+  for (std::int32_t t{1}; t < threads; t++)
+    pool.emplace_back(work, t);
+  work(0);
+  for (auto &t : pool)
+    t.join();
+}
+
+} // namespace Tetris
+
+#endif //__TETRIS_TASK_RANGE_H__
@@ -0,0 +1,133 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Raw, non-blocking keyboard input of a terminal
+
+#ifndef __TETRIS_TERMINAL_H__
+#define __TETRIS_TERMINAL_H__
+
+#include <chrono>
+
+#ifdef _WIN32
+#include <conio.h>
+#include <windows.h>
+#else
+#include <sys/select.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+namespace Tetris
+{
+/// @brief Keyboard of a terminal in raw mode
+///
+/// Keys are delivered as soon as they are pressed, without waiting for
+/// Enter and without echo. Previous mode is restored on destruction.
+class Terminal
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+#ifdef _WIN32
+  // Console keyboard functions do not wait for Enter.
+  Terminal() = default;
+#else
+  Terminal()
+  {
+    _raw = tcgetattr(STDIN_FILENO, &_saved) == 0;
+    if (!_raw)
+      return;
+    termios raw{_saved};
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN]  = 0;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+  }
+
+  ~Terminal()
+  {
+    if (_raw)
+      tcsetattr(STDIN_FILENO, TCSANOW, &_saved);
+  }
+#endif
+
+  Terminal(const Terminal &) = delete;
+  void operator=(const Terminal &) = delete;
+
+  /// @brief Wait for a key, but not past the deadline
+  /// @retval true - a key can be read
+  /// @retval false - deadline has passed
+  bool Wait(Clock::time_point deadline) const
+  {
+    auto left{std::chrono::duration_cast<std::chrono::microseconds>(
+        deadline - Clock::now())};
+    if (left.count() < 0)
+      left = std::chrono::microseconds{0};
+#ifdef _WIN32
+    if (_kbhit())
+      return true;
+    auto ms{static_cast<DWORD>((left.count() + 999) / 1000)};
+    return WaitForSingleObject(GetStdHandle(STD_INPUT_HANDLE), ms) ==
+               WAIT_OBJECT_0 &&
+           _kbhit();
+#else
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(STDIN_FILENO, &fds);
+    timeval tv{static_cast<time_t>(left.count() / 1000000),
+               static_cast<suseconds_t>(left.count() % 1000000)};
+    return select(STDIN_FILENO + 1, &fds, nullptr, nullptr, &tv) > 0;
+#endif
+  }
+
+  /// @brief Read a key without blocking
+  /// @returns character of the key or -1 when no key was pressed
+  int Read() const
+  {
+#ifdef _WIN32
+    return _kbhit() ? _getch() : -1;
+#else
+    unsigned char c;
+    return read(STDIN_FILENO, &c, 1) == 1 ? c : -1;
+#endif
+  }
+
+private:
+#ifndef _WIN32
+  termios _saved{};
+  bool _raw{false};
+#endif
+};
+
+} // namespace Tetris
+
+#endif //__TETRIS_TERMINAL_H__
@@ -37,8 +37,13 @@
 
 #include "Command.h"
 #include "FigureImpl.h"
+#include "Journal.h"
+#include "Random.h"
 #include "ScreenDef.h"
-#include <random>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <span>
 
 
 
@@ -47,6 +52,13 @@
 /// All types and functions used in the game are inside this namespace.
 namespace Tetris
 {
+/// @brief Figures a game is played with
+enum class FigureSet : std::uint8_t
+{
+  classic,    ///< Figures of the original game
+  tetrominoes ///< Seven standard tetrominoes
+};
+
 /// @brief Tetris game object
 ///
 /// Entire game happens in computers memory. To observe the game
@@ -59,11 +71,330 @@ namespace Tetris
 class Game
 {
 public:
-  Game() { _figure->Draw(_screen, DrawMode::draw); }
+  /// Number of upcoming figures known in advance
+  static constexpr std::int32_t Preview{3};
+  /// Where new figures appear
+  static constexpr Position Spawn{0, TetrisScreen::Width() / 2 - 1};
+
+  /// @brief Snapshot of everything that makes the game
+  ///
+  /// It is a plain value of a few hundred bytes. Saving and restoring it
+  /// is cheap enough to rewind and re-simulate many ticks in one frame.
+  struct State
+  {
+    FigureSet _set;
+    RotationSystem _rotation;
+    AnyFigure _figure;
+    TetrisScreen _screen;
+    Random _rng;
+    std::int32_t _cleared;
+    std::int32_t _lines;
+    std::int32_t _garbage;
+    ColumnIdx _garbageHole;
+    std::array<std::uint8_t, Preview> _next;
+    std::int32_t _nextIdx;
+    bool _over;
+  };
+
+  /// @brief Snapshot of a game as a fixed size record
+  ///
+  /// Unlike State it has no pointers and no padding, so it can be kept in
+  /// a file or shared memory as it is. The falling figure is described by
+  /// its kind, position and rotation and is made again on restore.
+  struct Packed
+  {
+    /// Screen with the falling figure, bit N of a row is column N
+    std::array<std::uint8_t, TetrisScreen::Depth()> _rows;
+    /// Falling figure, see AnyFigure::Make
+    std::uint8_t _figure;
+    std::uint8_t _figureRotation;
+    std::int8_t _row;
+    std::int8_t _col;
+    /// FigureSet and RotationSystem
+    std::uint8_t _set;
+    std::uint8_t _rotation;
+    /// State of the random number generator, see Random::State
+    std::uint32_t _rng;
+    std::int32_t _lines;
+    /// Zero when the game is over
+    std::uint8_t _playing;
+    std::uint8_t _cleared;
+    std::array<std::uint8_t, Preview> _next;
+    std::uint8_t _nextIdx;
+    std::uint8_t _garbage;
+    std::uint8_t _garbageHole;
+  };
+
+  static_assert(TetrisScreen::Width() <= 8, "Row must fit a byte");
+  static_assert(sizeof(Packed) == 32, "Records are written as they are");
+
+  /// Ticks recorded for Undo and Redo, see Record
+  using Journal = DeltaJournal<sizeof(Packed)>;
+
+  /// New game with a random seed, see Entropy
+  Game()
+      : Game{Entropy()}
+  {
+  }
+
+  /// @brief New game with given seed
+  /// @param seed - the same seed gives the same figures
+  /// @param set - figures the game is played with
+  /// @param rotation - how figures rotate next to walls and blocks
+  explicit Game(std::uint32_t seed, FigureSet set = FigureSet::classic,
+                RotationSystem rotation = RotationSystem::none)
+      : _set{set}
+      , _rotation{rotation}
+      , _rng{seed}
+  {
+    Start();
+  }
 
   Game(const Game &) = delete;
   void operator=(const Game &) = delete;
 
+  /// @brief Start a new game in place
+  ///
+  /// Figures and the rotation system stay the same. Nothing is allocated,
+  /// so one object can play any number of games.
+  /// @param seed - the same seed gives the same figures
+  void Reset(std::uint32_t seed)
+  {
+    _cmd         = Command::Idle;
+    _rng         = Random{seed};
+    _screen      = TetrisScreen{};
+    _cleared     = 0;
+    _clearedRows = 0;
+    _lines       = 0;
+    _garbage     = 0;
+    _garbageHole = 0;
+    _locks       = 0;
+    _lockedAt    = Position{};
+    _nextIdx     = 0;
+    _over        = false;
+    Start();
+    if (_journal)
+      _journal->Start(Snapshot());
+  }
+
+  /// Take a snapshot of the game
+  State Save() const
+  {
+    return State{_set,   _rotation, _figure, _screen,      _rng,
+                 _cleared, _lines,  _garbage, _garbageHole, _next,
+                 _nextIdx, _over};
+  }
+
+  /// Bring the game back to a snapshot. Pending command is dropped.
+  void Restore(const State &s)
+  {
+    _cmd         = Command::Idle;
+    _set         = s._set;
+    _rotation    = s._rotation;
+    _figure      = s._figure;
+    _screen      = s._screen;
+    _rng         = s._rng;
+    _cleared     = s._cleared;
+    _lines       = s._lines;
+    _garbage     = s._garbage;
+    _garbageHole = s._garbageHole;
+    _next        = s._next;
+    _nextIdx     = s._nextIdx;
+    _over        = s._over;
+  }
+
+  /// @brief Write the game into a record, see Packed
+  ///
+  /// The record is written field by field, so it may be a slot of a
+  /// mapped file. Pending command is not stored.
+  void Save(Packed &p) const
+  {
+    for (std::int32_t r{0}; r < TetrisScreen::Depth(); r++)
+      p._rows[r] = static_cast<std::uint8_t>(LineMask(_screen.Lines()[r]));
+    p._figure         = static_cast<std::uint8_t>(_figure.Kind());
+    p._figureRotation = static_cast<std::uint8_t>(_figure->Rotation());
+    p._row            = static_cast<std::int8_t>(_figure->Pos()._row);
+    p._col            = static_cast<std::int8_t>(_figure->Pos()._col);
+    p._set            = static_cast<std::uint8_t>(_set);
+    p._rotation       = static_cast<std::uint8_t>(_rotation);
+    p._rng            = _rng.State();
+    p._lines          = _lines;
+    p._playing        = _over ? 0 : 1;
+    p._cleared        = static_cast<std::uint8_t>(_cleared);
+    for (std::int32_t i{0}; i < Preview; i++)
+      p._next[i] = _next[i];
+    p._nextIdx     = static_cast<std::uint8_t>(_nextIdx);
+    p._garbage     = static_cast<std::uint8_t>(std::min(_garbage, 0xFF));
+    p._garbageHole = static_cast<std::uint8_t>(_garbageHole);
+  }
+
+  /// @brief Check that a record describes a game, see Restore
+  ///
+  /// Records may come from a file, so kinds, rotations, indices and the
+  /// position of the falling figure are not taken on trust.
+  static bool Valid(const Packed &p)
+  {
+    if (p._figure >= AnyFigure::Kinds || p._figureRotation >= Rotations ||
+        p._nextIdx >= Preview || p._garbageHole >= TetrisScreen::Width() ||
+        p._set > static_cast<std::uint8_t>(FigureSet::tetrominoes) ||
+        p._rotation > static_cast<std::uint8_t>(RotationSystem::srs))
+      return false;
+    for (auto kind : p._next)
+      if (kind >= AnyFigure::Kinds)
+        return false;
+    // on an empty screen the figure collides only with the screen's edges
+    TetrisScreen empty;
+    auto figure{AnyFigure::Make(p._figure, Position{p._row, p._col},
+                                p._figureRotation)};
+    return figure->Translate(empty, Position{0, 0});
+  }
+
+  /// @brief Bring the game back from a record. Pending command is dropped.
+  ///
+  /// A record keeps no colours, blocks come back Colour::red. Locks,
+  /// ClearedRows and the landing position are not in the record either;
+  /// they read as after a tick in which nothing has landed.
+  /// @returns false if the record is not Valid, the game is left as it was
+  bool Restore(const Packed &p)
+  {
+    if (!Valid(p))
+      return false;
+    _cmd         = Command::Idle;
+    _clearedRows = 0;
+    _locks       = 0;
+    _lockedAt    = Position{};
+    _screen      = TetrisScreen{};
+    for (std::int32_t r{0}; r < TetrisScreen::Depth(); r++)
+      for (std::int32_t c{0}; c < TetrisScreen::Width(); c++)
+        if (p._rows[r] >> c & 1)
+          _screen[Position{r, c}] = Colour::red;
+    _figure = AnyFigure::Make(p._figure, Position{p._row, p._col},
+                              p._figureRotation);
+    _set         = static_cast<FigureSet>(p._set);
+    _rotation    = static_cast<RotationSystem>(p._rotation);
+    _over        = p._playing == 0;
+    _cleared     = p._cleared;
+    _rng         = Random::FromState(p._rng);
+    _lines       = p._lines;
+    for (std::int32_t i{0}; i < Preview; i++)
+      _next[i] = p._next[i];
+    _nextIdx     = p._nextIdx;
+    _garbage     = p._garbage;
+    _garbageHole = p._garbageHole;
+    return true;
+  }
+
+  /// @brief Record every tick into a journal, see Undo and Redo
+  ///
+  /// The journal starts from the current state. Tick, Apply, Drop and
+  /// Place are recorded as one tick each. Changes made between them, e.g.
+  /// by AddGarbage or Restore, go into the next tick.
+  /// @param journal - nullptr stops recording
+  void Record(Journal *journal)
+  {
+    _journal = journal;
+    if (_journal)
+      _journal->Start(Snapshot());
+  }
+
+  /// @brief Take back up to n recorded ticks
+  ///
+  /// It takes time proportional to n, not to the length of the game. The
+  /// game comes back from a record, see Restore(const Packed &).
+  /// @returns number of ticks taken back
+  std::int64_t Undo(std::int64_t n)
+  {
+    if (!_journal)
+      return 0;
+    n = std::min(n, _journal->Undoable());
+    Restore(std::bit_cast<Packed>(_journal->Undo(n)));
+    return n;
+  }
+
+  /// @brief Play again up to n ticks taken back by Undo
+  ///
+  /// A tick played after Undo drops the ticks that could be redone. The
+  /// game comes back from a record, see Restore(const Packed &).
+  /// @returns number of ticks played again
+  std::int64_t Redo(std::int64_t n)
+  {
+    if (!_journal)
+      return 0;
+    n = std::min(n, _journal->Redoable());
+    Restore(std::bit_cast<Packed>(_journal->Redo(n)));
+    return n;
+  }
+
+  /// Game screen
+  const TetrisScreen &Board() const { return _screen; }
+
+  /// Game screen without the falling figure
+  TetrisScreen Landed() const
+  {
+    TetrisScreen landed{_screen};
+    AnyFigure figure{_figure};
+    figure->Draw(landed, DrawMode::clear);
+    return landed;
+  }
+
+  /// Current figure
+  const AnyFigure &Current() const { return _figure; }
+
+  /// @brief Kind of an upcoming figure
+  /// @param i - 0 is the next figure, up to Preview - 1
+  std::int32_t Next(std::int32_t i) const
+  {
+    return _next[(_nextIdx + i) % Preview];
+  }
+
+  /// @brief Game is over
+  ///
+  /// New figure had no place on the screen. It is drawn over other blocks
+  /// and the game does not react to commands anymore.
+  bool Over() const { return _over; }
+
+  /// Number of lines removed by the last Tick
+  std::int32_t Cleared() const { return _cleared; }
+
+  /// @brief Rows removed by the last Tick, Apply, Drop or Place
+  ///
+  /// Bit N is row N as it was before the figure landed, see
+  /// Tetris::RemoveFullLines.
+  std::uint32_t ClearedRows() const { return _clearedRows; }
+
+  /// Number of figures landed during the last Tick, Apply, Drop or Place
+  std::int32_t Locks() const { return _locks; }
+
+  /// Number of lines removed since the game started
+  std::int32_t Lines() const { return _lines; }
+
+  /// Game level, it goes up every 10 removed lines. Starts at 1.
+  std::int32_t Level() const { return 1 + _lines / 10; }
+
+  /// @brief Check if the figure rests on the ground
+  ///
+  /// When it does, next 'down' command will lock it.
+  bool Grounded() const
+  {
+    TetrisScreen screen{_screen};
+    AnyFigure figure{_figure};
+    figure->Draw(screen, DrawMode::clear);
+    return !figure->Translate(screen, Position{1, 0});
+  }
+
+  /// @brief Queue garbage lines from an opponent
+  ///
+  /// Lines are pushed from the bottom when the current figure lands,
+  /// before the next one is placed.
+  ///
+  /// @param count - number of lines
+  /// @param hole - column left empty in garbage lines
+  void AddGarbage(std::int32_t count, ColumnIdx hole)
+  {
+    _garbage += count;
+    _garbageHole = hole;
+  }
+
   /// Dispatch new command to the game
   void Input(Command cmd) 
   {
@@ -75,99 +406,275 @@ public:
   /// Progress the game. React to commands.
   void Tick()
   {
+    _cleared     = 0;
+    _clearedRows = 0;
+    _locks       = 0;
+    Execute(DrawMode::draw);
+    _cmd = Command::Idle;
+    RecordTick();
+  }
+
+  /// @brief Result of Apply
+  struct Outcome
+  {
+    /// Number of figures that have landed
+    std::int32_t _locks;
+    /// Position of the last figure that has landed
+    Position _lockedAt;
+    /// Lines removed in total
+    std::int32_t _cleared;
+  };
+
+  /// @brief Execute a sequence of commands at once
+  ///
+  /// The result is the same as Input and Tick called for each command.
+  /// Only, the figure is cleared from the screen once at the beginning
+  /// and drawn once at the end, instead of for every command.
+  ///
+  /// @param cmds - commands to execute in order
+  /// @returns where figures have landed and how many lines were removed
+  Outcome Apply(std::span<const Command> cmds)
+  {
+    _cleared     = 0;
+    _clearedRows = 0;
+    _locks       = 0;
+    if (cmds.empty())
+      return Outcome{0, _lockedAt, 0};
+
+    _figure->Draw(_screen, DrawMode::clear);
+    for (auto cmd : cmds)
+    {
+      _cmd = cmd;
+      Execute(DrawMode::clear);
+    }
+    _cmd = Command::Idle;
+    _figure->Draw(_screen, DrawMode::draw);
+    RecordTick();
+    return Outcome{_locks, _lockedAt, _cleared};
+  }
+
+  /// @brief Move the figure down until it lands
+  ///
+  /// Same as Apply with as many 'down' commands as needed for the figure
+  /// to land, but not more.
+  Outcome Drop()
+  {
+    _cleared     = 0;
+    _clearedRows = 0;
+    _locks       = 0;
+    if (_over)
+    {
+      RecordTick();
+      return Outcome{0, _lockedAt, 0};
+    }
+
+    _figure->Draw(_screen, DrawMode::clear);
+    _cmd = Command::TranslateDown;
+    while (_locks == 0)
+      Translate(Position{1, 0}, DrawMode::clear);
+    _cmd = Command::Idle;
+    _figure->Draw(_screen, DrawMode::draw);
+    RecordTick();
+    return Outcome{_locks, _lockedAt, _cleared};
+  }
+
+  /// Number of different rotations a placement can ask for
+  static constexpr std::int32_t Rotations{4};
+
+  /// @brief Place the figure
+  ///
+  /// The figure is rotated right 'rotation' times, moved towards column
+  /// 'col' as far as it can go and dropped. Moves that are blocked are
+  /// skipped, exactly like the same commands given one by one.
+  /// @param rotation - 0 .. Rotations - 1
+  /// @param col - column of the figure's position
+  Outcome Place(std::int32_t rotation, ColumnIdx col)
+  {
+    if (_over)
+      return Drop();
+
+    _figure->Draw(_screen, DrawMode::clear);
+    _cmd = Command::RotateRight;
+    for (std::int32_t i{0}; i < rotation; i++)
+      Rotate(Direction::right, DrawMode::clear);
+
+    std::int32_t shift{col - _figure->Pos()._col};
+    Direction d{shift < 0 ? Direction::left : Direction::right};
+    _cmd = shift < 0 ? Command::TranslateLeft : Command::TranslateRigth;
+    for (std::int32_t i{0}; i < shift * d; i++)
+      Translate(Position{0, d}, DrawMode::clear);
+    _figure->Draw(_screen, DrawMode::draw);
+
+    return Drop();
+  }
+
+private:
+  /// Command to execute
+  Command _cmd{};
+  /// Figures the game is played with
+  FigureSet _set{FigureSet::classic};
+  /// Kicks tried when a figure rotates
+  RotationSystem _rotation{RotationSystem::none};
+  /// Source of figures
+  Random _rng;
+  /// Rows removed by the last Tick; it takes the padding before
+  /// _figure instead of growing the game
+  std::uint32_t _clearedRows{0};
+  /// Current figure
+  AnyFigure _figure{};
+  /// Game screen
+  TetrisScreen _screen{};
+  /// Lines removed by the last Tick
+  std::int32_t _cleared{0};
+  /// Lines removed since the game started
+  std::int32_t _lines{0};
+  /// Garbage lines waiting for the figure to land
+  std::int32_t _garbage{0};
+  /// Empty column of the waiting garbage
+  ColumnIdx _garbageHole{0};
+  /// Figures landed during the last Apply
+  std::int32_t _locks{0};
+  /// Position of the last figure that has landed
+  Position _lockedAt{};
+  /// Kinds of upcoming figures, a ring starting at _nextIdx
+  std::array<std::uint8_t, Preview> _next{};
+  std::int32_t _nextIdx{0};
+  /// New figure had no place on the screen
+  bool _over{false};
+  /// Where ticks are recorded, see Record
+  Journal *_journal{nullptr};
+
+  /// Game as a journal's snapshot
+  Journal::Snapshot Snapshot() const
+  {
+    Packed p;
+    Save(p);
+    return std::bit_cast<Journal::Snapshot>(p);
+  }
+
+  /// Add the state after a tick to the journal
+  void RecordTick()
+  {
+    if (_journal)
+      _journal->Record(Snapshot());
+  }
+
+  /// @brief Execute current command
+  ///
+  /// @param shown - `draw` when the figure is on the screen before and
+  ///   after the command, `clear` when it is not on the screen
+  void Execute(DrawMode shown)
+  {
+    if (_over)
+      return;
+
     /// Satisfies requirements: [REQ_Cmd](https://github.com/grygorek/TetrisArch#REQ_Cmd)
     switch (_cmd)
     {
     case Command::Idle:
       break;
     case Command::RotateLeft:
-      Rotate(Direction::left);
+      Rotate(Direction::left, shown);
       break;
     case Command::RotateRight:
-      Rotate(Direction::right);
+      Rotate(Direction::right, shown);
       break;
     case Command::TranslateDown:
-      Translate(Position{1, 0});
+      Translate(Position{1, 0}, shown);
       break;
     case Command::TranslateLeft:
-      Translate(Position{0, -1});
+      Translate(Position{0, -1}, shown);
       break;
     case Command::TranslateRigth:
-      Translate(Position{0, 1});
+      Translate(Position{0, 1}, shown);
       break;
     }
-    _cmd = Command::Idle;
   }
 
-private:
-  /// Command to execute
-  Command _cmd{};
-  /// Pointer to a current figure
-  std::shared_ptr<Figure> _figure{RandomFigureGenerator()};
-  /// Game screen
-  TetrisScreen _screen{};
-  
   /// Handle 'translate' command
   /// @param p - translation vector
-  void Translate(Position p)
+  /// @param shown - see Execute
+  void Translate(Position p, DrawMode shown)
   {
     // must clear before checking colisions
-    _figure->Draw(_screen, DrawMode::clear);
+    if (shown == DrawMode::draw)
+      _figure->Draw(_screen, DrawMode::clear);
     auto result{_figure->Translate(_screen, p)};
-    _figure->Draw(_screen, DrawMode::draw);
 
     if (result == false && _cmd == Command::TranslateDown)
     {
+      _figure->Draw(_screen, DrawMode::draw);
+
       /// Satisfies requirements:
       ///   [REQ_LineFull](https://github.com/grygorek/TetrisArch#REQ_LineFull)
       ///   [REQ_FigureLifeTime](https://github.com/grygorek/TetrisArch#REQ_FigureLifeTime)
-      _screen.RemoveFullLines();
+      _locks++;
+      _lockedAt = _figure->Pos();
+      auto cleared{_screen.RemoveFullLines(&_clearedRows)};
+      _cleared += cleared;
+      _lines += cleared;
+      if (_garbage > 0)
+      {
+        _screen.PushGarbageLines(_garbage, _garbageHole);
+        _garbage = 0;
+      }
       _figure = RandomFigureGenerator();
-      _figure->Draw(_screen, DrawMode::draw);
+      // figure that cannot stay where it is has no place on the screen
+      _over = !_figure->Translate(_screen, Position{0, 0});
+      // Drawing a new figure and clearing it before the next command
+      // leaves its cells empty, even where it overlaps other blocks.
+      _figure->Draw(_screen, shown);
     }
+    else if (shown == DrawMode::draw)
+      _figure->Draw(_screen, DrawMode::draw);
   }
 
   /// Handle 'rotation' command
   /// @param d - rotation direction
-  void Rotate(Direction d)
+  /// @param shown - see Execute
+  void Rotate(Direction d, DrawMode shown)
   {
     // must clear before checking colisions
-    _figure->Draw(_screen, DrawMode::clear);
-    auto result{_figure->Rotate(_screen, d)};
-    _figure->Draw(_screen, DrawMode::draw);
+    if (shown == DrawMode::draw)
+      _figure->Draw(_screen, DrawMode::clear);
+    _figure->Rotate(_screen, d, _rotation);
+    if (shown == DrawMode::draw)
+      _figure->Draw(_screen, DrawMode::draw);
   }
 
   /// @brief Generate a new figure
   ///
-  /// New figure is generated randomly.
+  /// New figure is generated randomly from the game's own generator,
+  /// so the sequence of figures is repeatable for a given seed. Figures
+  /// are drawn `Preview` figures ahead, so the upcoming ones are known.
   ///
-  /// @returns pointer to a new figure
-  static std::shared_ptr<Figure> RandomFigureGenerator()
+  /// @returns a new figure
+  AnyFigure RandomFigureGenerator()
   {
-    std::random_device dev;
-    std::default_random_engine rndEng{dev()};
-    std::uniform_int_distribution<int> selectFigure(0, 3);
-    auto figureID{selectFigure(rndEng)};
+    auto figureID{_next[_nextIdx]};
+    _next[_nextIdx] = NextKind();
+    _nextIdx        = (_nextIdx + 1) % Preview;
 
-    Position initPos{0, TetrisScreen::Dimention()._col / 2 - 1};
+    // Figure is held by value, no dynamic allocation. That keeps the
+    // state of the game copyable.
+    return AnyFigure::Make(figureID, Spawn);
+  }
 
-    // Instead of dynamically allocating an object I tried to have
-    // static objects and just return a pointer to it. In that way
-    // I would avoid dynamic allocation. Unfortunately, for some reason
-    // MSVS2019 was getting crazy and not working properly. Making this
-    // dynamic works.
-    switch (figureID)
-    {
-    default:
-    case 0:
-      return std::make_shared<BigSquare>(initPos);
-    case 1:
-      return std::make_shared<Bar>(initPos);
-    case 2:
-      return std::make_shared<BarT>(initPos);
-    case 3:
-      return std::make_shared<Square>(initPos);
-    }
+  /// Fill the preview and show the first figure
+  void Start()
+  {
+    for (auto &kind : _next)
+      kind = NextKind();
+    _figure = RandomFigureGenerator();
+    _figure->Draw(_screen, DrawMode::draw);
+  }
+
+  /// Kind of a random figure of the game's set
+  std::uint8_t NextKind()
+  {
+    if (_set == FigureSet::tetrominoes)
+      return Tetrominoes[_rng.Below(Tetrominoes.size())];
+    return ClassicFigures[_rng.Below(ClassicFigures.size())];
   }
 
 };
@@ -0,0 +1,215 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Hierarchical timer wheel
+
+#ifndef __TETRIS_TIMER_WHEEL_H__
+#define __TETRIS_TIMER_WHEEL_H__
+
+#include <array>
+#include <cstdint>
+
+namespace Tetris
+{
+template <class Node>
+class TimerWheel;
+
+/// @brief Timer that can be put on a TimerWheel
+///
+/// Intrusive: the timer links itself into the wheel's slot, so arming
+/// and cancelling it never allocates and costs O(1). Derive from it to
+/// attach data to the timer. A destroyed timer cancels itself.
+class TimerNode
+{
+  template <class Node>
+  friend class TimerWheel;
+
+public:
+  TimerNode() = default;
+  TimerNode(const TimerNode &) = delete;
+  void operator=(const TimerNode &) = delete;
+  ~TimerNode() { Cancel(); }
+
+  /// True when the timer is on a wheel
+  bool Armed() const { return _next != nullptr; }
+
+  /// Tick at which the timer expires
+  std::uint64_t Expires() const { return _expires; }
+
+  /// Take the timer off the wheel
+  void Cancel()
+  {
+    if (!Armed())
+      return;
+    _prev->_next = _next;
+    _next->_prev = _prev;
+    _prev = _next = nullptr;
+  }
+
+private:
+  TimerNode *_prev{nullptr};
+  TimerNode *_next{nullptr};
+  std::uint64_t _expires{0};
+
+  /// Slot's list head: circular list with itself as a sentinel
+  void MakeHead() { _prev = _next = this; }
+
+  /// Link before `head`, i.e. at the end of its list
+  void LinkBefore(TimerNode &head)
+  {
+    _prev        = head._prev;
+    _next        = &head;
+    _prev->_next = this;
+    head._prev   = this;
+  }
+};
+
+/// @brief Hierarchical timer wheel
+///
+/// Level 0 has one slot per tick. Each next level has slots covering
+/// a whole turn of the level below. When a lower level completes a turn,
+/// timers from the next slot of the level above are moved down
+/// (cascaded). Arming and cancelling are O(1); advancing by a tick is
+/// O(1) plus the number of expired or cascaded timers.
+///
+/// With 4 levels of 64 slots and 1 ms tick the wheel spans over 4 hours.
+/// Longer delays are clamped.
+///
+/// @tparam Node - type of timers, derived from TimerNode
+template <class Node>
+class TimerWheel
+{
+public:
+  static constexpr std::uint32_t SlotBits{6};
+  static constexpr std::uint32_t Slots{1u << SlotBits};
+  static constexpr std::uint32_t Levels{4};
+  static constexpr std::uint64_t Span{1ull << (SlotBits * Levels)};
+
+  explicit TimerWheel(std::uint64_t now = 0)
+      : _now{now}
+  {
+    for (auto &level : _slots)
+      for (auto &head : level)
+        head.MakeHead();
+  }
+
+  TimerWheel(const TimerWheel &) = delete;
+  void operator=(const TimerWheel &) = delete;
+
+  /// Present tick
+  std::uint64_t Now() const { return _now; }
+
+  /// @brief Arm a timer. An armed timer is re-armed.
+  /// @param timer - timer to arm
+  /// @param delay - ticks from now, at least one
+  void Arm(Node &timer, std::uint64_t delay)
+  {
+    timer.Cancel();
+    delay          = delay < 1 ? 1 : (delay >= Span ? Span - 1 : delay);
+    timer._expires = _now + delay;
+    Place(timer);
+  }
+
+  /// @brief Advance time and fire expired timers
+  ///
+  /// Timer is taken off the wheel before `expired` is called, so it can
+  /// be re-armed from the callback.
+  ///
+  /// @param now - new present tick
+  /// @param expired - callback called with each expired timer
+  template <class Callback>
+  void Advance(std::uint64_t now, Callback &&expired)
+  {
+    while (_now < now)
+    {
+      _now++;
+      for (std::uint32_t l{1}; l < Levels; l++)
+      {
+        if ((_now & ((1ull << (SlotBits * l)) - 1)) != 0)
+          break;
+        Cascade(_slots[l][Index(_now, l)]);
+      }
+
+      auto &head{_slots[0][Index(_now, 0)]};
+      while (head._next != &head)
+      {
+        auto timer{head._next};
+        timer->Cancel();
+        expired(static_cast<Node &>(*timer));
+      }
+    }
+  }
+
+private:
+  std::uint64_t _now;
+  std::array<std::array<TimerNode, Slots>, Levels> _slots;
+
+  static std::uint32_t Index(std::uint64_t tick, std::uint32_t level)
+  {
+    return (tick >> (SlotBits * level)) & (Slots - 1);
+  }
+
+  /// Put timer to a slot of the lowest level that reaches its expiry
+  void Place(TimerNode &timer)
+  {
+    auto delta{timer._expires - _now};
+    std::uint32_t level{0};
+    while (level + 1 < Levels && delta >= (1ull << (SlotBits * (level + 1))))
+      level++;
+    timer.LinkBefore(_slots[level][Index(timer._expires, level)]);
+  }
+
+  /// Move all timers of a slot to lower levels
+  void Cascade(TimerNode &head)
+  {
+    TimerNode list;
+    if (head._next == &head)
+      return;
+    // take over the whole list, then place timers one by one
+    list._next        = head._next;
+    list._prev        = head._prev;
+    list._next->_prev = &list;
+    list._prev->_next = &list;
+    head.MakeHead();
+    while (list._next != &list)
+    {
+      auto timer{list._next};
+      timer->Cancel();
+      Place(*timer);
+    }
+    list._prev = list._next = nullptr;
+  }
+};
+
+} // namespace Tetris
+
+#endif //__TETRIS_TIMER_WHEEL_H__
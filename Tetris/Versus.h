@@ -0,0 +1,337 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Versus game of two players with rollback of mispredicted input
+
+#ifndef __TETRIS_VERSUS_H__
+#define __TETRIS_VERSUS_H__
+
+#include "TetrisGame.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace Tetris
+{
+/// @brief Number of garbage lines sent to the opponent
+/// @param cleared - lines removed at once by a single figure
+constexpr std::int32_t GarbageLines(std::int32_t cleared)
+{
+  return cleared > 1 ? cleared - 1 : 0;
+}
+
+/// @brief Two games played against each other
+///
+/// Step is deterministic: the same state and the same commands always
+/// give the same result. This is what allows both players to simulate
+/// the whole match locally and to re-simulate it after a rollback.
+class Match
+{
+public:
+  /// Number of players
+  static constexpr std::int32_t Players{2};
+
+  /// Commands of all players for a single frame
+  using Commands = std::array<Command, Players>;
+
+  /// @brief Snapshot of the match
+  struct State
+  {
+    std::array<Game::State, Players> _games;
+    Random _rng;
+    std::int32_t _frame;
+  };
+
+  /// @brief New match
+  /// @param seed - both players get the same sequence of figures
+  /// @param gravity - figures fall by one line every `gravity` frames
+  explicit Match(std::uint32_t seed, std::int32_t gravity = 30)
+      : _games{Game{seed}, Game{seed}}
+      , _rng{~seed}
+      , _gravity{gravity}
+  {
+  }
+
+  /// @brief Progress both games by a single frame
+  /// @param cmds - command of each player
+  void Step(const Commands &cmds)
+  {
+    for (std::int32_t i{0}; i < Players; i++)
+      Play(i, cmds[i]);
+
+    /// Satisfies requirements:
+    ///   [REQ_OnTimerCommand](https://github.com/grygorek/TetrisArch#REQ_OnTimerCommand)
+    if (++_frame % _gravity == 0)
+      for (std::int32_t i{0}; i < Players; i++)
+        Play(i, Command::TranslateDown);
+  }
+
+  /// Take a snapshot of the match
+  State Save() const
+  {
+    return State{{_games[0].Save(), _games[1].Save()}, _rng, _frame};
+  }
+
+  /// Bring the match back to a snapshot
+  void Restore(const State &s)
+  {
+    for (std::int32_t i{0}; i < Players; i++)
+      _games[i].Restore(s._games[i]);
+    _rng   = s._rng;
+    _frame = s._frame;
+  }
+
+  /// Game of a given player
+  const Game &Player(std::int32_t i) const { return _games[i]; }
+
+  /// Number of simulated frames
+  std::int32_t Frame() const { return _frame; }
+
+  /// @brief FNV-1a hash of both screens
+  ///
+  /// Peers compare it to detect a desynchronisation.
+  std::uint32_t Checksum() const
+  {
+    std::uint32_t h{2166136261u};
+    for (const auto &g : _games)
+      for (const auto &line : g.Board().Lines())
+        for (auto c : line)
+          h = (h ^ static_cast<std::uint8_t>(c)) * 16777619u;
+    return h ^ static_cast<std::uint32_t>(_frame);
+  }
+
+private:
+  std::array<Game, Players> _games;
+  /// Selects holes in garbage lines
+  Random _rng;
+  std::int32_t _gravity;
+  std::int32_t _frame{0};
+
+  /// Single command of a single player. Lines cleared go to the opponent.
+  void Play(std::int32_t player, Command cmd)
+  {
+    auto &game{_games[player]};
+    game.Input(cmd);
+    game.Tick();
+
+    auto garbage{GarbageLines(game.Cleared())};
+    if (garbage > 0)
+      _games[Players - 1 - player].AddGarbage(
+          garbage, _rng.Below(TetrisScreen::Width()));
+  }
+};
+
+/// @brief Input of a player at a given frame, sent to the opponent
+struct InputPacket
+{
+  std::int32_t _frame;
+  Command _cmd;
+};
+
+/// @brief In-process channel with simulated latency
+///
+/// Packets are delivered `latency` frames after they were sent plus
+/// a random jitter. With jitter, packets may be delivered out of order.
+template <class Packet>
+class LoopbackChannel
+{
+public:
+  /// @param latency - delay in frames
+  /// @param jitter - maximum extra delay in frames
+  /// @param seed - seed of the jitter generator
+  LoopbackChannel(std::int32_t latency, std::int32_t jitter,
+                  std::uint32_t seed)
+      : _latency{latency}
+      , _jitter{jitter}
+      , _rng{seed}
+  {
+  }
+
+  /// Send a packet at frame `now`
+  void Send(std::int32_t now, const Packet &p)
+  {
+    _queue.push_back({now + _latency + _rng.Below(_jitter + 1), p});
+  }
+
+  /// Deliver all packets due at frame `now` to `receive`
+  template <class Receiver>
+  void Deliver(std::int32_t now, Receiver &&receive)
+  {
+    auto due{std::stable_partition(
+        _queue.begin(), _queue.end(),
+        [now](const Pending &p) { return p._due > now; })};
+    for (auto it{due}; it != _queue.end(); ++it)
+      receive(it->_packet);
+    _queue.erase(due, _queue.end());
+  }
+
+  /// True when nothing is in flight
+  bool Empty() const { return _queue.empty(); }
+
+private:
+  struct Pending
+  {
+    std::int32_t _due;
+    Packet _packet;
+  };
+
+  std::int32_t _latency;
+  std::int32_t _jitter;
+  Random _rng;
+  std::vector<Pending> _queue;
+};
+
+/// @brief One side of a versus match with rollback
+///
+/// Each peer simulates the whole match. Own input is known immediately,
+/// opponent's input arrives late. Until it arrives the peer predicts it
+/// and carries on. Commands are single key presses, so the prediction is
+/// `Idle`, which is what the opponent sends in most frames. When a
+/// different command arrives, the match is rolled back to the state
+/// saved before that frame and all frames up to the present are
+/// simulated again with corrected input.
+///
+/// @tparam MaxRollback - how far ahead of the confirmed input a peer may
+///   run. Peer has to stall when it is that many frames ahead.
+template <std::int32_t MaxRollback = 8>
+class RollbackPeer
+{
+public:
+  /// @param side - player index of this peer in the match
+  /// @param seed - seed of the match, must be the same on both peers
+  /// @param gravity - see Match
+  RollbackPeer(std::int32_t side, std::uint32_t seed,
+               std::int32_t gravity = 30)
+      : _side{side}
+      , _match{seed, gravity}
+  {
+    _remoteFrame.fill(-1);
+  }
+
+  /// False when the peer is too far ahead of the opponent's input
+  bool CanAdvance() const { return _frame - _confirmed < MaxRollback; }
+
+  /// @brief Simulate next frame with own command
+  /// @param local - command of this peer's player
+  /// @returns packet to send to the opponent
+  InputPacket Advance(Command local)
+  {
+    auto f{_frame};
+    auto slot{f % InputRing};
+    _local[slot] = local;
+    _used[slot]  = _remoteFrame[slot] == f ? _remote[slot] : Command::Idle;
+
+    _saved[f % StateRing] = _match.Save();
+    _match.Step(Inputs(f));
+    _frame++;
+    return InputPacket{f, local};
+  }
+
+  /// @brief Accept opponent's input
+  ///
+  /// Rollback is only scheduled here; it is done by Rollback.
+  void Receive(const InputPacket &p)
+  {
+    auto slot{p._frame % InputRing};
+    _remote[slot]      = p._cmd;
+    _remoteFrame[slot] = p._frame;
+
+    if (p._frame < _frame && _used[slot] != p._cmd)
+      _rollbackFrom = std::min(_rollbackFrom, p._frame);
+
+    while (_remoteFrame[_confirmed % InputRing] == _confirmed)
+      _confirmed++;
+  }
+
+  /// @brief Fix mispredicted frames
+  /// @returns number of re-simulated frames, 0 when nothing to do
+  std::int32_t Rollback()
+  {
+    if (_rollbackFrom >= _frame)
+      return 0;
+
+    auto depth{_frame - _rollbackFrom};
+    _match.Restore(_saved[_rollbackFrom % StateRing]);
+    for (auto f{_rollbackFrom}; f < _frame; f++)
+    {
+      auto slot{f % InputRing};
+      if (_remoteFrame[slot] == f)
+        _used[slot] = _remote[slot];
+      if (f != _rollbackFrom)
+        _saved[f % StateRing] = _match.Save();
+      _match.Step(Inputs(f));
+    }
+    _rollbackFrom = NoRollback;
+    return depth;
+  }
+
+  /// Simulated frame count
+  std::int32_t Frame() const { return _frame; }
+  /// Number of frames with known opponent's input
+  std::int32_t Confirmed() const { return _confirmed; }
+  /// Present state of the match, including predictions
+  const Match &Present() const { return _match; }
+
+private:
+  static constexpr std::int32_t NoRollback{0x7FFFFFFF};
+  static constexpr std::int32_t StateRing{MaxRollback + 1};
+  static constexpr std::int32_t InputRing{2 * (MaxRollback + 1)};
+
+  std::int32_t _side;
+  Match _match;
+  std::int32_t _frame{0};
+  std::int32_t _confirmed{0};
+  std::int32_t _rollbackFrom{NoRollback};
+
+  /// States at the beginning of not yet confirmed frames
+  std::array<Match::State, StateRing> _saved{};
+  std::array<Command, InputRing> _local{};
+  /// Opponent's command used in simulation (received or predicted)
+  std::array<Command, InputRing> _used{};
+  /// Received opponent's commands and their frames
+  std::array<Command, InputRing> _remote{};
+  std::array<std::int32_t, InputRing> _remoteFrame{};
+
+  Match::Commands Inputs(std::int32_t f) const
+  {
+    auto slot{f % InputRing};
+    Match::Commands cmds{};
+    cmds[_side]                      = _local[slot];
+    cmds[Match::Players - 1 - _side] = _used[slot];
+    return cmds;
+  }
+};
+
+} // namespace Tetris
+
+#endif //__TETRIS_VERSUS_H__
@@ -40,12 +40,19 @@
 ///  * Progress the game in the debugger. Stop on a breakpoint and
 ///    put a new command in s_cmd variable. Continue stepping through
 ///    the program.
+///  * Or play from the terminal: 'a' left, 'd' right, 's' down,
+///    space rotates, 'r' starts a new game, 'q' quits. Hold a key to repeat
+///    the move.
 
 
+#include "AutoRepeat.h"
+#include "Gravity.h"
+#include "Terminal.h"
 #include "TetrisGame.h"
+#include <algorithm>
 #include <chrono>
-#include <iostream>
-#include <thread>
+#include <cstdio>
+#include <vector>
 
 /// @brief Single command buffer for a player
 ///
@@ -54,57 +61,131 @@
 ///   [REQ_SinglePlayer](https://github.com/grygorek/TetrisArch#REQ_SinglePlayer)
 volatile Tetris::Command s_cmd;
 
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+/// Game loop runs at 1 kHz
+constexpr std::chrono::microseconds Step{1000};
+
+/// Command of a key, Idle for keys not used by the game
+Tetris::Command KeyCommand(int key)
+{
+  switch (key)
+  {
+  case 'a':
+    return Tetris::Command::TranslateLeft;
+  case 'd':
+    return Tetris::Command::TranslateRigth;
+  case ' ':
+    return Tetris::Command::RotateRight;
+  case 's':
+    return Tetris::Command::TranslateDown;
+  default:
+    return Tetris::Command::Idle;
+  }
+}
+
+/// @brief Time from reading a key to the screen showing its effect
+class Latency
+{
+public:
+  void Record(Clock::duration d)
+  {
+    _samples.push_back(static_cast<std::uint32_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(d).count()));
+  }
+
+  void Report()
+  {
+    if (_samples.empty())
+      return;
+    std::sort(_samples.begin(), _samples.end());
+    auto at{[this](double p) {
+      return _samples[static_cast<std::size_t>(p * (_samples.size() - 1))];
+    }};
+    std::printf("input to render latency of %zu keys: p50 %u us, p99 %u us, "
+                "max %u us\n",
+                _samples.size(), at(0.5), at(0.99), _samples.back());
+  }
+
+private:
+  std::vector<std::uint32_t> _samples;
+};
+} // namespace
+
 int main()
 {
   Tetris::Game tetris;
+  Tetris::Terminal terminal;
+  Tetris::AutoRepeat repeat;
+  Latency latency;
 
-  std::thread timer{[]() {
-    while (1)
-    {
-      /// Satisfies requirements:
-      ///   [REQ_OnTimerCommand](https://github.com/grygorek/TetrisArch#REQ_OnTimerCommand)
-      std::this_thread::sleep_for(std::chrono::seconds(1));
-      s_cmd = Tetris::Command::TranslateDown;
-    }
-  }};
+  auto next{Clock::now()};
+  auto fall{next + Tetris::FallInterval(tetris.Level())};
+  bool quit{false};
+  while (!quit)
+  {
+    /// Single command buffer, the latest key wins
+    /// Satisfies requirements:
+    ///   [REQ_NoPendingCommands](https://github.com/grygorek/TetrisArch#REQ_NoPendingCommands)
+    auto cmd{Tetris::Command::Idle};
+    Clock::time_point pressed{};
 
-  std::thread input{[]() {
-    while (1)
+    // Wait for keys until the end of the step. Each key is stamped
+    // as soon as it arrives.
+    next += Step;
+    while (Clock::now() < next)
     {
-      /// Satisfies requirements:
-      ///   [REQ_NoPendingCommands](https://github.com/grygorek/TetrisArch#REQ_NoPendingCommands)
-      switch (std::getchar())
+      if (!terminal.Wait(next))
+        continue;
+      for (int key{terminal.Read()}; key >= 0; key = terminal.Read())
       {
-      case 'a':
-        s_cmd = Tetris::Command::TranslateLeft;
-        break;
-      case 'd':
-        s_cmd = Tetris::Command::TranslateRigth;
-        break;
-      case ' ':
-        s_cmd = Tetris::Command::RotateRight;
-        break;
-      case 's':
-        s_cmd = Tetris::Command::TranslateDown;
-        break;
-      default:
-        break;
+        auto now{Clock::now()};
+        quit |= key == 'q';
+        if (key == 'r')
+          tetris.Reset(Tetris::Entropy());
+        auto c{KeyCommand(key)};
+        if (c != Tetris::Command::Idle)
+          c = repeat.Press(c, now);
+        if (c != Tetris::Command::Idle)
+        {
+          cmd     = c;
+          pressed = now;
+        }
       }
     }
-  }};
 
-  while (1)
-  {
+    if (cmd == Tetris::Command::Idle)
+      cmd = repeat.Step(next);
     if (s_cmd != Tetris::Command::Idle)
+    {
+      // command entered in the debugger
+      cmd   = s_cmd;
+      s_cmd = Tetris::Command::Idle;
+    }
+
+    if (cmd != Tetris::Command::Idle)
     {
       /// Single input, single player
       /// Satisfies requirements:
       ///   [REQ_SinglePlayer](https://github.com/grygorek/TetrisArch#REQ_SinglePlayer)
-      tetris.Input(s_cmd);
+      tetris.Input(cmd);
+      tetris.Tick();
+      if (pressed != Clock::time_point{})
+        latency.Record(Clock::now() - pressed);
+    }
+
+    if (next >= fall)
+    {
       /// Satisfies requirements:
-      ///   [REQ_NoPendingCommands](https://github.com/grygorek/TetrisArch#REQ_NoPendingCommands)
-      s_cmd = Tetris::Command::Idle;
+      ///   [REQ_OnTimerCommand](https://github.com/grygorek/TetrisArch#REQ_OnTimerCommand)
+      tetris.Input(Tetris::Command::TranslateDown);
       tetris.Tick();
+      fall = next + (tetris.Grounded() ? Tetris::LockDelay
+                                       : Tetris::FallInterval(tetris.Level()));
     }
   }
-}
\ No newline at end of file
+
+  latency.Report();
+}
@@ -0,0 +1,299 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Bots taking part in tournaments
+///
+/// Bots other than the random one try every placement of the falling
+/// figure on a copy of the game and keep the one whose board scores best.
+/// The score is a weighted sum of board features, so bots differ only in
+/// their weights, or the output of a small network given the same
+/// features and the board, or the value of random playouts.
+
+#ifndef __TETRIS_AGENTS_H__
+#define __TETRIS_AGENTS_H__
+
+#include "BoardFeatures.h"
+#include "Mlp.h"
+#include "Policy.h"
+#include "Random.h"
+#include "Rollouts.h"
+#include "TetrisGame.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string_view>
+
+namespace Tetris
+{
+/// @brief Bot placing figures at random
+class RandomAgent final : public Policy
+{
+public:
+  explicit RandomAgent(std::uint32_t seed)
+      : _rng{seed}
+  {
+  }
+
+  Placement Choose(const Game &) override
+  {
+    return PlacementAt(_rng.Below(Placements));
+  }
+
+private:
+  Random _rng;
+};
+
+/// @brief Weights of a board score, see FeatureAgent
+struct FeatureWeights
+{
+  double _cleared;
+  /// Height above the floor the figure has landed at
+  double _landing;
+  double _aggregateHeight;
+  double _holes;
+  double _bumpiness;
+  double _rowTransitions;
+  double _columnTransitions;
+  double _wells;
+};
+
+/// @brief Boards after every placement of the falling figure
+struct Candidates
+{
+  Game _scratch{1};
+  std::array<TetrisScreen, Placements> _boards{};
+  std::array<BoardFeatures, Placements> _features{};
+  std::array<std::int32_t, Placements> _cleared{};
+  std::array<std::int32_t, Placements> _landing{};
+  std::array<bool, Placements> _over{};
+
+  /// @brief Play every placement on a scratch game, then get features of
+  ///   all boards in one batch
+  void Generate(const Game &game)
+  {
+    auto state{game.Save()};
+    for (std::int32_t i{0}; i < Placements; i++)
+    {
+      auto p{PlacementAt(i)};
+      _scratch.Restore(state);
+      auto out{_scratch.Place(p._rotation, p._col)};
+      _over[i]    = _scratch.Over();
+      _cleared[i] = out._cleared;
+      _landing[i] = TetrisScreen::Depth() - out._lockedAt._row;
+      _boards[i]  = _scratch.Landed();
+    }
+    ExtractFeatures(std::span<const TetrisScreen>{_boards},
+                    std::span<BoardFeatures>{_features});
+  }
+
+  /// @brief Placement with the best score
+  ///
+  /// Placements that end the game are the worst. Ties go to the first
+  /// placement, so bots are deterministic.
+  template <class Score>
+  Placement Best(Score score) const
+  {
+    std::int32_t best{0};
+    double bestScore{-std::numeric_limits<double>::infinity()};
+    for (std::int32_t i{0}; i < Placements; i++)
+    {
+      double s{_over[i] ? -std::numeric_limits<double>::max() : score(i)};
+      if (s > bestScore)
+      {
+        best      = i;
+        bestScore = s;
+      }
+    }
+    return PlacementAt(best);
+  }
+};
+
+/// @brief Bot maximising a weighted sum of board features
+class FeatureAgent final : public Policy
+{
+public:
+  explicit FeatureAgent(const FeatureWeights &w)
+      : _w{w}
+  {
+  }
+
+  Placement Choose(const Game &game) override
+  {
+    _candidates.Generate(game);
+    return _candidates.Best([this](std::int32_t i) { return Score(i); });
+  }
+
+private:
+  double Score(std::int32_t i) const
+  {
+    const auto &c{_candidates};
+    const auto &f{c._features[i]};
+    return _w._cleared * c._cleared[i] + _w._landing * c._landing[i] +
+           _w._aggregateHeight * f._aggregateHeight + _w._holes * f._holes +
+           _w._bumpiness * f._bumpiness +
+           _w._rowTransitions * f._rowTransitions +
+           _w._columnTransitions * f._columnTransitions + _w._wells * f._wells;
+  }
+
+  FeatureWeights _w;
+  Candidates _candidates;
+};
+
+/// @brief Bot maximising the output of a network, see Mlp
+///
+/// All placements are scored in one batch.
+class MlpAgent final : public Policy
+{
+public:
+  /// @param net - loaded network with a batch of at least Placements
+  explicit MlpAgent(const Mlp &net)
+      : _net{net}
+  {
+  }
+
+  Placement Choose(const Game &game) override
+  {
+    auto &c{_candidates};
+    c.Generate(game);
+    for (std::int32_t i{0}; i < Placements; i++)
+      MlpEncode(_net.Input(), c._cleared[i], c._landing[i], c._features[i],
+                c._boards[i], _net.Row(i));
+    _net.Evaluate(Placements, _scores.data());
+    return c.Best([this](std::int32_t i) { return _scores[i]; });
+  }
+
+private:
+  Mlp _net;
+  Candidates _candidates;
+  std::array<float, Placements> _scores{};
+};
+
+/// @brief Bot choosing the placement with the best value of rollouts
+///
+/// Tournaments play many games at once, so the bot plays its rollouts
+/// on its own thread and without a time budget; the same seed gives the
+/// same games.
+class RolloutAgent final : public Policy
+{
+public:
+  /// Rollouts of every placement
+  static constexpr std::int32_t Count{16};
+  /// Figures placed after the evaluated one
+  static constexpr std::int32_t Depth{4};
+
+  explicit RolloutAgent(std::uint32_t seed)
+      : _evaluator{1, Depth, RolloutPolicy::sampled, seed, false}
+  {
+  }
+
+  Placement Choose(const Game &game) override
+  {
+    return _evaluator.Evaluate(game, Count, std::chrono::hours{1})._best;
+  }
+
+private:
+  RolloutEvaluator _evaluator;
+};
+
+/// @brief Network of the 'mlp' bot, loaded once
+///
+/// It is read from the file named by the TETRIS_MLP environment variable,
+/// or from tetris.mlp.
+inline const Mlp &BotNetwork()
+{
+  static const Mlp net{[] {
+    Mlp n{Placements};
+    auto *path{std::getenv("TETRIS_MLP")};
+    n.Load(path ? path : "tetris.mlp");
+    return n;
+  }()};
+  return net;
+}
+
+/// @brief Bot known to a tournament by its name
+struct Agent
+{
+  std::string_view _name;
+  /// Make a bot for a game played with the given seed
+  std::unique_ptr<Policy> (*_make)(std::uint32_t seed);
+};
+
+/// Bots taking part in tournaments
+inline constexpr std::array<Agent, 5> Agents{
+    Agent{"random",
+          [](std::uint32_t seed) -> std::unique_ptr<Policy> {
+            return std::make_unique<RandomAgent>(seed);
+          }},
+    // Weights of Yiyuan Lee's genetically tuned bot
+    Agent{"greedy",
+          [](std::uint32_t) -> std::unique_ptr<Policy> {
+            return std::make_unique<FeatureAgent>(
+                FeatureWeights{0.76, 0, -0.51, -0.36, -0.18, 0, 0, 0});
+          }},
+    // Weights of Pierre Dellacherie's bot, cleared lines stand in for
+    // eroded blocks
+    Agent{"dellacherie",
+          [](std::uint32_t) -> std::unique_ptr<Policy> {
+            return std::make_unique<FeatureAgent>(
+                FeatureWeights{1, -1, 0, -4, 0, -1, -1, -1});
+          }},
+    // Learned evaluator, nullptr when there is no network, see BotNetwork
+    Agent{"mlp",
+          [](std::uint32_t) -> std::unique_ptr<Policy> {
+            if (!BotNetwork().Ok())
+              return nullptr;
+            return std::make_unique<MlpAgent>(BotNetwork());
+          }},
+    // Monte Carlo playouts, slow; see RolloutAgent
+    Agent{"rollout",
+          [](std::uint32_t seed) -> std::unique_ptr<Policy> {
+            return std::make_unique<RolloutAgent>(seed);
+          }},
+};
+
+/// @brief Bot by its name
+/// @returns nullptr when there is no such bot
+inline const Agent *FindAgent(std::string_view name)
+{
+  for (const auto &a : Agents)
+    if (a._name == name)
+      return &a;
+  return nullptr;
+}
+
+} // namespace Tetris
+
+#endif //__TETRIS_AGENTS_H__
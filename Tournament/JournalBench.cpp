@@ -0,0 +1,232 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Check and cost of the tick journal behind Game::Undo and Redo
+///
+/// A game is played by random commands, drops and placements while it
+/// records into a journal, and the record of every tick is also kept
+/// whole, as Game::Save writes it. Undo and Redo of random lengths are
+/// compared with those records, with a ring that holds a whole game and
+/// with rings so small that old ticks are dropped. The harness reports
+/// journal bytes per tick and the time of Undo, and fails if a rewound
+/// game differs from its record.
+///
+/// Usage: JournalBench [ticks] [seed]
+
+#include "Policy.h"
+#include "TetrisGame.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+using namespace Tetris;
+using Clock = std::chrono::steady_clock;
+
+/// Bytes of the journal's record of a tick, see DeltaJournal::Record
+std::uint64_t RecordBytes(const Game::Packed &before,
+                          const Game::Packed &after)
+{
+  auto a{std::bit_cast<Game::Journal::Snapshot>(before)};
+  auto b{std::bit_cast<Game::Journal::Snapshot>(after)};
+  std::uint64_t changed{0};
+  for (std::size_t i{0}; i < a.size(); i++)
+    changed += a[i] != b[i];
+  return 2 + 2 * changed;
+}
+
+/// Records of ticks by what the tick did
+struct Cost
+{
+  /// Ticks that changed nothing
+  std::uint64_t _idle{0};
+  /// Ticks that moved the figure only, and their bytes
+  std::uint64_t _moves{0};
+  std::uint64_t _moveBytes{0};
+  /// Ticks in which a figure landed, and their bytes
+  std::uint64_t _landings{0};
+  std::uint64_t _landingBytes{0};
+  /// Calls of Undo, ticks they took back and their time
+  std::uint64_t _undos{0};
+  std::uint64_t _undone{0};
+  Clock::duration _undoTime{};
+};
+
+/// @brief Play and rewind games, compare them with the records of ticks
+/// @param ring - bytes of the journal's ring
+/// @param ticks - ticks to play
+/// @param seed - seed of the player and of the games
+/// @param cost - sizes of records and time of Undo are added here
+/// @returns number of rewinds that gave a different game
+std::uint64_t Check(std::size_t ring, std::int64_t ticks, std::uint32_t seed,
+                    Cost &cost)
+{
+  std::vector<std::uint8_t> memory(ring);
+  Game::Journal journal{memory};
+  Random rng{seed};
+  Game game{seed};
+  game.Record(&journal);
+
+  // history[at] is the record of the game as it is now
+  std::vector<Game::Packed> history(1);
+  game.Save(history[0]);
+  std::size_t at{0};
+  std::uint64_t differences{0};
+  auto same{[&](std::size_t i) {
+    Game::Packed p;
+    game.Save(p);
+    return std::memcmp(&p, &history[i], sizeof(p)) == 0 &&
+           game.Locks() == 0 && game.ClearedRows() == 0;
+  }};
+
+  for (std::int64_t t{0}; t < ticks; t++)
+  {
+    auto r{rng.Below(100)};
+    if (r < 4)
+    {
+      auto n{static_cast<std::int64_t>(rng.Below(200)) + 1};
+      auto start{Clock::now()};
+      auto taken{game.Undo(n)};
+      cost._undoTime += Clock::now() - start;
+      cost._undos++;
+      cost._undone += taken;
+      // a small ring may have dropped old ticks, a big one must have all
+      auto all{std::min<std::int64_t>(n, at)};
+      if (taken > all || (ring >= 1u << 20 && taken != all) ||
+          !same(at - taken))
+        differences++;
+      at -= std::min<std::size_t>(taken, at);
+      continue;
+    }
+    if (r < 8)
+    {
+      auto n{static_cast<std::int64_t>(rng.Below(200)) + 1};
+      auto taken{game.Redo(n)};
+      auto all{std::min<std::int64_t>(n, history.size() - 1 - at)};
+      if (taken != all || !same(at + taken))
+        differences++;
+      at += taken;
+      continue;
+    }
+
+    if (game.Over())
+    {
+      game.Reset(rng());
+      history.assign(1, Game::Packed{});
+      game.Save(history[0]);
+      at = 0;
+      continue;
+    }
+
+    // a tick played after Undo drops the ticks that could be redone
+    history.resize(at + 1);
+    if (r < 95)
+    {
+      game.Input(static_cast<Command>(rng.Below(6)));
+      game.Tick();
+    }
+    else if (r < 98)
+      game.Drop();
+    else
+    {
+      auto p{PlacementAt(rng.Below(Placements))};
+      game.Place(p._rotation, p._col);
+    }
+    history.emplace_back();
+    game.Save(history.back());
+    at++;
+
+    auto bytes{RecordBytes(history[at - 1], history[at])};
+    if (game.Locks() > 0)
+    {
+      cost._landings++;
+      cost._landingBytes += bytes;
+    }
+    else if (bytes > 2)
+    {
+      cost._moves++;
+      cost._moveBytes += bytes;
+    }
+    else
+      cost._idle++;
+  }
+  return differences;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  std::int64_t ticks{argc > 1 ? std::atoll(argv[1]) : 1000000};
+  auto seed{static_cast<std::uint32_t>(argc > 2 ? std::atoll(argv[2]) : 2019)};
+
+  std::uint64_t differences{0};
+  for (std::size_t ring :
+       {std::size_t{1} << 20, std::size_t{4096}, 2 * Game::Journal::MaxRecord})
+  {
+    Cost cost;
+    auto d{Check(ring, ticks, seed, cost)};
+    differences += d;
+    std::printf("ring of %zu bytes: %llu undos took back %llu ticks, "
+                "%llu rewinds differ\n",
+                ring, static_cast<unsigned long long>(cost._undos),
+                static_cast<unsigned long long>(cost._undone),
+                static_cast<unsigned long long>(d));
+    if (ring != std::size_t{1} << 20)
+      continue;
+
+    auto per{[](std::uint64_t bytes, std::uint64_t n) {
+      return n ? static_cast<double>(bytes) / n : 0.0;
+    }};
+    std::chrono::duration<double, std::nano> ns{cost._undoTime};
+    std::printf("  idle ticks: %llu, 2 bytes each\n",
+                static_cast<unsigned long long>(cost._idle));
+    std::printf("  moves:      %llu, %.1f bytes each\n",
+                static_cast<unsigned long long>(cost._moves),
+                per(cost._moveBytes, cost._moves));
+    std::printf("  landings:   %llu, %.1f bytes each\n",
+                static_cast<unsigned long long>(cost._landings),
+                per(cost._landingBytes, cost._landings));
+    std::printf("  keyframes:  %zu bytes every %lld ticks\n",
+                sizeof(Game::Packed) + 2,
+                static_cast<long long>(Game::Journal::KeyframeInterval));
+    std::printf("  undo: %.0f ns per call, %.1f ticks taken back per call\n",
+                ns.count() / std::max<std::uint64_t>(cost._undos, 1),
+                per(cost._undone, cost._undos));
+  }
+  return differences == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
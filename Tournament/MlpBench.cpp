@@ -0,0 +1,183 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Checks and timing of the network evaluator
+///
+/// Writes a network that computes Dellacherie's score exactly: two ReLU
+/// units for the positive and the negative part of the weighted sum. The
+/// network is read back and the 'mlp' bot plays the same games as the
+/// 'dellacherie' bot; with float weights the games must be identical.
+/// Then a network over the whole board is timed per candidate, with float
+/// and int8 weights, with the portable and the AVX2 lanes.
+///
+/// Usage: MlpBench [network file] [games]
+///   network file - where the Dellacherie network is written, it can be
+///                  given to Tournament with TETRIS_MLP
+
+#include "Agents.h"
+#include "Mlp.h"
+#include "Policy.h"
+#include "Random.h"
+#include "TetrisGame.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+using namespace Tetris;
+using Clock = std::chrono::steady_clock;
+
+/// Dellacherie's weights, in the order of MlpInput::features
+constexpr float Dellacherie[MlpFeatureInputs]{1, -1, 0, -4, 0, -1, -1, -1};
+
+/// Score = relu(w.x) - relu(-w.x)
+std::vector<std::uint8_t> DellacherieNetwork(bool int8)
+{
+  MlpLayer hidden{MlpFeatureInputs, 2, int8, true, {}, {0, 0}};
+  for (auto sign : {1.0f, -1.0f})
+    for (auto w : Dellacherie)
+      hidden._weights.push_back(sign * w);
+  MlpLayer out{2, 1, false, false, {1, -1}, {0}};
+  MlpLayer layers[]{hidden, out};
+  return MlpWrite(MlpInput::features, layers);
+}
+
+/// Network over the board with random weights, only to be timed
+std::vector<std::uint8_t> BoardNetwork(bool int8)
+{
+  Random rng{2019};
+  auto layer{[&](std::int32_t in, std::int32_t out, bool relu) {
+    MlpLayer l{in, out, int8, relu, {}, {}};
+    for (std::int32_t i{0}; i < in * out; i++)
+      l._weights.push_back((rng.Below(2001) - 1000) / 1000.0f);
+    for (std::int32_t i{0}; i < out; i++)
+      l._bias.push_back((rng.Below(2001) - 1000) / 10000.0f);
+    return l;
+  }};
+  MlpLayer layers[]{layer(MlpInputs(MlpInput::board), 64, true),
+                    layer(64, 32, true), layer(32, 1, false)};
+  return MlpWrite(MlpInput::board, layers);
+}
+
+/// @returns number of games both bots have played the same
+std::int32_t SameGames(Policy &a, Policy &b, std::int32_t games)
+{
+  std::int32_t same{0};
+  Game ga{1}, gb{1};
+  for (std::int32_t seed{1}; seed <= games; seed++)
+  {
+    ga.Reset(static_cast<std::uint32_t>(seed));
+    gb.Reset(static_cast<std::uint32_t>(seed));
+    auto pa{Play(ga, a, 2000)};
+    auto pb{Play(gb, b, 2000)};
+    same += pa == pb && ga.Lines() == gb.Lines() &&
+            ga.Board().Lines() == gb.Board().Lines();
+  }
+  return same;
+}
+
+/// Nanoseconds to score one candidate in batches of Placements
+template <class Lanes>
+double NsPerCandidate(Mlp &net)
+{
+  constexpr std::int32_t Rounds{20000};
+  Candidates c;
+  Game game{7};
+  c.Generate(game);
+  float scores[Placements];
+  float sink{0};
+  auto start{Clock::now()};
+  for (std::int32_t r{0}; r < Rounds; r++)
+  {
+    for (std::int32_t i{0}; i < Placements; i++)
+      MlpEncode(net.Input(), c._cleared[i], c._landing[i], c._features[i],
+                c._boards[i], net.Row(i));
+    net.Evaluate<Lanes>(Placements, scores);
+    sink += scores[r % Placements];
+  }
+  std::chrono::duration<double, std::nano> ns{Clock::now() - start};
+  if (sink == 12345.0f)
+    std::printf(" ");
+  return ns.count() / (Rounds * Placements);
+}
+
+template <class Lanes>
+void Time(const char *lanes)
+{
+  for (auto int8 : {false, true})
+  {
+    Mlp net{Placements};
+    net.Load(BoardNetwork(int8));
+    std::printf("  %-6s %-5s weights: %6.0f ns per candidate\n", lanes,
+                int8 ? "int8" : "float", NsPerCandidate<Lanes>(net));
+  }
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  const char *path{argc > 1 ? argv[1] : "dellacherie.mlp"};
+  std::int32_t games{argc > 2 ? std::atoi(argv[2]) : 20};
+
+  auto file{DellacherieNetwork(false)};
+  if (auto *f{std::fopen(path, "wb")})
+  {
+    std::fwrite(file.data(), 1, file.size(), f);
+    std::fclose(f);
+  }
+  Mlp net{Placements}, net8{Placements};
+  if (!net.Load(path) || !net8.Load(DellacherieNetwork(true)))
+  {
+    std::fprintf(stderr, "%s: cannot read the network back\n", path);
+    return EXIT_FAILURE;
+  }
+
+  FeatureAgent dellacherie{FeatureWeights{1, -1, 0, -4, 0, -1, -1, -1}};
+  MlpAgent mlp{net}, mlp8{net8};
+  auto same{SameGames(dellacherie, mlp, games)};
+  std::printf("Dellacherie network in %s, %zu bytes\n", path, file.size());
+  std::printf("  float weights: %d of %d games the same as the bot\n", same,
+              games);
+  std::printf("  int8 weights:  %d of %d games the same as the bot\n",
+              SameGames(dellacherie, mlp8, games), games);
+
+  std::printf("Board network %d-64-32-1, batches of %d, incl. encoding\n",
+              MlpInputs(MlpInput::board), Placements);
+  Time<MlpScalar>("scalar");
+#ifdef TETRIS_MLP_AVX2
+  Time<MlpAvx2>("avx2");
+#endif
+  return same == games ? EXIT_SUCCESS : EXIT_FAILURE;
+}
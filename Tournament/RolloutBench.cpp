@@ -0,0 +1,171 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Timing of the rollout evaluator in a 16 ms frame
+///
+/// A game is played by the evaluator's best placements, each move in a
+/// frame of 16 ms, for every number of workers up to the given one. The
+/// harness reports rollouts per frame, how often all rollouts asked for
+/// fit, how the game went and whether anything was allocated while
+/// rollouts were played. Every evaluator must also find the only
+/// placement that clears a well at the left wall.
+///
+/// Usage: RolloutBench [max threads] [rollouts per placement] [depth]
+///                     [moves] [random|sampled]
+
+#include "Policy.h"
+#include "Rollouts.h"
+#include "TetrisGame.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string_view>
+
+namespace
+{
+/// Calls of operator new since the start
+std::atomic<std::uint64_t> allocations{0};
+} // namespace
+
+void *operator new(std::size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (auto *p{std::malloc(size ? size : 1)})
+    return p;
+  throw std::bad_alloc{};
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+namespace
+{
+/// @brief Check that the best placement may put a bar into the left well
+///
+/// The bottom rows are full but for column 0 and the falling figure is a
+/// vertical bar as high as the well. The bar's box has to stand left of
+/// the screen to reach column 0, see PlacementLeft.
+/// @returns true if the best placement removes the rows
+bool WellCleared(Tetris::RolloutEvaluator &evaluator, std::int32_t rollouts,
+                 std::chrono::milliseconds frame)
+{
+  using namespace Tetris;
+  constexpr std::int32_t Height{3};
+  constexpr std::uint8_t Bar{1};
+
+  TetrisScreen board;
+  for (auto r{TetrisScreen::Depth() - Height}; r < TetrisScreen::Depth(); r++)
+    for (std::int32_t c{1}; c < TetrisScreen::Width(); c++)
+      board[Position{r, c}] = Colour::red;
+  AnyFigure::Make(Bar, Game::Spawn)->Draw(board, DrawMode::draw);
+
+  Game game{2019};
+  Game::Packed p;
+  game.Save(p);
+  for (std::int32_t r{0}; r < TetrisScreen::Depth(); r++)
+  {
+    p._rows[r] = 0;
+    for (std::int32_t c{0}; c < TetrisScreen::Width(); c++)
+      if (board[Position{r, c}] != Colour::background)
+        p._rows[r] |= static_cast<std::uint8_t>(1u << c);
+  }
+  p._figure         = Bar;
+  p._figureRotation = 0;
+  p._row            = static_cast<std::int8_t>(Game::Spawn._row);
+  p._col            = static_cast<std::int8_t>(Game::Spawn._col);
+
+  auto ok{game.Restore(p)};
+  if (ok)
+  {
+    auto r{evaluator.Evaluate(game, rollouts, frame)};
+    game.Place(r._best._rotation, r._best._col);
+    ok = game.Lines() == Height;
+  }
+  std::printf("well in column 0: %s\n", ok ? "cleared" : "FAILED");
+  return ok;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  using namespace Tetris;
+  using Clock = std::chrono::steady_clock;
+
+  std::int32_t threads{argc > 1 ? std::atoi(argv[1]) : 4};
+  std::int32_t rollouts{argc > 2 ? std::atoi(argv[2]) : 64};
+  std::int32_t depth{argc > 3 ? std::atoi(argv[3]) : 4};
+  std::int32_t moves{argc > 4 ? std::atoi(argv[4]) : 200};
+  auto policy{argc > 5 && std::string_view{argv[5]} == "random"
+                  ? RolloutPolicy::random
+                  : RolloutPolicy::sampled};
+  constexpr auto Frame{std::chrono::milliseconds{16}};
+
+  std::printf("%d rollouts per placement, %d figures deep, %s policy, "
+              "%lld ms frame\n",
+              rollouts, depth,
+              policy == RolloutPolicy::random ? "random" : "sampled",
+              static_cast<long long>(Frame.count()));
+  bool wellCleared{true};
+  for (std::int32_t t{1}; t <= threads; t *= 2)
+  {
+    RolloutEvaluator evaluator{t, depth, policy};
+    Game game{2019};
+    std::int64_t played{0};
+    std::int32_t complete{0}, made{0};
+    std::uint64_t allocated{0};
+    Clock::duration busy{};
+    for (; made < moves && !game.Over(); made++)
+    {
+      auto before{allocations.load(std::memory_order_relaxed)};
+      auto start{Clock::now()};
+      auto r{evaluator.Evaluate(game, rollouts, Frame)};
+      busy += Clock::now() - start;
+      allocated += allocations.load(std::memory_order_relaxed) - before;
+      played += r._played;
+      complete += r._complete;
+      game.Place(r._best._rotation, r._best._col);
+    }
+    std::chrono::duration<double, std::milli> ms{busy};
+    std::printf("%2d threads: %8.0f rollouts/frame, %6.2f ms/move, "
+                "%3d%% complete, %4d moves, %4d lines, %s, "
+                "%llu allocations\n",
+                t, static_cast<double>(played) / made, ms.count() / made,
+                100 * complete / made, made, game.Lines(),
+                game.Over() ? "lost" : "alive",
+                static_cast<unsigned long long>(allocated));
+    wellCleared = WellCleared(evaluator, rollouts, Frame) && wellCleared;
+  }
+  return wellCleared ? EXIT_SUCCESS : EXIT_FAILURE;
+}
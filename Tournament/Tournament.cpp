@@ -0,0 +1,209 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Tournament of bots playing the same sequences of figures
+///
+/// Every bot plays one game for every seed. The seed alone decides the
+/// sequence of figures, so bots are compared on exactly the same games and
+/// the results do not depend on the number of threads.
+///
+/// Games of a (bot, seed) pair are tasks. Each thread owns a range of
+/// tasks and takes them from its front. A thread that runs out steals
+/// half of the tasks left at the back of another thread's range. Results
+/// are added up with atomics, one set of counters per bot.
+///
+/// Usage: Tournament [bots] [seeds] [threads] [max pieces] [figures]
+///   bots    - comma separated names, e.g. random,greedy,dellacherie,mlp
+///   seeds   - range 'first-last' or a comma separated list
+///   figures - classic or tetrominoes
+
+#include "Agents.h"
+#include "GamePool.h"
+#include "Policy.h"
+#include "TaskRange.h"
+#include "TetrisGame.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+using namespace Tetris;
+
+/// @brief Results of a bot, added up by all threads
+struct Totals
+{
+  std::atomic<std::int64_t> _games{0};
+  std::atomic<std::int64_t> _lines{0};
+  std::atomic<std::int64_t> _linesSq{0};
+  std::atomic<std::int64_t> _pieces{0};
+  std::atomic<std::int64_t> _piecesSq{0};
+  std::atomic<std::int64_t> _ns{0};
+
+  void Add(std::int64_t lines, std::int64_t pieces, std::int64_t ns)
+  {
+    constexpr auto order{std::memory_order_relaxed};
+    _games.fetch_add(1, order);
+    _lines.fetch_add(lines, order);
+    _linesSq.fetch_add(lines * lines, order);
+    _pieces.fetch_add(pieces, order);
+    _piecesSq.fetch_add(pieces * pieces, order);
+    _ns.fetch_add(ns, order);
+  }
+};
+
+/// @brief Mean and half width of its 95% confidence interval
+struct Estimate
+{
+  double _mean;
+  double _ci;
+
+  static Estimate Of(std::int64_t n, std::int64_t sum, std::int64_t sumSq)
+  {
+    if (n == 0)
+      return Estimate{0, 0};
+    double mean{static_cast<double>(sum) / n};
+    double var{n > 1 ? (static_cast<double>(sumSq) - n * mean * mean) / (n - 1)
+                     : 0};
+    return Estimate{mean, 1.96 * std::sqrt(std::max(var, 0.0) / n)};
+  }
+};
+
+/// @brief Seeds from 'first-last' or 'a,b,c'
+std::vector<std::uint32_t> ParseSeeds(const char *spec)
+{
+  std::vector<std::uint32_t> seeds;
+  char *end{};
+  auto first{std::strtoul(spec, &end, 10)};
+  if (*end == '-')
+  {
+    auto last{std::strtoul(end + 1, nullptr, 10)};
+    for (auto s{first}; s <= last; s++)
+      seeds.push_back(static_cast<std::uint32_t>(s));
+    return seeds;
+  }
+
+  seeds.push_back(static_cast<std::uint32_t>(first));
+  while (*end == ',')
+  {
+    seeds.push_back(static_cast<std::uint32_t>(std::strtoul(end + 1, &end, 10)));
+  }
+  return seeds;
+}
+
+std::vector<const Agent *> ParseAgents(std::string_view spec)
+{
+  std::vector<const Agent *> agents;
+  while (!spec.empty())
+  {
+    auto comma{std::min(spec.find(','), spec.size())};
+    auto *a{FindAgent(spec.substr(0, comma))};
+    if (!a)
+    {
+      std::fprintf(stderr, "unknown bot '%.*s'\n", static_cast<int>(comma),
+                   spec.data());
+      std::exit(EXIT_FAILURE);
+    }
+    if (!a->_make(0))
+    {
+      std::fprintf(stderr, "bot '%.*s' cannot be made\n",
+                   static_cast<int>(comma), spec.data());
+      std::exit(EXIT_FAILURE);
+    }
+    agents.push_back(a);
+    spec.remove_prefix(std::min(comma + 1, spec.size()));
+  }
+  return agents;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  auto agents{ParseAgents(argc > 1 ? argv[1] : "random,greedy,dellacherie")};
+  auto seeds{ParseSeeds(argc > 2 ? argv[2] : "1-100")};
+  std::int32_t threads{argc > 3 ? std::atoi(argv[3])
+                                : static_cast<std::int32_t>(std::max(
+                                      1u, std::thread::hardware_concurrency()))};
+  threads = std::max(threads, 1);
+  std::int64_t maxPieces{argc > 4 ? std::atoll(argv[4]) : 10000};
+  auto set{argc > 5 && std::string_view{argv[5]} == "tetrominoes"
+               ? FigureSet::tetrominoes
+               : FigureSet::classic};
+  auto rotation{set == FigureSet::tetrominoes ? RotationSystem::srs
+                                              : RotationSystem::none};
+
+  // Task t is the game of bot t / seeds with seed t % seeds
+  auto tasks{static_cast<std::uint32_t>(agents.size() * seeds.size())};
+  std::deque<Totals> totals(agents.size());
+
+  auto start{std::chrono::steady_clock::now()};
+  // A thread holds one game at a time, so a game per thread is enough;
+  // they are made once and reset for every task
+  GamePool pool{static_cast<std::uint32_t>(threads), set, rotation};
+  RunTasks(tasks, threads, [&](std::uint32_t task, std::int32_t) {
+    auto a{task / seeds.size()};
+    auto seed{seeds[task % seeds.size()]};
+    auto begin{std::chrono::steady_clock::now()};
+    auto game{pool.Acquire(seed)};
+    auto policy{agents[a]->_make(seed)};
+    auto pieces{Play(*game, *policy, maxPieces)};
+    std::chrono::nanoseconds ns{std::chrono::steady_clock::now() - begin};
+    totals[a].Add(game->Lines(), pieces, ns.count());
+  });
+  std::chrono::duration<double> wall{std::chrono::steady_clock::now() - start};
+
+  std::printf("%zu bots x %zu seeds, %d threads, %.2f s\n", agents.size(),
+              seeds.size(), threads, wall.count());
+  std::printf("%-12s %8s %22s %22s %14s\n", "bot", "games", "lines (95% CI)",
+              "pieces (95% CI)", "placements/s");
+  for (std::size_t a{0}; a < agents.size(); a++)
+  {
+    const auto &t{totals[a]};
+    auto n{t._games.load()};
+    auto lines{Estimate::Of(n, t._lines, t._linesSq)};
+    auto pieces{Estimate::Of(n, t._pieces, t._piecesSq)};
+    auto rate{t._ns ? 1e9 * static_cast<double>(t._pieces) / t._ns : 0.0};
+    std::printf("%-12.*s %8lld %12.2f +- %7.2f %12.2f +- %7.2f %14.0f\n",
+                static_cast<int>(agents[a]->_name.size()),
+                agents[a]->_name.data(), static_cast<long long>(n),
+                lines._mean, lines._ci, pieces._mean, pieces._ci, rate);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+/// @file
+///
+/// @author: Piotr Grygorczuk grygorek@gmail.com
+///
+/// @copyright Copyright 2019 Piotr Grygorczuk
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///
+/// o Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+///
+/// o Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// o My name may not be used to endorse or promote products derived from this
+///   software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+///
+/// @brief Latency injection harness of the versus game
+///
+/// Two peers play a match over in-process channels with a simulated
+/// latency. Each peer predicts the opponent's input and rolls back when
+/// the prediction was wrong. The harness reports how deep the rollbacks
+/// are and how long re-simulation takes compared to a 60 Hz frame.
+///
+/// Usage: VersusHarness [latency frames] [jitter frames] [frames]
+
+#include "Versus.h"
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+constexpr std::int32_t MaxRollback{16};
+constexpr double FrameBudgetUs{1e6 / 60};
+
+/// @brief Player that presses a random key now and then
+class RandomPlayer
+{
+public:
+  explicit RandomPlayer(std::uint32_t seed)
+      : _rng{seed}
+  {
+  }
+
+  Tetris::Command Next()
+  {
+    // a key in every fifth frame on average
+    if (_rng.Below(5) != 0)
+      return Tetris::Command::Idle;
+    return static_cast<Tetris::Command>(
+        1 + _rng.Below(static_cast<std::int32_t>(
+                Tetris::Command::TranslateDown)));
+  }
+
+private:
+  Tetris::Random _rng;
+};
+
+/// @brief Rollback statistics of a peer
+struct Stats
+{
+  std::int64_t rollbacks{0};
+  std::int64_t frames{0};
+  std::int32_t maxDepth{0};
+  double totalUs{0};
+  double maxUs{0};
+  std::int64_t stalls{0};
+  std::array<std::int64_t, MaxRollback + 1> histogram{};
+
+  void Record(std::int32_t depth, double us)
+  {
+    rollbacks++;
+    frames += depth;
+    maxDepth = std::max(maxDepth, depth);
+    totalUs += us;
+    maxUs = std::max(maxUs, us);
+    histogram[depth]++;
+  }
+
+  void Print(const char *name) const
+  {
+    std::printf("%s: rollbacks %lld, stalls %lld\n", name,
+                static_cast<long long>(rollbacks),
+                static_cast<long long>(stalls));
+    if (rollbacks == 0)
+      return;
+    std::printf("  depth avg %.2f max %d frames\n",
+                static_cast<double>(frames) / rollbacks, maxDepth);
+    std::printf("  re-simulation avg %.3f us, max %.3f us (%.3f%% of frame),"
+                " %.3f us per frame\n",
+                totalUs / rollbacks, maxUs, 100 * maxUs / FrameBudgetUs,
+                totalUs / frames);
+    std::printf("  depth histogram:");
+    for (std::int32_t d{1}; d <= maxDepth; d++)
+      std::printf(" %d:%lld", d, static_cast<long long>(histogram[d]));
+    std::printf("\n");
+  }
+};
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  std::int32_t latency{argc > 1 ? std::atoi(argv[1]) : 4};
+  std::int32_t jitter{argc > 2 ? std::atoi(argv[2]) : 2};
+  std::int32_t frames{argc > 3 ? std::atoi(argv[3]) : 100000};
+
+  constexpr std::uint32_t seed{2019};
+  using Peer = Tetris::RollbackPeer<MaxRollback>;
+  std::array<Peer, 2> peers{Peer{0, seed}, Peer{1, seed}};
+  std::array<RandomPlayer, 2> players{RandomPlayer{1}, RandomPlayer{2}};
+  using Channel = Tetris::LoopbackChannel<Tetris::InputPacket>;
+  /// channels[i] carries packets sent by peer i
+  std::array<Channel, 2> channels{Channel{latency, jitter, 3},
+                                  Channel{latency, jitter, 4}};
+  std::array<Stats, 2> stats{};
+
+  auto rollback{[&](std::int32_t i) {
+    auto start{std::chrono::steady_clock::now()};
+    auto depth{peers[i].Rollback()};
+    std::chrono::duration<double, std::micro> us{
+        std::chrono::steady_clock::now() - start};
+    if (depth > 0)
+      stats[i].Record(depth, us.count());
+  }};
+
+  std::int32_t now{0};
+  auto done{[&]() {
+    return peers[0].Confirmed() == frames && peers[1].Confirmed() == frames;
+  }};
+  for (; !done(); now++)
+  {
+    for (std::int32_t i{0}; i < 2; i++)
+      channels[i].Deliver(now, [&](const Tetris::InputPacket &p) {
+        peers[1 - i].Receive(p);
+      });
+
+    for (std::int32_t i{0}; i < 2; i++)
+    {
+      rollback(i);
+      if (peers[i].Frame() == frames)
+        continue;
+      if (!peers[i].CanAdvance())
+      {
+        stats[i].stalls++;
+        continue;
+      }
+      channels[i].Send(now, peers[i].Advance(players[i].Next()));
+    }
+  }
+  for (std::int32_t i{0}; i < 2; i++)
+    rollback(i);
+
+  std::printf("latency %d frames, jitter %d frames, %d frames in %d ticks\n",
+              latency, jitter, frames, now);
+  stats[0].Print("peer 0");
+  stats[1].Print("peer 1");
+
+  auto sum0{peers[0].Present().Checksum()};
+  auto sum1{peers[1].Present().Checksum()};
+  std::printf("checksum %08x %08x: %s\n", sum0, sum1,
+              sum0 == sum1 ? "in sync" : "DESYNC");
+  return sum0 == sum1 ? 0 : 1;
+}